@@ -0,0 +1,1083 @@
+#ifndef BASIC_POSET_H
+#define BASIC_POSET_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace cxx {
+    /*
+     * Graph engine shared by 'basic_poset' and the C API in poset.cc. A poset is kept as the graph
+     * of the relations that have been added: every element stores its neighbours, marked as lesser
+     * or greater, and the relation is the transitive closure of these edges.
+     */
+    namespace poset_engine {
+        using relation_t = int_fast8_t;
+
+        constexpr relation_t ELEMENT_GREATER = 1;
+        constexpr relation_t ELEMENT_LESS = 2;
+
+        // Bytes taken from the global heap by the arenas of all posets.
+        inline std::atomic<size_t> arena_bytes_total{0};
+
+        // Takes memory from the global heap and counts it, for the memory usage of an arena.
+        class counting_resource_t : public std::pmr::memory_resource {
+        public:
+            size_t bytes() const {
+                return allocated.load(std::memory_order_relaxed);
+            }
+
+        private:
+            void* do_allocate(size_t bytes, size_t alignment) override {
+                void* result = alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__
+                               ? ::operator new(bytes, std::align_val_t(alignment)) : ::operator new(bytes);
+                allocated.fetch_add(bytes, std::memory_order_relaxed);
+                arena_bytes_total.fetch_add(bytes, std::memory_order_relaxed);
+                return result;
+            }
+
+            void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+                if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+                    ::operator delete(pointer, std::align_val_t(alignment));
+                } else {
+                    ::operator delete(pointer);
+                }
+                allocated.fetch_sub(bytes, std::memory_order_relaxed);
+                arena_bytes_total.fetch_sub(bytes, std::memory_order_relaxed);
+            }
+
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+                return this == &other;
+            }
+
+            std::atomic<size_t> allocated{0};
+        };
+
+        /*
+         * Memory of a single poset graph, allocated from a pool, which takes memory from the global heap
+         * in large chunks and gives all of it back at once when the arena is destroyed. Edge blocks
+         * shared by copies of a graph may be freed by any of them, so the pool is locked.
+         * Once the graph is copied, the arena is frozen: it takes no new blocks and keeps the freed ones
+         * until it's destroyed, so its size doesn't change while the copies share it.
+         */
+        class poset_arena_t : public std::pmr::memory_resource {
+        public:
+            std::pmr::memory_resource* resource() {
+                return this;
+            }
+
+            size_t bytes() const {
+                return upstream.bytes();
+            }
+
+            void freeze() {
+                frozen.store(true, std::memory_order_relaxed);
+            }
+
+            bool is_frozen() const {
+                return frozen.load(std::memory_order_relaxed);
+            }
+
+        private:
+            void* do_allocate(size_t bytes, size_t alignment) override {
+                std::lock_guard<std::mutex> lock(mutex);
+                return pool.allocate(bytes, alignment);
+            }
+
+            void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+                if (is_frozen()) {
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                pool.deallocate(pointer, bytes, alignment);
+            }
+
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+                return this == &other;
+            }
+
+            std::mutex mutex;
+            std::atomic<bool> frozen{false};
+            // Declared before the pool, so that it outlives it.
+            counting_resource_t upstream;
+            std::pmr::unsynchronized_pool_resource pool{&upstream};
+        };
+
+        /*
+         * Allocates edge blocks from an arena and keeps the arena alive until the block is freed,
+         * so an arena outlives its graph only as long as copies of the graph share its blocks.
+         */
+        template<typename T>
+        struct block_allocator_t {
+            using value_type = T;
+
+            std::shared_ptr<poset_arena_t> arena;
+
+            explicit block_allocator_t(std::shared_ptr<poset_arena_t> arena) : arena(std::move(arena)) {}
+
+            template<typename U>
+            block_allocator_t(const block_allocator_t<U>& other) : arena(other.arena) {}
+
+            T* allocate(size_t count) {
+                return static_cast<T*>(arena->resource()->allocate(count * sizeof(T), alignof(T)));
+            }
+
+            void deallocate(T* pointer, size_t count) {
+                arena->resource()->deallocate(pointer, count * sizeof(T), alignof(T));
+            }
+
+            template<typename U>
+            bool operator==(const block_allocator_t<U>& other) const {
+                return arena == other.arena;
+            }
+
+            template<typename U>
+            bool operator!=(const block_allocator_t<U>& other) const {
+                return arena != other.arena;
+            }
+        };
+
+        // Edges of a single element and the number of elements directly below and above it.
+        template<typename Key, typename Hash>
+        struct element_edges_t {
+            std::pmr::unordered_map<Key, relation_t, Hash> edges;
+            size_t lower_count = 0;
+            size_t upper_count = 0;
+
+            explicit element_edges_t(std::pmr::memory_resource* resource) : edges(resource) {}
+
+            element_edges_t(const element_edges_t& other, std::pmr::memory_resource* resource)
+                    : edges(other.edges, resource), lower_count(other.lower_count), upper_count(other.upper_count) {}
+        };
+
+        template<typename Key, typename Hash>
+        struct graph_t {
+            using key_type = Key;
+            using element_type = element_edges_t<Key, Hash>;
+            // Edges are shared between clones and copied before the first write, see mutable_element.
+            using edge_block_type = std::shared_ptr<element_type>;
+            using edge_collection_type = std::pmr::unordered_map<Key, relation_t, Hash>;
+            using key_set_type = std::pmr::unordered_set<Key, Hash>;
+
+            /*
+             * Edge blocks written by this graph are allocated from 'arena', the ones shared with the graphs
+             * it has been copied from or with its own copies stay in their arenas and keep them alive
+             * (see block_allocator_t).
+             * The element table belongs to this graph only and is freed with it. Declared first,
+             * so that the arenas outlive the containers.
+             */
+            std::shared_ptr<poset_arena_t> arena;
+            poset_arena_t table_arena;
+            // if elements[u][v] == ELEMENT_GREATER then u > v and elements[v][u] == ELEMENT_LESS. See add_edge.
+            std::pmr::unordered_map<Key, edge_block_type, Hash> elements;
+            // Elements with nothing directly below or above them, maintained together with the edges.
+            key_set_type minimal;
+            key_set_type maximal;
+
+            graph_t()
+                    : arena(std::make_shared<poset_arena_t>()), elements(table_arena.resource()),
+                      minimal(table_arena.resource()), maximal(table_arena.resource()) {}
+
+            /*
+             * Copies the element table into new arenas, sharing the edge blocks with 'other'.
+             * The arena of 'other' is frozen, 'other' moves to a new one before its next change.
+             */
+            graph_t(const graph_t& other) : graph_t() {
+                other.arena->freeze();
+                elements.insert(other.elements.begin(), other.elements.end());
+                minimal.insert(other.minimal.begin(), other.minimal.end());
+                maximal.insert(other.maximal.begin(), other.maximal.end());
+            }
+
+            // Assigning would mix the memory of two arenas.
+            graph_t& operator=(const graph_t&) = delete;
+
+            // Memory for the edge blocks of this graph.
+            std::pmr::memory_resource* resource() const {
+                return arena->resource();
+            }
+
+            // Moves to a new arena if the current one has been frozen by a copy. Called before allocating blocks.
+            void thaw() {
+                if (arena->is_frozen()) {
+                    arena = std::make_shared<poset_arena_t>();
+                }
+            }
+        };
+
+        /*
+         * Memory for the temporary structures of a single search. It starts with a buffer on the stack,
+         * takes more from the global heap if needed, and frees everything at once at the end.
+         * It doesn't use the arena of the graph, so searches can run on several threads at once.
+         */
+        class scratch_t {
+        public:
+            scratch_t() : monotonic(buffer, sizeof(buffer), std::pmr::new_delete_resource()) {}
+
+            std::pmr::memory_resource* resource() {
+                return &monotonic;
+            }
+
+        private:
+            alignas(std::max_align_t) std::byte buffer[4096];
+            std::pmr::monotonic_buffer_resource monotonic;
+        };
+
+        template<typename Key, typename Hash>
+        inline const typename graph_t<Key, Hash>::edge_collection_type& edges_of(const graph_t<Key, Hash>& graph,
+                                                                                 const Key& key) {
+            return graph.elements.at(key)->edges;
+        }
+
+        /*
+         * Bytes of the arenas holding edge blocks of the graph, each counted once in full, and of its own arena.
+         * Arenas shared with copies of the graph are frozen (see poset_arena_t), so changes of the copies
+         * don't change the result. It takes time proportional to the number of elements.
+         */
+        template<typename Key, typename Hash>
+        size_t arena_bytes(const graph_t<Key, Hash>& graph) {
+            std::vector<const std::pmr::memory_resource*> arenas = {graph.resource()};
+            size_t bytes = graph.arena->bytes();
+            for (auto& [key, element] : graph.elements) {
+                const std::pmr::memory_resource* resource = element->edges.get_allocator().resource();
+                if (std::find(arenas.begin(), arenas.end(), resource) == arenas.end()) {
+                    arenas.push_back(resource);
+                    bytes += static_cast<const poset_arena_t*>(resource)->bytes();
+                }
+            }
+            return bytes;
+        }
+
+        /*
+         * Write access to the edges of an element, copying them into the arena of the graph first
+         * if they are shared with a copy of the graph or still in an arena it has left (see thaw).
+         */
+        template<typename Key, typename Hash>
+        element_edges_t<Key, Hash>& mutable_element(graph_t<Key, Hash>& graph, const Key& key) {
+            using element_type = element_edges_t<Key, Hash>;
+            std::shared_ptr<element_type>& element = graph.elements.at(key);
+
+            graph.thaw();
+            if (element.use_count() > 1 || element->edges.get_allocator().resource() != graph.resource()) {
+                element = std::allocate_shared<element_type>(block_allocator_t<element_type>(graph.arena),
+                                                             *element, graph.resource());
+            }
+
+            return *element;
+        }
+
+        template<typename Key, typename Hash>
+        void add_element(graph_t<Key, Hash>& graph, const Key& key) {
+            using element_type = element_edges_t<Key, Hash>;
+            graph.thaw();
+            graph.elements[key] = std::allocate_shared<element_type>(block_allocator_t<element_type>(graph.arena),
+                                                                     graph.resource());
+            graph.minimal.insert(key);
+            graph.maximal.insert(key);
+        }
+
+        // Removes the element, which must not be referenced by edges of other elements anymore.
+        template<typename Key, typename Hash>
+        void erase_element(graph_t<Key, Hash>& graph, const Key& key) {
+            graph.elements.erase(key);
+            graph.minimal.erase(key);
+            graph.maximal.erase(key);
+        }
+
+        // Removes 'neighbour' from the edges of 'key', keeping the counters and extremal elements up to date.
+        template<typename Key, typename Hash>
+        void erase_neighbour(graph_t<Key, Hash>& graph, const Key& key, const Key& neighbour) {
+            element_edges_t<Key, Hash>& element = mutable_element(graph, key);
+            auto it = element.edges.find(neighbour);
+            if (it == element.edges.end()) {
+                return;
+            }
+
+            if (it->second == ELEMENT_GREATER && --element.lower_count == 0) {
+                graph.minimal.insert(key);
+            } else if (it->second == ELEMENT_LESS && --element.upper_count == 0) {
+                graph.maximal.insert(key);
+            }
+            element.edges.erase(it);
+        }
+
+        // Sets the relation of 'key' to 'neighbour', keeping the counters and extremal elements up to date.
+        template<typename Key, typename Hash>
+        void set_neighbour(graph_t<Key, Hash>& graph, const Key& key, const Key& neighbour, relation_t relation) {
+            element_edges_t<Key, Hash>& element = mutable_element(graph, key);
+            if (!element.edges.insert({neighbour, relation}).second) {
+                return;
+            }
+
+            if (relation == ELEMENT_GREATER && element.lower_count++ == 0) {
+                graph.minimal.erase(key);
+            } else if (relation == ELEMENT_LESS && element.upper_count++ == 0) {
+                graph.maximal.erase(key);
+            }
+        }
+
+        template<typename Key, typename Hash>
+        void remove_edge(graph_t<Key, Hash>& graph, const Key& u, const Key& v) {
+            if (u == v)
+                return;
+            erase_neighbour(graph, u, v);
+            erase_neighbour(graph, v, u);
+        }
+
+        /*
+         * Adds an edge between u and v indicating that u > v
+         */
+        template<typename Key, typename Hash>
+        void add_edge(graph_t<Key, Hash>& graph, const Key& u, const Key& v) {
+            if (u == v)
+                return;
+            set_neighbour(graph, u, v, ELEMENT_GREATER);
+            set_neighbour(graph, v, u, ELEMENT_LESS);
+        }
+
+        // Checks if lower < upper with a depth-first search down from 'upper'.
+        template<typename Key, typename Hash>
+        bool path_exists(const graph_t<Key, Hash>& graph, const Key& lower, const Key& upper) {
+            scratch_t scratch;
+            std::pmr::unordered_set<Key, Hash> visited(scratch.resource());
+            visited.insert(upper);
+            std::pmr::vector<Key> stack(scratch.resource());
+            stack.push_back(upper);
+
+            while (!stack.empty()) {
+                Key v = stack.back();
+                stack.pop_back();
+
+                for (auto& [neighbour, relation] : edges_of(graph, v)) {
+                    if (relation != ELEMENT_GREATER) {
+                        continue;
+                    }
+                    if (neighbour == lower) {
+                        return true;
+                    }
+                    if (visited.insert(neighbour).second) {
+                        stack.push_back(neighbour);
+                    }
+                }
+            }
+
+            return false;
+        }
+
+        // Elements directly below and directly above 'key'.
+        template<typename Key, typename Hash>
+        std::pair<std::vector<Key>, std::vector<Key>> extract_neighbours(const graph_t<Key, Hash>& graph,
+                                                                         const Key& key) {
+            std::vector<Key> less, greater;
+
+            for (auto& [neighbour, relation] : edges_of(graph, key)) {
+                if (relation == ELEMENT_LESS) {
+                    greater.push_back(neighbour);
+                } else if (relation == ELEMENT_GREATER) {
+                    less.push_back(neighbour);
+                }
+            }
+
+            return {less, greater};
+        }
+
+        template<typename Key, typename Hash>
+        void reachable_dfs(const graph_t<Key, Hash>& graph, const Key& v, std::pmr::unordered_set<Key, Hash>& vis) {
+            vis.insert(v);
+
+            for (auto& [neighbour, relation] : edges_of(graph, v)) {
+                if (relation == ELEMENT_GREATER && vis.find(neighbour) == vis.end()) {
+                    reachable_dfs(graph, neighbour, vis);
+                }
+            }
+        }
+
+        template<typename Key, typename Hash>
+        inline void disconnect(graph_t<Key, Hash>& graph, const Key& key) {
+            for (auto& [neighbour, relation] : edges_of(graph, key)) {
+                erase_neighbour(graph, neighbour, key);
+            }
+        }
+
+        // Checks if 'lower' is reachable from 'upper' only through the direct edge between them.
+        template<typename Key, typename Hash>
+        bool can_be_removed(const graph_t<Key, Hash>& graph, const Key& lower, const Key& upper) {
+            scratch_t scratch;
+            std::pmr::unordered_set<Key, Hash> vis(scratch.resource());
+            vis.insert(upper);
+
+            for (auto& [v, relation] : edges_of(graph, upper)) {
+                if (relation == ELEMENT_GREATER && v != lower && vis.count(v) == 0) {
+                    reachable_dfs(graph, v, vis);
+                }
+            }
+
+            return vis.count(lower) == 0;
+        }
+
+        // Adds the relation lower < upper between unrelated elements.
+        template<typename Key, typename Hash>
+        inline void add_relation(graph_t<Key, Hash>& graph, const Key& lower, const Key& upper) {
+            add_edge(graph, upper, lower);
+        }
+
+        // Deletes the relation lower < upper, which must pass can_be_removed.
+        template<typename Key, typename Hash>
+        void delete_relation(graph_t<Key, Hash>& graph, const Key& lower, const Key& upper) {
+            remove_edge(graph, lower, upper);
+
+            auto [less, greater] = extract_neighbours(graph, lower);
+            for (const Key& l : less) {
+                add_edge(graph, upper, l);
+            }
+
+            auto [less2, greater2] = extract_neighbours(graph, upper);
+            for (const Key& g2 : greater2) {
+                add_edge(graph, g2, lower);
+            }
+        }
+
+        // Removes the element, keeping the elements that were below and above it in relation.
+        template<typename Key, typename Hash>
+        void remove_element(graph_t<Key, Hash>& graph, const Key& key) {
+            disconnect(graph, key);
+
+            auto [less, greater] = extract_neighbours(graph, key);
+            for (const Key& upper : greater) {
+                scratch_t scratch;
+                std::pmr::unordered_set<Key, Hash> reachable(scratch.resource());
+                reachable_dfs(graph, upper, reachable);
+
+                for (const Key& lower : less)
+                    if (reachable.find(lower) == reachable.end())
+                        add_edge(graph, upper, lower);
+            }
+
+            erase_element(graph, key);
+        }
+
+        /*
+         * Removes all 'removed' elements, keeping the relation between the remaining ones
+         * the same as removing them one by one would. Removed elements are visited bottom-up,
+         * each getting a bitset of the remaining elements that are below it through removed
+         * elements only. Every remaining element directly above a removed one is then linked
+         * to the elements from its bitset that it doesn't already reach through the remaining ones.
+         */
+        template<typename Key, typename Hash>
+        void remove_elements(graph_t<Key, Hash>& graph, const std::unordered_set<Key, Hash>& removed) {
+            // Remaining elements directly below a removed one, numbered for the bitsets.
+            std::unordered_map<Key, size_t, Hash> index, frontier;
+            std::vector<Key> frontier_elements;
+            for (const Key& key : removed) {
+                index.insert({key, index.size()});
+
+                for (auto& [neighbour, relation] : edges_of(graph, key)) {
+                    if (relation == ELEMENT_GREATER && removed.count(neighbour) == 0 &&
+                            frontier.insert({neighbour, frontier_elements.size()}).second) {
+                        frontier_elements.push_back(neighbour);
+                    }
+                }
+            }
+
+            size_t words = (frontier_elements.size() + 63) / 64;
+            std::vector<uint64_t> below(index.size() * words, 0);
+            std::vector<bool> done(index.size(), false);
+
+            // Iterative post-order traversal, so every bitset is built after the ones below it.
+            std::vector<std::pair<Key, bool>> stack;
+            for (const Key& root : removed) {
+                stack.push_back({root, false});
+
+                while (!stack.empty()) {
+                    auto [v, expanded] = stack.back();
+                    stack.pop_back();
+                    size_t i = index.at(v);
+                    if (done[i]) {
+                        continue;
+                    }
+
+                    if (!expanded) {
+                        stack.push_back({v, true});
+                        for (auto& [neighbour, relation] : edges_of(graph, v)) {
+                            if (relation == ELEMENT_GREATER && removed.count(neighbour) > 0 &&
+                                    !done[index.at(neighbour)]) {
+                                stack.push_back({neighbour, false});
+                            }
+                        }
+                        continue;
+                    }
+
+                    uint64_t* row = below.data() + i * words;
+                    for (auto& [neighbour, relation] : edges_of(graph, v)) {
+                        if (relation != ELEMENT_GREATER) {
+                            continue;
+                        }
+                        if (removed.count(neighbour) > 0) {
+                            const uint64_t* lower_row = below.data() + index.at(neighbour) * words;
+                            for (size_t w = 0; w < words; w++) {
+                                row[w] |= lower_row[w];
+                            }
+                        } else {
+                            size_t bit = frontier.at(neighbour);
+                            row[bit / 64] |= uint64_t(1) << (bit % 64);
+                        }
+                    }
+                    done[i] = true;
+                }
+            }
+
+            // Remaining elements directly above a removed one, with the removed elements below them.
+            std::unordered_map<Key, std::vector<size_t>, Hash> upper;
+            for (const Key& key : removed) {
+                for (auto& [neighbour, relation] : edges_of(graph, key)) {
+                    if (relation == ELEMENT_LESS && removed.count(neighbour) == 0) {
+                        upper[neighbour].push_back(index.at(key));
+                    }
+                }
+            }
+
+            for (const Key& key : removed) {
+                disconnect(graph, key);
+            }
+
+            std::vector<uint64_t> targets(words);
+            for (auto& [key, lower_removed] : upper) {
+                std::fill(targets.begin(), targets.end(), 0);
+                for (size_t i : lower_removed) {
+                    for (size_t w = 0; w < words; w++) {
+                        targets[w] |= below[i * words + w];
+                    }
+                }
+
+                scratch_t scratch;
+                std::pmr::unordered_set<Key, Hash> reachable(scratch.resource());
+                reachable_dfs(graph, key, reachable);
+
+                for (size_t w = 0; w < words; w++) {
+                    for (uint64_t bits = targets[w]; bits != 0; bits &= bits - 1) {
+                        const Key& lower = frontier_elements[w * 64 + __builtin_ctzll(bits)];
+                        if (reachable.find(lower) == reachable.end()) {
+                            add_edge(graph, key, lower);
+                        }
+                    }
+                }
+            }
+
+            for (const Key& key : removed) {
+                erase_element(graph, key);
+            }
+        }
+
+        /*
+         * For every element of 'index' found in the graph, a bitset of the elements of 'index' strictly
+         * below it, 'words' words per element in the order of 'index'. Elements are visited bottom-up
+         * like in remove_elements, including the ones between them that are not in 'index'.
+         */
+        template<typename Key, typename Hash>
+        std::vector<uint64_t> indexed_below(const graph_t<Key, Hash>& graph,
+                                            const std::unordered_map<Key, size_t, Hash>& index, size_t words) {
+            // Rows of the elements of 'index' come first, then the ones of other visited elements.
+            std::vector<uint64_t> rows(index.size() * words, 0);
+            std::vector<bool> done(index.size(), false);
+            std::unordered_map<Key, size_t, Hash> others;
+            auto row_of = [&](const Key& key) {
+                auto it = index.find(key);
+                if (it != index.end()) {
+                    return it->second;
+                }
+                auto [other, inserted] = others.insert({key, done.size()});
+                if (inserted) {
+                    rows.resize(rows.size() + words, 0);
+                    done.push_back(false);
+                }
+                return other->second;
+            };
+
+            std::vector<std::pair<Key, bool>> stack;
+            for (auto& [root, position] : index) {
+                if (graph.elements.count(root) == 0) {
+                    continue;
+                }
+                stack.push_back({root, false});
+
+                while (!stack.empty()) {
+                    auto [v, expanded] = stack.back();
+                    stack.pop_back();
+                    size_t i = row_of(v);
+                    if (done[i]) {
+                        continue;
+                    }
+
+                    if (!expanded) {
+                        stack.push_back({v, true});
+                        for (auto& [neighbour, relation] : edges_of(graph, v)) {
+                            if (relation == ELEMENT_GREATER && !done[row_of(neighbour)]) {
+                                stack.push_back({neighbour, false});
+                            }
+                        }
+                        continue;
+                    }
+
+                    for (auto& [neighbour, relation] : edges_of(graph, v)) {
+                        if (relation != ELEMENT_GREATER) {
+                            continue;
+                        }
+                        size_t lower = row_of(neighbour);
+                        for (size_t w = 0; w < words; w++) {
+                            rows[i * words + w] |= rows[lower * words + w];
+                        }
+                        if (lower < index.size()) {
+                            rows[i * words + lower / 64] |= uint64_t(1) << (lower % 64);
+                        }
+                    }
+                    done[i] = true;
+                }
+            }
+
+            rows.resize(index.size() * words);
+            return rows;
+        }
+
+        // Swaps the rows and columns of a square bit matrix with 'words' words per row.
+        inline std::vector<uint64_t> transposed(const std::vector<uint64_t>& rows, size_t words) {
+            std::vector<uint64_t> result(rows.size(), 0);
+            for (size_t i = 0; i * words < rows.size(); i++) {
+                for (size_t w = 0; w < words; w++) {
+                    for (uint64_t bits = rows[i * words + w]; bits != 0; bits &= bits - 1) {
+                        size_t j = w * 64 + __builtin_ctzll(bits);
+                        result[j * words + i / 64] |= uint64_t(1) << (i % 64);
+                    }
+                }
+            }
+            return result;
+        }
+
+        /*
+         * Adds the elements and relations of 'source' to 'target', with the same result as adding every
+         * pair lower < upper of 'source' one by one, ordered by 'lower' and then by 'upper' with 'less'.
+         * The result are the pairs that cannot be added, as 'target' already has upper < lower.
+         *
+         * Instead of searching 'target' for every pair, it keeps the relation restricted to the elements
+         * of 'source' as two bit matrices (the elements below and above each one), starting from
+         * the relation in 'target' and updating them after every added pair. This takes 2n^2 bits
+         * for n elements of 'source'.
+         */
+        template<typename Key, typename Hash, typename Less>
+        std::vector<std::pair<Key, Key>> merge_graph(graph_t<Key, Hash>& target, const graph_t<Key, Hash>& source,
+                                                     Less less) {
+            std::vector<Key> order;
+            for (auto& [key, edges] : source.elements) {
+                order.push_back(key);
+            }
+            std::sort(order.begin(), order.end(), less);
+
+            std::unordered_map<Key, size_t, Hash> index;
+            for (size_t i = 0; i < order.size(); i++) {
+                index.insert({order[i], i});
+            }
+
+            size_t words = (order.size() + 63) / 64;
+            std::vector<uint64_t> source_above = transposed(indexed_below(source, index, words), words);
+            std::vector<uint64_t> below = indexed_below(target, index, words);
+            std::vector<uint64_t> above = transposed(below, words);
+            auto has = [words](const std::vector<uint64_t>& rows, size_t i, size_t j) {
+                return (rows[i * words + j / 64] >> (j % 64) & 1) != 0;
+            };
+
+            for (const Key& key : order) {
+                if (target.elements.count(key) == 0) {
+                    add_element(target, key);
+                }
+            }
+
+            std::vector<std::pair<Key, Key>> rejected;
+            // Added pairs, only turned into edges at the end.
+            std::vector<uint64_t> added(order.size() * words, 0);
+            std::vector<uint64_t> lower_set(words), upper_set(words);
+            for (size_t i = 0; i < order.size(); i++) {
+                for (size_t w = 0; w < words; w++) {
+                    for (uint64_t bits = source_above[i * words + w]; bits != 0; bits &= bits - 1) {
+                        size_t j = w * 64 + __builtin_ctzll(bits);
+                        if (has(below, j, i)) {
+                            continue;
+                        }
+                        if (has(below, i, j)) {
+                            rejected.push_back({order[i], order[j]});
+                            continue;
+                        }
+
+                        added[i * words + j / 64] |= uint64_t(1) << (j % 64);
+
+                        /*
+                         * Everything from i down is now below everything from j up. The rows are closed
+                         * under the relation, so the ones already having i or j don't change.
+                         */
+                        std::copy_n(below.begin() + i * words, words, lower_set.begin());
+                        std::copy_n(above.begin() + j * words, words, upper_set.begin());
+                        lower_set[i / 64] |= uint64_t(1) << (i % 64);
+                        upper_set[j / 64] |= uint64_t(1) << (j % 64);
+                        for (size_t u = 0; u < words; u++) {
+                            for (uint64_t upper_bits = upper_set[u]; upper_bits != 0; upper_bits &= upper_bits - 1) {
+                                size_t y = u * 64 + __builtin_ctzll(upper_bits);
+                                if (has(below, y, i)) {
+                                    continue;
+                                }
+                                for (size_t v = 0; v < words; v++) {
+                                    below[y * words + v] |= lower_set[v];
+                                }
+                            }
+                            for (uint64_t lower_bits = lower_set[u]; lower_bits != 0; lower_bits &= lower_bits - 1) {
+                                size_t x = u * 64 + __builtin_ctzll(lower_bits);
+                                if (has(above, x, j)) {
+                                    continue;
+                                }
+                                for (size_t v = 0; v < words; v++) {
+                                    above[x * words + v] |= upper_set[v];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            /*
+             * Adding every pair one by one would leave an edge for each of them. Edges i < j with another
+             * added pair i < k such that k <= j follow from the remaining ones, like in a transitive reduction.
+             */
+            for (size_t i = 0; i < order.size(); i++) {
+                for (size_t w = 0; w < words; w++) {
+                    for (uint64_t bits = added[i * words + w]; bits != 0; bits &= bits - 1) {
+                        size_t j = w * 64 + __builtin_ctzll(bits);
+                        bool implied = false;
+                        for (size_t v = 0; !implied && v < words; v++) {
+                            uint64_t others = added[i * words + v] & below[j * words + v];
+                            implied = others != 0;
+                        }
+                        if (!implied) {
+                            add_relation(target, order[i], order[j]);
+                        }
+                    }
+                }
+            }
+
+            return rejected;
+        }
+
+        // Sources answered by a single sweep of 'test_many', one bit each.
+        constexpr size_t SWEEP_WORDS = 4;
+        constexpr size_t SWEEP_SOURCES = 64 * SWEEP_WORDS;
+
+        /*
+         * The graph in a topological order, greater elements first, with the lesser neighbours
+         * of every element stored contiguously. Built once per batch of queries.
+         */
+        template<typename Key, typename Hash>
+        struct sweep_graph_t {
+            std::unordered_map<Key, uint32_t, Hash> position;
+            std::vector<uint32_t> offsets; // Neighbours of element v are at [offsets[v], offsets[v + 1]).
+            std::vector<uint32_t> lower;
+
+            explicit sweep_graph_t(const graph_t<Key, Hash>& graph) {
+                std::vector<Key> order(graph.maximal.begin(), graph.maximal.end());
+                std::unordered_map<Key, size_t, Hash> remaining;
+                for (size_t i = 0; i < order.size(); i++) {
+                    position.insert({order[i], uint32_t(i)});
+                    for (auto& [neighbour, relation] : edges_of(graph, order[i])) {
+                        if (relation != ELEMENT_GREATER) {
+                            continue;
+                        }
+                        auto it = remaining.insert({neighbour, graph.elements.at(neighbour)->upper_count}).first;
+                        if (--it->second == 0) {
+                            order.push_back(neighbour);
+                        }
+                    }
+                }
+
+                offsets.push_back(0);
+                for (const Key& key : order) {
+                    for (auto& [neighbour, relation] : edges_of(graph, key)) {
+                        if (relation == ELEMENT_GREATER) {
+                            lower.push_back(position.at(neighbour));
+                        }
+                    }
+                    offsets.push_back(uint32_t(lower.size()));
+                }
+            }
+
+            size_t size() const {
+                return offsets.size() - 1;
+            }
+
+            /*
+             * Marks the elements below each source with the bit of the source, sweeping the elements
+             * in the topological order from the first source. 'masks' must have SWEEP_WORDS zeroed words
+             * per element from the position of the first source on. Sweeps of different threads can run at once.
+             */
+            void sweep(const std::vector<uint32_t>& sources, std::vector<uint64_t>& masks) const {
+                for (size_t k = 0; k < sources.size(); k++) {
+                    masks[sources[k] * SWEEP_WORDS + k / 64] |= uint64_t(1) << (k % 64);
+                }
+
+                for (size_t v = sources.front(); v < size(); v++) {
+                    const uint64_t* from = &masks[v * SWEEP_WORDS];
+                    uint64_t any = 0;
+                    for (size_t w = 0; w < SWEEP_WORDS; w++) {
+                        any |= from[w];
+                    }
+                    if (any == 0) {
+                        continue;
+                    }
+                    for (uint32_t e = offsets[v]; e < offsets[v + 1]; e++) {
+                        uint64_t* to = &masks[lower[e] * SWEEP_WORDS];
+                        for (size_t w = 0; w < SWEEP_WORDS; w++) {
+                            to[w] |= from[w];
+                        }
+                    }
+                }
+            }
+        };
+
+        /*
+         * Checks lower < upper (or lower == upper) for every pair, like 'path_exists' does for one.
+         * Pairs are grouped by 'upper' and the groups are answered SWEEP_SOURCES at a time, each by
+         * a single sweep of the graph propagating a bit per source, so the cost is O(n + m) per batch
+         * of sources instead of a search per pair. Batches are handed out to up to 'threads' threads,
+         * each taking the next one when it's done. Elements not in the graph precede nothing.
+         */
+        template<typename Key, typename Hash>
+        std::vector<char> test_many(const graph_t<Key, Hash>& graph, const std::vector<std::pair<Key, Key>>& pairs,
+                                    unsigned threads) {
+            std::vector<char> results(pairs.size(), false);
+            sweep_graph_t<Key, Hash> sweep_graph(graph);
+
+            // Pairs waiting for a sweep, grouped by the position of their 'upper' element.
+            std::unordered_map<uint32_t, std::vector<size_t>> waiting;
+            for (size_t i = 0; i < pairs.size(); i++) {
+                auto lower = sweep_graph.position.find(pairs[i].first);
+                auto upper = sweep_graph.position.find(pairs[i].second);
+                if (lower == sweep_graph.position.end() || upper == sweep_graph.position.end()) {
+                    continue;
+                }
+                if (lower->second == upper->second) {
+                    results[i] = true;
+                } else if (lower->second > upper->second) {
+                    waiting[upper->second].push_back(i);
+                }
+            }
+
+            // Sources sorted by position, so every sweep starts as late as possible.
+            std::vector<uint32_t> sources;
+            for (auto& [source, indices] : waiting) {
+                sources.push_back(source);
+            }
+            std::sort(sources.begin(), sources.end());
+            size_t batches = (sources.size() + SWEEP_SOURCES - 1) / SWEEP_SOURCES;
+
+            std::atomic<size_t> next_batch{0};
+            auto run = [&]() {
+                std::vector<uint64_t> masks(sweep_graph.size() * SWEEP_WORDS);
+                for (size_t b; (b = next_batch.fetch_add(1)) < batches; ) {
+                    std::vector<uint32_t> batch(sources.begin() + b * SWEEP_SOURCES,
+                                                sources.begin() + std::min(sources.size(), (b + 1) * SWEEP_SOURCES));
+                    std::fill(masks.begin() + batch.front() * SWEEP_WORDS, masks.end(), 0);
+                    sweep_graph.sweep(batch, masks);
+
+                    for (size_t k = 0; k < batch.size(); k++) {
+                        for (size_t i : waiting.at(batch[k])) {
+                            uint32_t lower = sweep_graph.position.at(pairs[i].first);
+                            results[i] = (masks[lower * SWEEP_WORDS + k / 64] >> (k % 64) & 1) != 0;
+                        }
+                    }
+                }
+            };
+
+            std::vector<std::thread> workers;
+            for (size_t t = 1; t < std::min<size_t>(threads, batches); t++) {
+                workers.emplace_back(run);
+            }
+            run();
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+
+            return results;
+        }
+    }
+
+    /*
+     * Partially ordered set of values of type T, with the same operations as the C API in poset.h,
+     * but working on the values directly instead of interning strings. T must be copyable
+     * and comparable with ==, and Hash must hash it.
+     *
+     * Copies are made in constant time, both posets share their elements and relations until
+     * one of them is modified. The first change copies the table of elements, in time proportional
+     * to their number, but only the relations of the modified elements are copied.
+     * A single poset must not be used by several threads at once if any of them modifies it,
+     * copies of it can be used and modified by different threads.
+     */
+    template<typename T, typename Hash = std::hash<T>>
+    class basic_poset {
+    public:
+        using value_type = T;
+        using graph_type = poset_engine::graph_t<T, Hash>;
+
+        basic_poset() : shared_graph(std::make_shared<graph_type>()) {}
+
+        size_t size() const {
+            return shared_graph->elements.size();
+        }
+
+        bool contains(const T& value) const {
+            return shared_graph->elements.count(value) > 0;
+        }
+
+        /*
+         * If 'value' doesn't belong to the poset, it adds it, not related to any other element.
+         * The result is true when the element is added, and false otherwise.
+         */
+        bool insert(const T& value) {
+            if (contains(value)) {
+                return false;
+            }
+            poset_engine::add_element(mutable_graph(), value);
+            return true;
+        }
+
+        /*
+         * The result is true if both elements belong to the poset and 'value1' precedes 'value2'
+         * (every element precedes itself), and false otherwise.
+         */
+        bool test(const T& value1, const T& value2) const {
+            if (!contains(value1) || !contains(value2)) {
+                return false;
+            }
+            return value1 == value2 || poset_engine::path_exists(*shared_graph, value1, value2);
+        }
+
+        /*
+         * The results of 'test' for every pair, computed together by up to 'threads' threads
+         * (all hardware threads with 0). Much faster than separate tests for many pairs
+         * in a large poset, as every SWEEP_SOURCES distinct 'second' elements take a single pass
+         * over the poset. The poset must not be modified until it returns.
+         */
+        std::vector<bool> test_many(const std::vector<std::pair<T, T>>& pairs, unsigned threads = 0) const {
+            if (threads == 0) {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            std::vector<char> results = poset_engine::test_many(*shared_graph, pairs, threads);
+            return std::vector<bool>(results.begin(), results.end());
+        }
+
+        /*
+         * If both elements belong to the poset and are not in relation, it adds the relation
+         * 'value1' < 'value2' (with everything following from transitivity). The result is true
+         * when the relation is added, and false otherwise.
+         */
+        bool add(const T& value1, const T& value2) {
+            if (!contains(value1) || !contains(value2) || test(value1, value2) || test(value2, value1)) {
+                return false;
+            }
+            poset_engine::add_relation(mutable_graph(), value1, value2);
+            return true;
+        }
+
+        /*
+         * If 'value1' precedes 'value2' and no other element lies between them, it removes the relation
+         * between them, keeping the relations with all other elements. The result is true
+         * if the relation has been removed, and false otherwise.
+         */
+        bool del(const T& value1, const T& value2) {
+            if (value1 == value2 || !test(value1, value2) ||
+                    !poset_engine::can_be_removed(*shared_graph, value1, value2)) {
+                return false;
+            }
+            poset_engine::delete_relation(mutable_graph(), value1, value2);
+            return true;
+        }
+
+        /*
+         * If 'value' belongs to the poset, it removes it, keeping the elements below and above it
+         * in relation. The result is true if the element has been removed, and false otherwise.
+         */
+        bool remove(const T& value) {
+            if (!contains(value)) {
+                return false;
+            }
+            poset_engine::remove_element(mutable_graph(), value);
+            return true;
+        }
+
+        /*
+         * Removes every element of [first, last) that belongs to the poset, with the same result
+         * as removing them one by one. The result is the number of removed elements.
+         */
+        template<typename InputIt>
+        size_t remove_many(InputIt first, InputIt last) {
+            std::unordered_set<T, Hash> removed;
+            for (; first != last; ++first) {
+                if (contains(*first)) {
+                    removed.insert(*first);
+                }
+            }
+            if (!removed.empty()) {
+                poset_engine::remove_elements(mutable_graph(), removed);
+            }
+            return removed.size();
+        }
+
+        /*
+         * Adds the elements and relations of 'other' to the poset, with the same result as adding every
+         * pair value1 < value2 of 'other' with 'add', ordered by value1 and then by value2 with 'less'.
+         * The result are the pairs that cannot be added, as value2 precedes value1 in this poset.
+         * It takes O(n^2) bits of memory for n elements of 'other'.
+         */
+        template<typename Less = std::less<T>>
+        std::vector<std::pair<T, T>> merge(const basic_poset& other, Less less = Less()) {
+            if (shared_graph == other.shared_graph) {
+                return {};
+            }
+            return poset_engine::merge_graph(mutable_graph(), *other.shared_graph, less);
+        }
+
+        // Removes all elements, freeing the memory not shared with copies at once.
+        void clear() {
+            shared_graph = std::make_shared<graph_type>();
+        }
+
+        // True if the graph is shared with a copy of the poset, so the next change will copy it.
+        bool is_shared() const {
+            return shared_graph.use_count() > 1;
+        }
+
+        const graph_type& graph() const {
+            return *shared_graph;
+        }
+
+        /*
+         * Write access to the graph for the engine functions, which lets wrappers like the C API
+         * keep their own data about the elements. Unshares the graph first.
+         */
+        graph_type& mutable_graph() {
+            if (is_shared()) {
+                shared_graph = std::make_shared<graph_type>(*shared_graph);
+            }
+            return *shared_graph;
+        }
+
+    private:
+        std::shared_ptr<graph_type> shared_graph;
+    };
+}
+
+#endif // BASIC_POSET_H
@@ -5,7 +5,26 @@
 #include <cassert>
 #include <algorithm>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <fstream>
+#include <cstring>
+#include <climits>
+#include <cstddef>
+#include <string_view>
+#include <random>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "poset.h"
+#include "basic_poset.h"
+#include "poset_trace.h"
 
 namespace {
 #ifndef NDEBUG
@@ -18,25 +37,250 @@ namespace {
     using poset_id_t        = unsigned long;
     using string_id_t       = size_t;
     using string_ref_cnt_t  = size_t;
-    using relation_t        = int_fast8_t;
-    using edge_t            = std::pair<string_id_t, relation_t>;
-    using edge_collection_t = std::unordered_map<string_id_t, relation_t>;
-    // if poset[u][v] == ELEMENT_GREATER then u > v and poset[v][u] == ELEMENT_SMALLER. See add_edge.
-    using poset_t           = std::unordered_map<string_id_t, edge_collection_t>;
-    using posets_t          = std::unordered_map<poset_id_t, poset_t>;
     // Using 'string' instead of 'char*' to have the appropriate hashing function.
     using string_to_id_t    = std::unordered_map<std::string, string_id_t>;
     using string_ref_t      = std::unordered_map<string_id_t, string_ref_cnt_t>;
+    // Points at the keys of string_to_id, which are stable as long as the string is mapped.
+    using id_to_string_t    = std::unordered_map<string_id_t, const std::string*>;
+    using dense_index_t     = uint32_t;
+    using visitor_t         = ::cxx::poset_visitor_t;
+    using pair_visitor_t    = ::cxx::poset_pair_visitor_t;
+
+    namespace poset_engine = ::cxx::poset_engine;
+    using poset_engine::relation_t;
+    using poset_engine::ELEMENT_GREATER;
+    using poset_engine::ELEMENT_LESS;
+    using poset_engine::arena_bytes_total;
+    using poset_engine::arena_bytes;
+    using poset_engine::scratch_t;
+    using poset_engine::edges_of;
+    using poset_engine::add_element;
+    using poset_engine::erase_element;
+    using poset_engine::add_edge;
+    using poset_engine::remove_edge;
+    using poset_engine::extract_neighbours;
+    using poset_engine::can_be_removed;
+    using poset_engine::remove_elements;
+    using poset_engine::path_exists;
+    using poset_engine::merge_graph;
+    using poset_engine::test_many;
+
+    // The C API is a wrapper keeping interned strings in the engine shared with basic_poset.
+    using interned_poset_t  = ::cxx::basic_poset<string_id_t>;
+    using poset_t           = interned_poset_t::graph_type;
+    using edge_collection_t = poset_t::edge_collection_type;
+    using visited_set_t     = poset_t::key_set_type;
 
-    const int_fast8_t ELEMENT_GREATER = 1;
-    const int_fast8_t ELEMENT_LESS = 2;
+    /*
+     * Layout of a saved poset image (host byte order):
+     *   image_header_t
+     *   uint64_t string_offsets[n + 1] - element i is strings[string_offsets[i], string_offsets[i + 1])
+     *   uint64_t edge_offsets[n + 1]   - CSR rows, row i lists the elements directly less than i
+     *   uint32_t edge_targets[m]       - padded with zeros to a multiple of 8 bytes
+     *   uint64_t closure[n * words]    - only with IMAGE_HAS_CLOSURE, bit j of row i is set iff j < i
+     *   char strings[strings_size]
+     * Elements are sorted lexicographically, so they can be looked up in the image by binary search.
+     */
+    const char IMAGE_MAGIC[8] = {'P', 'O', 'S', 'E', 'T', 'I', 'M', 'G'};
+    const uint32_t IMAGE_VERSION = 1;
+    const uint32_t IMAGE_HAS_CLOSURE = 1;
+
+    struct image_header_t {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        uint64_t element_count;
+        uint64_t edge_count;
+        uint64_t strings_size;
+    };
+
+    // Validated view of a poset image. Points into memory owned by somebody else.
+    struct image_view_t {
+        uint64_t element_count;
+        uint64_t closure_words; // Words per closure row, 0 if the image has no closure.
+        const uint64_t* string_offsets;
+        const uint64_t* edge_offsets;
+        const uint32_t* edge_targets;
+        const uint64_t* closure;
+        const char* strings;
+    };
+
+    // A read-only poset served directly from a memory-mapped image.
+    struct mapped_poset_t {
+        std::shared_ptr<const char> mapping;
+        size_t length;
+        image_view_t view;
+    };
+
+    /*
+     * Reachability labels (GRAIL). Every labeled element has its height (the length of the longest
+     * chain below it) and 'dimensions' intervals [low, rank] taken from randomized post-order
+     * traversals. If v < u, then height(v) < height(u) and each interval of v is contained in the
+     * corresponding interval of u, so most unrelated pairs are rejected without a search.
+     */
+    struct label_data_t {
+        unsigned dimensions;
+        std::unordered_map<string_id_t, size_t> offset; // Position of the element's label in 'labels'.
+        std::vector<uint32_t> labels;                     // Height, then (low, rank) per dimension.
+        uint32_t next_rank;                               // Rank of the next inserted element.
+    };
+
+    struct labeling_t {
+        unsigned dimensions;
+        // Shared with clones until one of them changes. Null when the labels have to be rebuilt.
+        std::shared_ptr<label_data_t> data;
+        size_t widened_edges;    // Edges added since the labels were built.
+        size_t unlabeled_visits; // Elements visited by searches done without labels since they were dropped.
+    };
+
+    /*
+     * Labels widened by more added edges than this and than the poset has elements are considered
+     * too coarse and rebuilt, so a rebuild is amortized over the edges.
+     */
+    const size_t LABEL_MAX_WIDENED_EDGES = 256;
+
+    /*
+     * Posets are kept in a table of slots. The id of a poset holds the index of its slot
+     * in the lower half of its bits and the generation of the slot in the upper half.
+     * Deleting a poset increments the generation, so ids of deleted posets are rejected
+     * even after the slot is reused.
+     */
+    const unsigned POSET_SLOT_BITS = sizeof(poset_id_t) * 8 / 2;
+    const poset_id_t POSET_SLOT_MASK = (poset_id_t(1) << POSET_SLOT_BITS) - 1;
+    const uint32_t NO_FREE_SLOT = UINT32_MAX;
+
+    struct poset_slot_t {
+        poset_id_t generation = 0;
+        uint32_t next_free = NO_FREE_SLOT;
+        // Clones share the whole graph until one of them is modified, see get_poset.
+        std::optional<interned_poset_t> poset;
+        std::unique_ptr<mapped_poset_t> mapped;
+        std::unique_ptr<labeling_t> labeling;
+    };
+
+    struct poset_table_t {
+        std::vector<poset_slot_t> slots;
+        uint32_t first_free = NO_FREE_SLOT;
+    };
+
+    using trace_record_t = poset_trace::record_t;
+    using trace_clock_t = std::chrono::steady_clock;
+
+    const size_t TRACE_BUFFER_RECORDS = 1 << 15;
+    const size_t TRACE_RECORD_WORDS = sizeof(trace_record_t) / sizeof(uint64_t);
+
+    /*
+     * Ring buffer with the most recent trace records of a single thread. Records are stored
+     * as atomic words, so 'poset_trace_dump' can copy them while the thread keeps writing.
+     */
+    struct trace_buffer_t {
+        uint64_t thread;
+        std::atomic<uint64_t> head{0}; // Number of records ever written, only the owner writes it.
+        uint64_t tail = 0;             // Records before it have already been dumped.
+        std::unique_ptr<std::atomic<uint64_t>[]> words;
+    };
+
+    struct trace_registry_t {
+        std::mutex mutex; // Guards the buffers and the tails, taken once per thread and by dumps.
+        std::vector<std::unique_ptr<trace_buffer_t>> buffers;
+        std::vector<trace_buffer_t*> free_buffers; // Buffers of exited threads.
+        std::atomic<uint64_t> inline_strings{0};
+    };
+
+    /*
+     * Layout of the journal file:
+     *   journal_header_t
+     *   records: uint32_t payload length, uint32_t checksum of the payload, payload
+     * Layout of the snapshot file:
+     *   journal_header_t with SNAPSHOT_MAGIC
+     *   a single record with the state of all posets, see write_snapshot
+     * Payloads are sequences of varints and strings prefixed with their varint length.
+     * Every journal record starts with its sequence number, the type and the poset id.
+     * The snapshot holds the sequence number of the last record it includes, later records
+     * are replayed on top of it. A torn record at the end of the journal is discarded.
+     */
+    const char JOURNAL_MAGIC[8] = {'P', 'O', 'S', 'E', 'T', 'J', 'N', 'L'};
+    const char SNAPSHOT_MAGIC[8] = {'P', 'O', 'S', 'E', 'T', 'S', 'N', 'P'};
+    const uint32_t JOURNAL_VERSION = 1;
+    const char SNAPSHOT_SUFFIX[] = ".snapshot";
+
+    struct journal_header_t {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+    };
+
+    const size_t JOURNAL_FRAME_SIZE = 2 * sizeof(uint32_t);
+    // Pending records are written without waiting for the commit interval once there are this many bytes.
+    const size_t GROUP_COMMIT_BYTES = 1 << 20;
+    // The journal is compacted when it outgrows both this size and twice the snapshot.
+    const size_t JOURNAL_COMPACT_BYTES = 64 << 20;
+
+    enum journal_type_t : uint8_t {
+        JOURNAL_NEW = 1,
+        JOURNAL_INSERT,      // value
+        JOURNAL_ADD,         // value1, value2
+        JOURNAL_DEL,         // value1, value2
+        JOURNAL_REMOVE,      // value
+        JOURNAL_REMOVE_MANY, // count, values
+        JOURNAL_CLEAR,
+        JOURNAL_DELETE,
+        JOURNAL_CLONE,       // source poset
+        JOURNAL_POSET,       // elements and relations of a loaded poset
+        JOURNAL_RESERVE,     // id of a read-only poset, which is not restored
+        JOURNAL_LABELING,    // dimensions
+        JOURNAL_MERGE        // source poset
+    };
+
+    /*
+     * Journal of the changes of all posets. The calls append records to 'pending' and a flusher
+     * thread writes them, syncing the file once per group of records collected during
+     * 'commit_interval'. Only the fields below the mutex are shared with the flusher.
+     */
+    struct journal_t {
+        std::string path;
+        int fd = -1;
+        std::chrono::milliseconds commit_interval{0};
+        uint64_t last_lsn = 0;     // Sequence number of the last appended record.
+        size_t journal_bytes = 0;  // Size of the journal file with the pending records.
+        size_t snapshot_bytes = 0;
+        std::thread flusher;
+
+        std::mutex mutex;
+        std::condition_variable wake_flusher;
+        std::condition_variable synced;
+        std::string pending;
+        uint64_t pending_lsn = 0;
+        uint64_t synced_lsn = 0;
+        bool sync_requested = false;
+        bool stopping = false;
+        bool failed = false;
+
+        // Writes the pending records before the journal goes away.
+        ~journal_t() {
+            if (flusher.joinable()) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                wake_flusher.notify_one();
+                flusher.join();
+            }
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    };
+
+    std::atomic<bool> tracing_enabled{false};
+    // Set while buffered records may refer to string ids, so that erased strings are traced.
+    std::atomic<bool> tracing_strings{false};
 
-    poset_id_t last_added_poset_id = -1;
     string_id_t last_added_string_id = 0;
 
     // Solving the static initialization order fiasco.
-    posets_t& active_posets() {
-        static std::unique_ptr<posets_t> result = std::make_unique<posets_t>();
+    poset_table_t& poset_table() {
+        static std::unique_ptr<poset_table_t> result = std::make_unique<poset_table_t>();
         return *result;
     }
 
@@ -50,6 +294,58 @@ namespace {
         return *result;
     }
 
+    id_to_string_t& id_to_string() {
+        static std::unique_ptr<id_to_string_t> result = std::make_unique<id_to_string_t>();
+        return *result;
+    }
+
+    trace_registry_t& trace_registry() {
+        static std::unique_ptr<trace_registry_t> result = std::make_unique<trace_registry_t>();
+        return *result;
+    }
+
+    // Empty unless the journal is open.
+    std::unique_ptr<journal_t>& journal_state() {
+        static std::unique_ptr<journal_t> result;
+        return result;
+    }
+
+    // The slot of the poset with the given id, or nullptr if the id has never been valid or is stale.
+    inline poset_slot_t* find_slot(poset_id_t id) {
+        std::vector<poset_slot_t>& slots = poset_table().slots;
+        poset_id_t index = id & POSET_SLOT_MASK;
+
+        if (index >= slots.size() || slots[index].generation != id >> POSET_SLOT_BITS) {
+            return nullptr;
+        }
+        return &slots[index];
+    }
+
+    // The slot of a poset whose id has already been checked.
+    inline poset_slot_t& slot_of(poset_id_t id) {
+        return poset_table().slots[id & POSET_SLOT_MASK];
+    }
+
+    inline bool is_read_only(poset_id_t id) {
+        poset_slot_t* slot = find_slot(id);
+        return slot != nullptr && slot->mapped != nullptr;
+    }
+
+    inline const mapped_poset_t& mapped_poset(poset_id_t id) {
+        return *slot_of(id).mapped;
+    }
+
+    inline labeling_t* find_labeling(poset_id_t id) {
+        poset_slot_t* slot = find_slot(id);
+        return slot == nullptr ? nullptr : slot->labeling.get();
+    }
+
+    inline void drop_labels(labeling_t& labeling) {
+        labeling.data = nullptr;
+        labeling.widened_edges = 0;
+        labeling.unlabeled_visits = 0;
+    }
+
     // ----- Printing functions ----- //
 
     void print_debug_message() {
@@ -63,13 +359,128 @@ namespace {
     }
 
     void print_does_not_exists(poset_id_t id, const std::string& f_name) {
-        print_debug_message(f_name, ": poset ", id, " does not exist");
+        if (is_read_only(id)) {
+            print_debug_message(f_name, ": poset ", id, " is read-only");
+        } else {
+            print_debug_message(f_name, ": poset ", id, " does not exist");
+        }
     }
 
     inline std::string char_pointer_to_string(char const* str) {
         return str == NULL ? "NULL" : "\"" + std::string(str) + "\"";
     }
 
+    // ----- Tracing ----- //
+
+    /*
+     * The buffer of the current thread, which gives it back when the thread exits. Its records
+     * not dumped yet stay in it, and the next new thread continues writing after them.
+     */
+    struct thread_trace_buffer_t {
+        trace_buffer_t* buffer = nullptr;
+
+        ~thread_trace_buffer_t() {
+            if (buffer != nullptr) {
+                trace_registry_t& registry = trace_registry();
+                std::lock_guard<std::mutex> lock(registry.mutex);
+                registry.free_buffers.push_back(buffer);
+            }
+        }
+    };
+
+    trace_buffer_t& thread_trace_buffer() {
+        thread_local thread_trace_buffer_t owner;
+        trace_buffer_t*& buffer = owner.buffer;
+
+        if (buffer == nullptr) {
+            trace_registry_t& registry = trace_registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+
+            if (!registry.free_buffers.empty()) {
+                buffer = registry.free_buffers.back();
+                registry.free_buffers.pop_back();
+            } else {
+                registry.buffers.push_back(std::make_unique<trace_buffer_t>());
+                buffer = registry.buffers.back().get();
+                buffer->thread = registry.buffers.size() - 1;
+                buffer->words = std::make_unique<std::atomic<uint64_t>[]>(TRACE_BUFFER_RECORDS * TRACE_RECORD_WORDS);
+            }
+        }
+
+        return *buffer;
+    }
+
+    // Lock-free, only the owning thread writes to its buffer.
+    void push_trace_record(const trace_record_t& record) {
+        trace_buffer_t& buffer = thread_trace_buffer();
+        uint64_t words[TRACE_RECORD_WORDS];
+        std::memcpy(words, &record, sizeof(record));
+
+        uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        std::atomic<uint64_t>* slot = &buffer.words[(head % TRACE_BUFFER_RECORDS) * TRACE_RECORD_WORDS];
+        for (size_t i = 0; i < TRACE_RECORD_WORDS; i++) {
+            slot[i].store(words[i], std::memory_order_relaxed);
+        }
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    inline uint64_t trace_timestamp(trace_clock_t::time_point time) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    }
+
+    // Defines the string 'id' for the decoder with a STRING record followed by STRING_DATA records.
+    void trace_string(uint64_t id, std::string_view value) {
+        trace_record_t record = {};
+        record.timestamp = trace_timestamp(trace_clock_t::now());
+        record.type = poset_trace::STRING;
+        record.value1 = id;
+        record.argument = value.size();
+        record.result = std::min<uint64_t>(value.size(), poset_trace::MAX_STRING_LENGTH);
+        push_trace_record(record);
+
+        for (uint64_t offset = 0; offset < record.result; offset += poset_trace::STRING_PAYLOAD) {
+            trace_record_t data = {};
+            data.type = poset_trace::STRING_DATA;
+            std::memcpy(reinterpret_cast<char*>(&data) + offsetof(trace_record_t, poset), value.data() + offset,
+                        std::min(poset_trace::STRING_PAYLOAD, record.result - offset));
+            push_trace_record(data);
+        }
+    }
+
+    /*
+     * Copies the records of the buffer not dumped yet. The owner may overwrite the oldest ones
+     * meanwhile, so after copying 'head' is read again and the records that could have been
+     * overwritten are dropped.
+     */
+    std::vector<trace_record_t> drain_trace_buffer(trace_buffer_t& buffer) {
+        uint64_t head = buffer.head.load(std::memory_order_acquire);
+        uint64_t first = std::max(buffer.tail, head > TRACE_BUFFER_RECORDS ? head - TRACE_BUFFER_RECORDS : 0);
+
+        std::vector<uint64_t> words;
+        words.reserve((head - first) * TRACE_RECORD_WORDS);
+        for (uint64_t i = first; i < head; i++) {
+            const std::atomic<uint64_t>* slot = &buffer.words[(i % TRACE_BUFFER_RECORDS) * TRACE_RECORD_WORDS];
+            for (size_t w = 0; w < TRACE_RECORD_WORDS; w++) {
+                words.push_back(slot[w].load(std::memory_order_relaxed));
+            }
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // The owner may be in the middle of writing the record at index 'current'.
+        uint64_t current = buffer.head.load(std::memory_order_relaxed);
+        uint64_t valid = current + 1 > TRACE_BUFFER_RECORDS ? current + 1 - TRACE_BUFFER_RECORDS : 0;
+
+        std::vector<trace_record_t> records;
+        for (uint64_t i = std::max(first, valid); i < head; i++) {
+            trace_record_t record;
+            std::memcpy(&record, &words[(i - first) * TRACE_RECORD_WORDS], sizeof(record));
+            records.push_back(record);
+        }
+
+        buffer.tail = head;
+        return records;
+    }
+
     // ----- String manipulation ----- //
 
     inline bool is_string_mapped(char const* str) {
@@ -78,8 +489,9 @@ namespace {
 
     string_id_t add_string(char const* str) {
         last_added_string_id++;
-        string_to_id().insert({str, last_added_string_id});
+        auto [it, inserted] = string_to_id().insert({str, last_added_string_id});
         string_references().insert({last_added_string_id, 0});
+        id_to_string().insert({last_added_string_id, &it->first});
         return last_added_string_id;
     }
 
@@ -97,8 +509,8 @@ namespace {
         return string_to_id().at(str);
     }
 
-    inline bool is_string_in_poset(poset_t& poset, char const* value) {
-        return poset.count(get_string_id(value)) > 0;
+    inline bool is_string_in_poset(const poset_t& poset, char const* value) {
+        return poset.elements.count(get_string_id(value)) > 0;
     }
 
     inline void add_string_reference(string_id_t sid) {
@@ -118,7 +530,11 @@ namespace {
         ref--;
 
         if (str != NULL && ref == 0) {
+            if (tracing_strings.load(std::memory_order_relaxed)) {
+                trace_string(sid, str);
+            }
             string_references().erase(sid);
+            id_to_string().erase(sid);
             string_to_id().erase(str);
         }
     }
@@ -130,7 +546,11 @@ namespace {
     void cleanup_empty_references() {
         for (auto it = string_to_id().begin(), last = string_to_id().end(); it != last;) {
             if (active_references(it->second) == 0) {
+                if (tracing_strings.load(std::memory_order_relaxed)) {
+                    trace_string(it->second, it->first);
+                }
                 string_references().erase(it->second);
+                id_to_string().erase(it->second);
                 it = string_to_id().erase(it);
             } else {
                 it++;
@@ -138,42 +558,288 @@ namespace {
         }
     }
 
-    // Ignoring transitivity, checks if value1 < value2.
-    inline bool directly_greater_than(poset_t const& poset, string_id_t value1, string_id_t value2) {
-        return poset.count(value2) > 0 && poset.at(value2).count(value1) > 0
-               && poset.at(value2).at(value1) == ELEMENT_GREATER;
+    // ----- Poset images ----- //
+
+    inline uint64_t closure_words(uint64_t element_count) {
+        return (element_count + 63) / 64;
+    }
+
+    inline uint64_t padded_targets_size(uint64_t edge_count) {
+        return (edge_count * sizeof(uint32_t) + 7) / 8 * 8;
+    }
+
+    // Checks that the offsets form a non-decreasing sequence from 0 to 'last'.
+    bool are_offsets_valid(const uint64_t* offsets, uint64_t count, uint64_t last) {
+        if (offsets[0] != 0 || offsets[count] != last) {
+            return false;
+        }
+        for (uint64_t i = 0; i < count; i++) {
+            if (offsets[i] > offsets[i + 1]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline std::string_view image_element(const image_view_t& view, uint64_t i) {
+        return std::string_view(view.strings + view.string_offsets[i],
+                                view.string_offsets[i + 1] - view.string_offsets[i]);
+    }
+
+    /*
+     * Fills 'view' with pointers into the image of the given length. The result is false
+     * when the image is malformed, in which case no pointer from 'view' may be used.
+     */
+    bool parse_image(const char* data, size_t length, image_view_t& view) {
+        if (length < sizeof(image_header_t)) {
+            return false;
+        }
+
+        image_header_t header;
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 ||
+                header.version != IMAGE_VERSION ||
+                header.element_count > UINT32_MAX ||
+                header.edge_count > length / sizeof(uint32_t) ||
+                header.strings_size > length) {
+            return false;
+        }
+
+        uint64_t n = header.element_count;
+        uint64_t offsets_size = (n + 1) * sizeof(uint64_t);
+        uint64_t words = (header.flags & IMAGE_HAS_CLOSURE) ? closure_words(n) : 0;
+        uint64_t expected = sizeof(image_header_t) + 2 * offsets_size
+                            + padded_targets_size(header.edge_count)
+                            + n * words * sizeof(uint64_t) + header.strings_size;
+        if (expected != length) {
+            return false;
+        }
+
+        const char* cursor = data + sizeof(image_header_t);
+        view.element_count = n;
+        view.closure_words = words;
+        view.string_offsets = reinterpret_cast<const uint64_t*>(cursor);
+        cursor += offsets_size;
+        view.edge_offsets = reinterpret_cast<const uint64_t*>(cursor);
+        cursor += offsets_size;
+        view.edge_targets = reinterpret_cast<const uint32_t*>(cursor);
+        cursor += padded_targets_size(header.edge_count);
+        view.closure = reinterpret_cast<const uint64_t*>(cursor);
+        cursor += n * words * sizeof(uint64_t);
+        view.strings = cursor;
+
+        if (!are_offsets_valid(view.string_offsets, n, header.strings_size) ||
+                !are_offsets_valid(view.edge_offsets, n, header.edge_count)) {
+            return false;
+        }
+
+        for (uint64_t i = 0; i < n; i++) {
+            std::string_view element = image_element(view, i);
+            if (element.find('\0') != std::string_view::npos ||
+                    (i > 0 && image_element(view, i - 1) >= element)) {
+                return false;
+            }
+            for (uint64_t e = view.edge_offsets[i]; e < view.edge_offsets[i + 1]; e++) {
+                if (view.edge_targets[e] >= n || view.edge_targets[e] == i) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // Returns the dense index of the element, or element_count if it doesn't belong to the image.
+    uint64_t image_find(const image_view_t& view, std::string_view value) {
+        const uint64_t n = view.element_count;
+        uint64_t low = 0, high = n;
+
+        while (low < high) {
+            uint64_t mid = low + (high - low) / 2;
+            if (image_element(view, mid) < value) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+
+        return low < n && image_element(view, low) == value ? low : n;
+    }
+
+    // Checks if lower <= upper in the image, using the closure index if it's present.
+    bool image_test(const image_view_t& view, uint64_t lower, uint64_t upper) {
+        if (lower == upper) {
+            return true;
+        }
+        if (view.closure_words > 0) {
+            uint64_t word = view.closure[upper * view.closure_words + lower / 64];
+            return (word >> (lower % 64)) & 1;
+        }
+
+        std::vector<bool> visited(view.element_count);
+        std::vector<uint64_t> stack = {upper};
+        visited[upper] = true;
+
+        while (!stack.empty()) {
+            uint64_t v = stack.back();
+            stack.pop_back();
+
+            for (uint64_t e = view.edge_offsets[v]; e < view.edge_offsets[v + 1]; e++) {
+                uint64_t u = view.edge_targets[e];
+                if (u == lower) {
+                    return true;
+                }
+                if (!visited[u]) {
+                    visited[u] = true;
+                    stack.push_back(u);
+                }
+            }
+        }
+
+        return false;
+    }
+
+    /*
+     * Maps the whole file into memory. The result is empty if the file cannot be mapped,
+     * otherwise, the mapping is released together with the last copy of the pointer.
+     */
+    std::shared_ptr<const char> map_file(char const* path, size_t& length) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return nullptr;
+        }
+
+        struct stat file_stat;
+        void* address = MAP_FAILED;
+        if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+            length = file_stat.st_size;
+            address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+
+        if (address == MAP_FAILED) {
+            return nullptr;
+        }
+
+        return std::shared_ptr<const char>(static_cast<const char*>(address),
+                                           [length](const char* p) {
+                                               munmap(const_cast<char*>(p), length);
+                                           });
     }
 
     // ----- Poset manipulation ----- //
 
     inline bool poset_exists(poset_id_t id) {
-        return active_posets().count(id) > 0;
+        poset_slot_t* slot = find_slot(id);
+        return slot != nullptr && slot->poset.has_value();
+    }
+
+    // Takes an empty slot, reusing the most recently freed one, and returns the id for it.
+    poset_id_t allocate_slot() {
+        poset_table_t& table = poset_table();
+        uint32_t index = table.first_free;
+
+        if (index == NO_FREE_SLOT) {
+            index = table.slots.size();
+            table.slots.emplace_back();
+        } else {
+            table.first_free = table.slots[index].next_free;
+        }
+
+        return (table.slots[index].generation << POSET_SLOT_BITS) | index;
+    }
+
+    // Empties the slot of the poset. Slots whose generation would overflow are not reused.
+    void free_slot(poset_id_t id) {
+        poset_table_t& table = poset_table();
+        poset_slot_t& slot = slot_of(id);
+
+        slot.poset.reset();
+        slot.mapped = nullptr;
+        slot.labeling = nullptr;
+
+        if (++slot.generation <= POSET_SLOT_MASK) {
+            slot.next_free = table.first_free;
+            table.first_free = id & POSET_SLOT_MASK;
+        }
     }
 
     inline poset_id_t add_poset() {
-        last_added_poset_id++;
-        active_posets().insert({last_added_poset_id, poset_t()});
-        return last_added_poset_id;
+        poset_id_t pid = allocate_slot();
+        slot_of(pid).poset.emplace();
+        return pid;
     }
 
-    inline poset_t& get_poset(poset_id_t pid) {
-        return active_posets().at(pid);
+    inline bool is_shared(poset_id_t pid) {
+        return slot_of(pid).poset->is_shared();
     }
 
-    void clear_poset(poset_id_t pid) {
-        poset_t& poset = get_poset(pid);
+    // Read access, the poset stays shared with its clones.
+    inline const poset_t& view_poset(poset_id_t pid) {
+        return slot_of(pid).poset->graph();
+    }
+
+    /*
+     * Write access. A poset shared with its clones is copied first, which copies the table
+     * of elements and takes a reference to every string, but the copy shares all edge blocks
+     * with the original (see mutable_element). String references are counted per copy
+     * of poset_t, not per poset id.
+     */
+    poset_t& get_poset(poset_id_t pid) {
+        interned_poset_t& poset = *slot_of(pid).poset;
+
+        if (poset.is_shared()) {
+            for (auto& [sid, edges] : poset.mutable_graph().elements) {
+                add_string_reference(sid);
+            }
+        }
+
+        return poset.mutable_graph();
+    }
+
+    // Works for both modifiable and read-only posets.
+    inline poset_id_t clone_poset(poset_id_t pid) {
+        poset_id_t clone = allocate_slot();
+        // Taking the slot may have moved the other slots.
+        const poset_slot_t& source = slot_of(pid);
+        poset_slot_t& target = slot_of(clone);
+
+        target.poset = source.poset;
+        if (source.mapped != nullptr) {
+            target.mapped = std::make_unique<mapped_poset_t>(*source.mapped);
+        }
+        if (source.labeling != nullptr) {
+            target.labeling = std::make_unique<labeling_t>(*source.labeling);
+        }
+        return clone;
+    }
+
+    // Drops the string references of the poset, unless a clone shares it and keeps them.
+    void release_strings(poset_id_t pid) {
+        if (is_shared(pid)) {
+            return;
+        }
 
-        for (auto& [sid, edges] : poset) {
+        for (auto& [sid, edges] : view_poset(pid).elements) {
             remove_string_reference(sid, NULL);
         }
 
         cleanup_empty_references();
-        poset.clear();
+    }
+
+    // The elements are freed together with the arena of the poset, unless they're shared with a clone.
+    void clear_poset(poset_id_t pid) {
+        if (labeling_t* labeling = find_labeling(pid)) {
+            drop_labels(*labeling);
+        }
+
+        release_strings(pid);
+        slot_of(pid).poset.emplace();
     }
 
     void remove_poset(poset_id_t pid) {
-        clear_poset(pid);
-        active_posets().erase(pid);
+        release_strings(pid);
+        free_slot(pid);
     }
 
     /*
@@ -181,173 +847,1735 @@ namespace {
     * the result is true, otherwise, it's false.
     */
     bool is_element_in_poset(poset_id_t id, char const* value) {
-        return is_string_mapped(value) && active_posets().at(id).count(get_string_id(value)) > 0;
+        if (is_read_only(id)) {
+            const image_view_t& view = mapped_poset(id).view;
+            return image_find(view, value) < view.element_count;
+        }
+        return is_string_mapped(value) && view_poset(id).elements.count(get_string_id(value)) > 0;
     }
 
-    void remove_edge(poset_t& poset, string_id_t u, string_id_t v) {
-        if (u == v)
-            return;
-        poset[u].erase(v);
-        poset[v].erase(u);
-    }
+    // ----- Reachability labels ----- //
 
-    /*
-     * Adds an edge between u and v indicating that u > v
-     */
-    void add_edge(poset_t& poset, string_id_t u, string_id_t v) {
-        if (u == v)
-            return;
-        poset[u][v] = ELEMENT_GREATER;
-        poset[v][u] = ELEMENT_LESS;
-    }
+    std::shared_ptr<label_data_t> build_labels(const poset_t& poset, unsigned dimensions) {
+        static std::mt19937 random_engine;
+        const size_t n = poset.elements.size(), stride = 1 + 2 * dimensions;
 
-    /*
-    * Recursively checks if value1 < value2.
-    */
-    bool poset_test_recursive(const poset_t& poset, string_id_t value1, string_id_t value2) {
-        bool result = false;
+        auto data = std::make_shared<label_data_t>();
+        data->dimensions = dimensions;
+        data->labels.assign(n * stride, 0);
+        data->next_rank = n;
+
+        std::vector<string_id_t> elements;
+        elements.reserve(n);
+        for (auto& [sid, edges] : poset.elements) {
+            data->offset[sid] = elements.size() * stride;
+            elements.push_back(sid);
+        }
 
-        if (!poset.at(value2).empty()) {
-            if (directly_greater_than(poset, value1, value2)) {
-                result = true;
+        // Elements directly less than element i, in CSR form over positions in 'elements'.
+        std::vector<size_t> edge_offsets = {0}, edge_targets, roots;
+        for (size_t i = 0; i < n; i++) {
+            bool is_maximal = true;
+            for (auto& [neighbour, relation] : edges_of(poset, elements[i])) {
+                if (relation == ELEMENT_GREATER) {
+                    edge_targets.push_back(data->offset.at(neighbour) / stride);
+                } else {
+                    is_maximal = false;
+                }
+            }
+            edge_offsets.push_back(edge_targets.size());
+            if (is_maximal) {
+                roots.push_back(i);
             }
-            else { // Checking if any element from the set is in a relation with 'value1'.
-                for (const auto& set_element : poset.at(value2)) {
-                    if (!result && set_element.second == ELEMENT_GREATER) {
-                        result = poset_test_recursive(poset, value1, set_element.first);
+        }
+
+        struct frame_t {
+            size_t element, visited_edges, first_edge;
+        };
+        std::vector<frame_t> stack;
+
+        for (unsigned d = 0; d < dimensions; d++) {
+            std::vector<bool> visited(n, false);
+            uint32_t rank = 0;
+            std::shuffle(roots.begin(), roots.end(), random_engine);
+
+            for (size_t root : roots) {
+                visited[root] = true;
+                stack.push_back({root, 0, random_engine()});
+
+                while (!stack.empty()) {
+                    frame_t& top = stack.back();
+                    size_t v = top.element, degree = edge_offsets[v + 1] - edge_offsets[v];
+
+                    if (top.visited_edges < degree) {
+                        size_t e = edge_offsets[v] + (top.first_edge + top.visited_edges++) % degree;
+                        if (!visited[edge_targets[e]]) {
+                            visited[edge_targets[e]] = true;
+                            stack.push_back({edge_targets[e], 0, random_engine()});
+                        }
+                        continue;
                     }
+
+                    uint32_t* label = &data->labels[v * stride];
+                    uint32_t low = rank;
+                    for (size_t e = edge_offsets[v]; e < edge_offsets[v + 1]; e++) {
+                        const uint32_t* lesser = &data->labels[edge_targets[e] * stride];
+                        low = std::min(low, lesser[1 + 2 * d]);
+                        if (d == 0) {
+                            label[0] = std::max(label[0], lesser[0] + 1);
+                        }
+                    }
+                    label[1 + 2 * d] = low;
+                    label[2 + 2 * d] = rank++;
+
+                    stack.pop_back();
                 }
             }
         }
 
-        return result;
+        return data;
     }
 
-    /*
-    * Works the same way as 'poset_test' (checks if value1 <= value2),
-    * but doesn't print messages and doesn't check input data for validity.
-    * The 'poset_test' function may print messages,
-    * which is not needed when used as a helper function.
-.
-    */
-    bool does_relation_exist(poset_id_t id, char const* value1, char const* value2) {
-        string_id_t sid1 = get_string_id(value1), sid2 = get_string_id(value2);
-        if (sid1 == sid2) { // We assume that the element is in relation with itself.
-            return true;
+    // Checks if the labels allow the element at 'lower' to be strictly less than the one at 'upper'.
+    bool labels_allow(const label_data_t& data, size_t lower, size_t upper) {
+        const uint32_t* l = &data.labels[lower];
+        const uint32_t* u = &data.labels[upper];
+
+        if (l[0] >= u[0]) {
+            return false;
+        }
+        for (unsigned d = 0; d < data.dimensions; d++) {
+            if (l[1 + 2 * d] < u[1 + 2 * d] || l[2 + 2 * d] > u[2 + 2 * d]) {
+                return false;
+            }
         }
-        return poset_test_recursive(get_poset(id), sid1, sid2);
+        return true;
     }
 
-    std::pair<std::vector<poset_id_t>, std::vector<poset_id_t>> extract_neighbours(poset_t const& poset,
-                                                                                   string_id_t sid,
-                                                                                   bool ignore_less = false) {
-
-        std::vector<poset_id_t> less, greater;
+    // Makes the label at 'upper' cover the one at 'lower'. The result is true if it has changed.
+    bool widen_label(label_data_t& data, size_t lower, size_t upper) {
+        uint32_t* l = &data.labels[lower];
+        uint32_t* u = &data.labels[upper];
+        bool changed = false;
 
-        for (auto edge : poset.at(sid)) {
-            if (edge.second == ELEMENT_LESS) {
-                greater.push_back(edge.first);
-            } else if (!ignore_less && edge.second == ELEMENT_GREATER) {
-                less.push_back(edge.first);
+        if (u[0] <= l[0]) {
+            u[0] = l[0] + 1;
+            changed = true;
+        }
+        for (unsigned d = 0; d < data.dimensions; d++) {
+            if (u[1 + 2 * d] > l[1 + 2 * d]) {
+                u[1 + 2 * d] = l[1 + 2 * d];
+                changed = true;
+            }
+            if (u[2 + 2 * d] < l[2 + 2 * d]) {
+                u[2 + 2 * d] = l[2 + 2 * d];
+                changed = true;
             }
         }
+        return changed;
+    }
 
-        return {less, greater};
+    // Labels of the poset for changing them, copied first if they are shared with a clone. Null if they're dropped.
+    label_data_t* mutable_labels(labeling_t& labeling) {
+        if (labeling.data != nullptr && labeling.data.use_count() > 1) {
+            labeling.data = std::make_shared<label_data_t>(*labeling.data);
+        }
+        return labeling.data.get();
     }
 
     /*
-     * Checks if the poset with the given id exists and
-     * if value1 and value2 are both not NULL, and both belong to the given poset.
+     * Gives the element, which isn't related to any other, a label of its own: height 0 and a new rank
+     * in every dimension, so it's rejected by the labels of all other elements until edges are added.
+     * Labels of removed elements are left behind, so the labels are dropped once they outnumber the elements.
      */
-    bool validate_arguments(poset_id_t id, char const* value1,
-                            char const* value2, const std::string& function_name) {
-
-        if constexpr (DEBUG) {
-            print_debug_message(function_name, "(", std::to_string(id), ", ",
-                                char_pointer_to_string(value1), ", ",
-                                char_pointer_to_string(value2), ")");
+    void label_element(labeling_t& labeling, const poset_t& poset, string_id_t sid) {
+        label_data_t* data = mutable_labels(labeling);
+        if (data == nullptr) {
+            return;
+        }
+        if (data->offset.size() >= 2 * poset.elements.size() + LABEL_MAX_WIDENED_EDGES) {
+            drop_labels(labeling);
+            return;
+        }
 
-            if (value1 == NULL) {
-                print_debug_message(function_name, ": invalid value1 (NULL)");
-            }
-            if (value2 == NULL) {
-                print_debug_message(function_name, ": invalid value2 (NULL)");
-            }
+        const size_t stride = 1 + 2 * data->dimensions;
+        auto [it, inserted] = data->offset.insert({sid, data->labels.size()});
+        if (inserted) {
+            data->labels.resize(data->labels.size() + stride);
         }
 
-        bool does_poset_exist = poset_exists(id);
-        if constexpr (DEBUG) {
-            if (!does_poset_exist) {
-                print_debug_message(function_name, ": poset ",
-                                    std::to_string(id), " does not exist");
-            }
+        uint32_t* label = &data->labels[it->second];
+        uint32_t rank = data->next_rank++;
+        label[0] = 0;
+        for (unsigned d = 0; d < data->dimensions; d++) {
+            label[1 + 2 * d] = rank;
+            label[2 + 2 * d] = rank;
         }
+    }
 
-        if (value1 == NULL || value2 == NULL || !does_poset_exist) {
-            return false;
+    /*
+     * Keeps the labels sound after the edge upper > lower has been added by widening
+     * the labels of 'upper' and of all elements above it. Labels widened too many times
+     * are dropped instead.
+     */
+    void update_labels_after_add(labeling_t& labeling, const poset_t& poset,
+                                 string_id_t lower, string_id_t upper) {
+        if (labeling.data == nullptr) {
+            return;
+        }
+        if (++labeling.widened_edges > std::max(LABEL_MAX_WIDENED_EDGES, poset.elements.size())) {
+            drop_labels(labeling);
+            return;
         }
 
-        if (!is_element_in_poset(id, value1)) {
+        // Elements added without a label of their own get it now.
+        for (string_id_t sid : {lower, upper}) {
+            if (labeling.data != nullptr && labeling.data->offset.count(sid) == 0) {
+                label_element(labeling, poset, sid);
+            }
+        }
+        if (mutable_labels(labeling) == nullptr) {
+            return;
+        }
+
+        label_data_t& data = *labeling.data;
+
+        // Elements whose labels must cover the label at the given offset.
+        std::vector<std::pair<string_id_t, size_t>> stack = {{upper, data.offset.at(lower)}};
+        while (!stack.empty()) {
+            auto [v, covered] = stack.back();
+            stack.pop_back();
+
+            auto it = data.offset.find(v);
+            if (it == data.offset.end()) {
+                drop_labels(labeling);
+                return;
+            }
+            if (widen_label(data, covered, it->second)) {
+                for (auto& [neighbour, relation] : edges_of(poset, v)) {
+                    if (relation == ELEMENT_LESS) {
+                        stack.push_back({neighbour, it->second});
+                    }
+                }
+            }
+        }
+    }
+
+    /*
+     * Checks if lower < upper with a depth-first search that skips elements whose labels
+     * show that 'lower' cannot be below them. Elements without labels are never skipped.
+     * The number of visited elements is added to 'visits'.
+     */
+    bool labeled_search(const poset_t& poset, const label_data_t* data,
+                        string_id_t lower, string_id_t upper, size_t& visits) {
+        const size_t* lower_label = nullptr;
+        if (data != nullptr && data->offset.count(lower) > 0) {
+            lower_label = &data->offset.at(lower);
+        }
+
+        auto may_be_above_lower = [&](string_id_t v) {
+            if (lower_label == nullptr) {
+                return true;
+            }
+            auto it = data->offset.find(v);
+            return it == data->offset.end() || labels_allow(*data, *lower_label, it->second);
+        };
+
+        if (!may_be_above_lower(upper)) {
+            return false;
+        }
+
+        scratch_t scratch;
+        visited_set_t visited(scratch.resource());
+        visited.insert(upper);
+        std::pmr::vector<string_id_t> stack(scratch.resource());
+        stack.push_back(upper);
+        bool found = false;
+        while (!stack.empty() && !found) {
+            string_id_t v = stack.back();
+            stack.pop_back();
+
+            for (auto& [neighbour, relation] : edges_of(poset, v)) {
+                if (relation != ELEMENT_GREATER) {
+                    continue;
+                }
+                if (neighbour == lower) {
+                    found = true;
+                    break;
+                }
+                if (visited.insert(neighbour).second && may_be_above_lower(neighbour)) {
+                    stack.push_back(neighbour);
+                }
+            }
+        }
+
+        visits += visited.size();
+        return found;
+    }
+
+    /*
+     * Checks if lower < upper in a poset with labels enabled. Dropped labels are rebuilt once
+     * the searches done without them have visited as many elements as the rebuild takes,
+     * so rebuilding costs at most as much as the searches it speeds up.
+     */
+    bool labeled_relation_exists(labeling_t& labeling, const poset_t& poset,
+                                 string_id_t lower, string_id_t upper) {
+        if (labeling.data == nullptr &&
+                labeling.unlabeled_visits >= poset.elements.size() * labeling.dimensions) {
+            labeling.data = build_labels(poset, labeling.dimensions);
+            labeling.widened_edges = 0;
+        }
+
+        size_t labeled_visits = 0;
+        return labeled_search(poset, labeling.data.get(), lower, upper,
+                              labeling.data == nullptr ? labeling.unlabeled_visits : labeled_visits);
+    }
+
+    /*
+    * Works the same way as 'poset_test' (checks if value1 <= value2),
+    * but doesn't print messages and doesn't check input data for validity.
+    * The 'poset_test' function may print messages,
+    * which is not needed when used as a helper function.
+.
+    */
+    bool does_relation_exist(poset_id_t id, char const* value1, char const* value2) {
+        string_id_t sid1 = get_string_id(value1), sid2 = get_string_id(value2);
+        if (sid1 == sid2) { // We assume that the element is in relation with itself.
+            return true;
+        }
+        if (labeling_t* labeling = find_labeling(id)) {
+            return labeled_relation_exists(*labeling, view_poset(id), sid1, sid2);
+        }
+        return path_exists(view_poset(id), sid1, sid2);
+    }
+
+    // Fewer pairs are answered by separate searches, which can be cut short by labels.
+    const size_t SWEEP_MIN_PAIRS = 64;
+
+    /*
+     * Answers poset_test for all pairs at once. The values must be valid, elements not in the poset
+     * precede nothing. Read-only posets are answered pair by pair.
+     */
+    std::vector<char> test_relations(poset_id_t id, const std::vector<std::pair<char const*, char const*>>& pairs) {
+        std::vector<char> results(pairs.size(), false);
+
+        if (is_read_only(id)) {
+            const image_view_t& view = mapped_poset(id).view;
+            for (size_t i = 0; i < pairs.size(); i++) {
+                uint64_t lower = image_find(view, pairs[i].first), upper = image_find(view, pairs[i].second);
+                results[i] = lower < view.element_count && upper < view.element_count &&
+                             image_test(view, lower, upper);
+            }
+            return results;
+        }
+
+        if (pairs.size() < SWEEP_MIN_PAIRS) {
+            for (size_t i = 0; i < pairs.size(); i++) {
+                results[i] = is_element_in_poset(id, pairs[i].first) && is_element_in_poset(id, pairs[i].second) &&
+                             does_relation_exist(id, pairs[i].first, pairs[i].second);
+            }
+            return results;
+        }
+
+        std::vector<std::pair<string_id_t, string_id_t>> sids;
+        std::vector<size_t> positions;
+        for (size_t i = 0; i < pairs.size(); i++) {
+            if (is_element_in_poset(id, pairs[i].first) && is_element_in_poset(id, pairs[i].second)) {
+                sids.push_back({get_string_id(pairs[i].first), get_string_id(pairs[i].second)});
+                positions.push_back(i);
+            }
+        }
+
+        std::vector<char> answers = test_many(view_poset(id), sids, std::max(1u, std::thread::hardware_concurrency()));
+        for (size_t i = 0; i < answers.size(); i++) {
+            results[positions[i]] = answers[i];
+        }
+        return results;
+    }
+
+    /*
+     * Checks if the poset with the given id exists and
+     * if value1 and value2 are both not NULL, and both belong to the given poset.
+     * Read-only posets are accepted only if 'allow_read_only' is set.
+     */
+    bool validate_arguments(poset_id_t id, char const* value1,
+                            char const* value2, const std::string& function_name,
+                            bool allow_read_only = false) {
+
+        if constexpr (DEBUG) {
+            print_debug_message(function_name, "(", std::to_string(id), ", ",
+                                char_pointer_to_string(value1), ", ",
+                                char_pointer_to_string(value2), ")");
+
+            if (value1 == NULL) {
+                print_debug_message(function_name, ": invalid value1 (NULL)");
+            }
+            if (value2 == NULL) {
+                print_debug_message(function_name, ": invalid value2 (NULL)");
+            }
+        }
+
+        bool does_poset_exist = poset_exists(id) || (allow_read_only && is_read_only(id));
+        if constexpr (DEBUG) {
+            if (!does_poset_exist) {
+                print_does_not_exists(id, function_name);
+            }
+        }
+
+        if (value1 == NULL || value2 == NULL || !does_poset_exist) {
+            return false;
+        }
+
+        if (!is_element_in_poset(id, value1)) {
             if constexpr (DEBUG) {
                 print_debug_message(function_name, ": poset ", std::to_string(id),
                                     ", element \"", value1, "\" does not exist");
             }
-            return false;
+            return false;
+        }
+        else if (!is_element_in_poset(id, value2)) {
+            if constexpr (DEBUG) {
+                print_debug_message(function_name, ": poset ", std::to_string(id),
+                                    ", element \"", value2, "\" does not exist" );
+            }
+            return false;
+        }
+
+        return true;
+    }
+
+    // ----- Lower and upper sets ----- //
+
+    enum class subset_t {
+        LOWER_SET, UPPER_SET, MINIMAL, MAXIMAL
+    };
+
+    // Elements reachable from 'sid' through edges with the given relation, without 'sid' itself.
+    std::vector<string_id_t> collect_reachable(const poset_t& poset, string_id_t sid, relation_t direction) {
+        scratch_t scratch;
+        visited_set_t visited(scratch.resource());
+        visited.insert(sid);
+        std::pmr::vector<string_id_t> stack(scratch.resource());
+        stack.push_back(sid);
+        std::vector<string_id_t> result;
+
+        while (!stack.empty()) {
+            string_id_t v = stack.back();
+            stack.pop_back();
+
+            for (auto& [neighbour, relation] : edges_of(poset, v)) {
+                if (relation == direction && visited.insert(neighbour).second) {
+                    result.push_back(neighbour);
+                    stack.push_back(neighbour);
+                }
+            }
+        }
+
+        return result;
+    }
+
+    std::vector<string_id_t> collect_subset(const poset_t& poset, string_id_t sid, subset_t subset) {
+        switch (subset) {
+            case subset_t::LOWER_SET:
+                return collect_reachable(poset, sid, ELEMENT_GREATER);
+            case subset_t::UPPER_SET:
+                return collect_reachable(poset, sid, ELEMENT_LESS);
+            case subset_t::MINIMAL:
+                return std::vector<string_id_t>(poset.minimal.begin(), poset.minimal.end());
+            default:
+                return std::vector<string_id_t>(poset.maximal.begin(), poset.maximal.end());
+        }
+    }
+
+    /*
+     * The same as collect_subset, but for an image. Lower and upper sets are read from
+     * the closure index if it's present, otherwise, they are searched for.
+     */
+    std::vector<uint64_t> collect_image_subset(const image_view_t& view, uint64_t i, subset_t subset) {
+        const uint64_t n = view.element_count;
+        std::vector<uint64_t> result;
+
+        if (subset == subset_t::MINIMAL || subset == subset_t::MAXIMAL) {
+            std::vector<bool> has_greater(n, false);
+            for (uint64_t e = 0; e < view.edge_offsets[n]; e++) {
+                has_greater[view.edge_targets[e]] = true;
+            }
+            for (uint64_t v = 0; v < n; v++) {
+                bool is_minimal = view.edge_offsets[v] == view.edge_offsets[v + 1];
+                if (subset == subset_t::MINIMAL ? is_minimal : !has_greater[v]) {
+                    result.push_back(v);
+                }
+            }
+            return result;
+        }
+
+        if (view.closure_words > 0) {
+            for (uint64_t v = 0; v < n; v++) {
+                if (v != i && (subset == subset_t::LOWER_SET ? image_test(view, v, i) : image_test(view, i, v))) {
+                    result.push_back(v);
+                }
+            }
+            return result;
+        }
+
+        // Upper sets need the edges reversed: element v lists the elements directly greater than it.
+        std::vector<uint64_t> offsets(view.edge_offsets, view.edge_offsets + n + 1);
+        std::vector<uint64_t> targets(view.edge_targets, view.edge_targets + view.edge_offsets[n]);
+        if (subset == subset_t::UPPER_SET) {
+            std::vector<uint64_t> counts(n + 1, 0);
+            for (uint64_t target : targets) {
+                counts[target + 1]++;
+            }
+            for (uint64_t v = 0; v < n; v++) {
+                counts[v + 1] += counts[v];
+            }
+            offsets = counts;
+            for (uint64_t v = 0; v < n; v++) {
+                for (uint64_t e = view.edge_offsets[v]; e < view.edge_offsets[v + 1]; e++) {
+                    targets[counts[view.edge_targets[e]]++] = v;
+                }
+            }
+        }
+
+        std::vector<bool> visited(n, false);
+        std::vector<uint64_t> stack = {i};
+        visited[i] = true;
+        while (!stack.empty()) {
+            uint64_t v = stack.back();
+            stack.pop_back();
+
+            for (uint64_t e = offsets[v]; e < offsets[v + 1]; e++) {
+                if (!visited[targets[e]]) {
+                    visited[targets[e]] = true;
+                    result.push_back(targets[e]);
+                    stack.push_back(targets[e]);
+                }
+            }
+        }
+
+        return result;
+    }
+
+    /*
+     * Calls the visitor (if it's not NULL) for every element of the chosen subset and returns the number
+     * of the elements. The subset is collected first, so the visitor may call other poset functions.
+     */
+    size_t visit_subset(poset_id_t id, char const* value, subset_t subset,
+                        visitor_t visitor, void* context) {
+        if (is_read_only(id)) {
+            const image_view_t& view = mapped_poset(id).view;
+            uint64_t i = value == NULL ? 0 : image_find(view, value);
+            std::vector<uint64_t> elements = collect_image_subset(view, i, subset);
+
+            if (visitor != NULL) {
+                for (uint64_t v : elements) {
+                    visitor(std::string(image_element(view, v)).c_str(), context);
+                }
+            }
+            return elements.size();
+        }
+
+        string_id_t sid = value == NULL ? 0 : get_string_id(value);
+        std::vector<string_id_t> elements = collect_subset(view_poset(id), sid, subset);
+
+        if (visitor != NULL) {
+            std::vector<std::string> names;
+            names.reserve(elements.size());
+            for (string_id_t v : elements) {
+                names.push_back(*id_to_string().at(v));
+            }
+            for (const std::string& name : names) {
+                visitor(name.c_str(), context);
+            }
+        }
+        return elements.size();
+    }
+
+    size_t visit_element_subset(poset_id_t id, char const* value, subset_t subset,
+                                visitor_t visitor, void* context,
+                                const std::string& function_name) {
+        if constexpr (DEBUG) {
+            print_debug_message(function_name, "(", id, ", ", char_pointer_to_string(value), ")");
+        }
+
+        bool does_poset_exist = poset_exists(id) || is_read_only(id);
+        if (value == NULL || !does_poset_exist || !is_element_in_poset(id, value)) {
+            if constexpr (DEBUG) {
+                if (value == NULL)
+                    print_debug_message(function_name, ": invalid value (NULL)");
+                else if (!does_poset_exist)
+                    print_does_not_exists(id, function_name);
+                else
+                    print_debug_message(function_name, ": poset ", id, ", element \"", value, "\" does not exist");
+            }
+            return 0;
+        }
+
+        size_t count = visit_subset(id, value, subset, visitor, context);
+
+        if constexpr (DEBUG) {
+            print_debug_message(function_name, ": poset ", id, ", ", count, " element(s) ",
+                                (subset == subset_t::LOWER_SET ? "below" : "above"), " \"", value, "\"");
+        }
+
+        return count;
+    }
+
+    size_t visit_extremal(poset_id_t id, subset_t subset, visitor_t visitor, void* context,
+                          const std::string& function_name) {
+        if constexpr (DEBUG) {
+            print_debug_message(function_name, "(", id, ")");
+        }
+
+        if (!poset_exists(id) && !is_read_only(id)) {
+            if constexpr (DEBUG) {
+                print_does_not_exists(id, function_name);
+            }
+            return 0;
+        }
+
+        size_t count = visit_subset(id, NULL, subset, visitor, context);
+
+        if constexpr (DEBUG) {
+            print_debug_message(function_name, ": poset ", id, " has ", count, " ",
+                                (subset == subset_t::MINIMAL ? "minimal" : "maximal"), " element(s)");
+        }
+
+        return count;
+    }
+
+    // ----- Saving and loading ----- //
+
+    template<typename T>
+    inline void write_array(std::ofstream& out, const T* data, size_t count) {
+        out.write(reinterpret_cast<const char*>(data), count * sizeof(T));
+    }
+
+    /*
+     * Writes the file with 'write' under a temporary name in the same directory and renames it
+     * over 'path', so that a poset opened from the old file with 'poset_open' keeps its mapping.
+     */
+    template<typename Write>
+    bool replace_file(char const* path, Write write) {
+        std::string temporary = std::string(path) + ".tmp";
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        write(out);
+        out.close();
+
+        if (out.fail() || rename(temporary.c_str(), path) != 0) {
+            unlink(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     * Computes closure rows of the graph given in CSR form (see the image layout).
+     * Elements are finished in post-order, so the rows of all lesser elements
+     * are complete when a row is being computed.
+     */
+    std::vector<uint64_t> compute_closure(const std::vector<uint64_t>& edge_offsets,
+                                          const std::vector<uint32_t>& edge_targets) {
+        const uint64_t n = edge_offsets.size() - 1, words = closure_words(n);
+        std::vector<uint64_t> closure(n * words, 0);
+        std::vector<bool> done(n, false);
+        std::vector<std::pair<uint64_t, uint64_t>> stack; // Element and its next edge to visit.
+
+        for (uint64_t root = 0; root < n; root++) {
+            if (!done[root]) {
+                stack.push_back({root, edge_offsets[root]});
+            }
+
+            while (!stack.empty()) {
+                uint64_t v = stack.back().first;
+                if (stack.back().second < edge_offsets[v + 1]) {
+                    uint64_t u = edge_targets[stack.back().second++];
+                    if (!done[u]) {
+                        stack.push_back({u, edge_offsets[u]});
+                    }
+                    continue;
+                }
+
+                uint64_t* row = &closure[v * words];
+                for (uint64_t e = edge_offsets[v]; e < edge_offsets[v + 1]; e++) {
+                    uint64_t u = edge_targets[e];
+                    const uint64_t* lesser_row = &closure[u * words];
+                    for (uint64_t w = 0; w < words; w++) {
+                        row[w] |= lesser_row[w];
+                    }
+                    row[u / 64] |= uint64_t(1) << (u % 64);
+                }
+
+                done[v] = true;
+                stack.pop_back();
+            }
+        }
+
+        return closure;
+    }
+
+    bool save_poset(const poset_t& poset, char const* path, bool with_closure) {
+        std::vector<std::pair<const std::string*, string_id_t>> elements;
+        elements.reserve(poset.elements.size());
+        for (auto& [sid, edges] : poset.elements) {
+            elements.push_back({id_to_string().at(sid), sid});
+        }
+        std::sort(elements.begin(), elements.end(), [](auto const& a, auto const& b) {
+            return *a.first < *b.first;
+        });
+
+        std::unordered_map<string_id_t, dense_index_t> index;
+        for (size_t i = 0; i < elements.size(); i++) {
+            index[elements[i].second] = i;
+        }
+
+        std::vector<uint64_t> string_offsets = {0}, edge_offsets = {0};
+        std::vector<uint32_t> edge_targets;
+        for (auto& [name, sid] : elements) {
+            string_offsets.push_back(string_offsets.back() + name->size());
+
+            for (auto& [neighbour, relation] : edges_of(poset, sid)) {
+                if (relation == ELEMENT_GREATER) {
+                    edge_targets.push_back(index.at(neighbour));
+                }
+            }
+            std::sort(edge_targets.begin() + edge_offsets.back(), edge_targets.end());
+            edge_offsets.push_back(edge_targets.size());
+        }
+
+        image_header_t header;
+        std::memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+        header.version = IMAGE_VERSION;
+        header.flags = with_closure ? IMAGE_HAS_CLOSURE : 0;
+        header.element_count = elements.size();
+        header.edge_count = edge_targets.size();
+        header.strings_size = string_offsets.back();
+
+        return replace_file(path, [&](std::ofstream& out) {
+            write_array(out, &header, 1);
+            write_array(out, string_offsets.data(), string_offsets.size());
+            write_array(out, edge_offsets.data(), edge_offsets.size());
+            edge_targets.resize(padded_targets_size(header.edge_count) / sizeof(uint32_t), 0);
+            write_array(out, edge_targets.data(), edge_targets.size());
+            if (with_closure) {
+                edge_targets.resize(header.edge_count);
+                std::vector<uint64_t> closure = compute_closure(edge_offsets, edge_targets);
+                write_array(out, closure.data(), closure.size());
+            }
+            for (auto& [name, sid] : elements) {
+                write_array(out, name->data(), name->size());
+            }
+        });
+    }
+
+    // Saving over the file of the poset itself is safe, as the mapping keeps the old file.
+    bool save_mapped_poset(const mapped_poset_t& mapped, char const* path) {
+        return replace_file(path, [&](std::ofstream& out) {
+            write_array(out, mapped.mapping.get(), mapped.length);
+        });
+    }
+
+    // Checks that the image describes a partial order, i.e. that its graph has no cycles.
+    bool is_image_acyclic(const image_view_t& view) {
+        const uint64_t n = view.element_count;
+        std::vector<uint64_t> greater_count(n, 0), queue;
+
+        for (uint64_t e = 0; e < view.edge_offsets[n]; e++) {
+            greater_count[view.edge_targets[e]]++;
+        }
+        for (uint64_t i = 0; i < n; i++) {
+            if (greater_count[i] == 0) {
+                queue.push_back(i);
+            }
+        }
+        for (size_t head = 0; head < queue.size(); head++) {
+            uint64_t v = queue[head];
+            for (uint64_t e = view.edge_offsets[v]; e < view.edge_offsets[v + 1]; e++) {
+                if (--greater_count[view.edge_targets[e]] == 0) {
+                    queue.push_back(view.edge_targets[e]);
+                }
+            }
+        }
+
+        return queue.size() == n;
+    }
+
+    // Creates a new poset from a validated, acyclic image. No relation is checked again.
+    poset_id_t load_image(const image_view_t& view) {
+        poset_id_t pid = add_poset();
+        poset_t& poset = get_poset(pid);
+        std::vector<string_id_t> sids(view.element_count);
+
+        poset.elements.reserve(view.element_count);
+        for (uint64_t i = 0; i < view.element_count; i++) {
+            std::string name(image_element(view, i));
+            sids[i] = get_string_id(name.c_str(), true);
+            add_element(poset, sids[i]);
+            add_string_reference(sids[i]);
+        }
+
+        for (uint64_t i = 0; i < view.element_count; i++) {
+            for (uint64_t e = view.edge_offsets[i]; e < view.edge_offsets[i + 1]; e++) {
+                add_edge(poset, sids[i], sids[view.edge_targets[e]]);
+            }
+        }
+
+        return pid;
+    }
+
+    // ----- Memory usage ----- //
+
+    // Estimated from the number of labeled elements, the map of offsets doesn't use an arena.
+    size_t label_memory_usage(const label_data_t& data) {
+        return sizeof(label_data_t) + data.labels.capacity() * sizeof(uint32_t) +
+               data.offset.bucket_count() * sizeof(void*) +
+               data.offset.size() * (sizeof(void*) + sizeof(std::pair<const string_id_t, size_t>));
+    }
+
+    // Arenas shared with clones are counted in full, as long as the poset has relations in them.
+    size_t poset_memory(poset_id_t pid) {
+        const poset_slot_t& slot = slot_of(pid);
+        if (slot.mapped != nullptr) {
+            return slot.mapped->length;
+        }
+
+        const poset_t& poset = slot.poset->graph();
+        size_t bytes = arena_bytes(poset) + poset.table_arena.bytes();
+        if (slot.labeling != nullptr && slot.labeling->data != nullptr) {
+            bytes += label_memory_usage(*slot.labeling->data);
+        }
+
+        return bytes;
+    }
+
+    // Memory shared between posets is counted once.
+    size_t total_memory() {
+        size_t bytes = arena_bytes_total;
+        std::unordered_set<const void*> counted;
+
+        for (const poset_slot_t& slot : poset_table().slots) {
+            if (slot.labeling != nullptr && slot.labeling->data != nullptr &&
+                    counted.insert(slot.labeling->data.get()).second) {
+                bytes += label_memory_usage(*slot.labeling->data);
+            }
+            if (slot.mapped != nullptr && counted.insert(slot.mapped->mapping.get()).second) {
+                bytes += slot.mapped->length;
+            }
+        }
+
+        return bytes;
+    }
+
+    // ----- Changing posets ----- //
+
+    /*
+     * Changes shared by the API functions, which check their arguments first,
+     * and by the journal replay, which trusts the journal.
+     */
+
+    void insert_element(poset_id_t pid, char const* value) {
+        string_id_t sid = get_string_id(value, true);
+        add_element(get_poset(pid), sid);
+        add_string_reference(sid);
+
+        if (labeling_t* labeling = find_labeling(pid)) {
+            label_element(*labeling, view_poset(pid), sid);
+        }
+    }
+
+    // Adds the relation value1 < value2 between unrelated elements.
+    void add_relation(poset_id_t pid, string_id_t sid1, string_id_t sid2) {
+        poset_engine::add_relation(get_poset(pid), sid1, sid2);
+
+        if (labeling_t* labeling = find_labeling(pid)) {
+            update_labels_after_add(*labeling, view_poset(pid), sid1, sid2);
+        }
+    }
+
+    // Deletes the relation value1 < value2, which must pass can_be_removed.
+    void delete_relation(poset_id_t pid, string_id_t sid1, string_id_t sid2) {
+        poset_engine::delete_relation(get_poset(pid), sid1, sid2);
+    }
+
+    void remove_element(poset_id_t pid, char const* value) {
+        string_id_t sid = get_string_id(value);
+        poset_engine::remove_element(get_poset(pid), sid);
+        remove_string_reference(sid, value);
+    }
+
+    // The values must belong to the poset and be distinct.
+    void remove_many_elements(poset_id_t pid, const std::vector<char const*>& values) {
+        std::unordered_set<string_id_t> sids;
+        for (char const* value : values) {
+            sids.insert(get_string_id(value));
+        }
+
+        remove_elements(get_poset(pid), sids);
+
+        for (char const* value : values) {
+            remove_string_reference(get_string_id(value), value);
+        }
+    }
+
+    /*
+     * Merges the poset 'source' into 'pid', see poset_merge. The result are the rejected relations.
+     * Labels of 'pid' are built again, as most of its relations may have changed.
+     */
+    std::vector<std::pair<string_id_t, string_id_t>> merge_posets(poset_id_t pid, poset_id_t source) {
+        if (&view_poset(pid) == &view_poset(source)) {
+            return {};
+        }
+
+        poset_t& target = get_poset(pid);
+        const poset_t& merged = view_poset(source);
+        for (auto& [sid, edges] : merged.elements) {
+            if (target.elements.count(sid) == 0) {
+                add_element(target, sid);
+                add_string_reference(sid);
+            }
+        }
+
+        auto rejected = merge_graph(target, merged, [](string_id_t sid1, string_id_t sid2) {
+            return *id_to_string().at(sid1) < *id_to_string().at(sid2);
+        });
+
+        if (labeling_t* labeling = find_labeling(pid)) {
+            drop_labels(*labeling);
+        }
+        return rejected;
+    }
+
+    void set_labeling(poset_id_t pid, unsigned dimensions) {
+        if (dimensions == 0) {
+            slot_of(pid).labeling = nullptr;
+            return;
+        }
+
+        std::unique_ptr<labeling_t>& labeling = slot_of(pid).labeling;
+        if (labeling == nullptr) {
+            labeling = std::make_unique<labeling_t>();
+        }
+        labeling->dimensions = dimensions;
+        drop_labels(*labeling);
+    }
+
+    // ----- Journal ----- //
+
+    // Builds payloads of journal records, see the journal layout.
+    class journal_writer_t {
+    public:
+        void put(uint64_t value) {
+            while (value >= 0x80) {
+                data.push_back(char(value | 0x80));
+                value >>= 7;
+            }
+            data.push_back(char(value));
+        }
+
+        void put(std::string_view value) {
+            put(value.size());
+            data.append(value);
+        }
+
+        void put(const std::vector<std::string_view>& values) {
+            put(values.size());
+            for (std::string_view value : values) {
+                put(value);
+            }
+        }
+
+        // Elements sorted by name, then the relations as pairs of their positions (greater, lesser).
+        void put(const poset_t& poset) {
+            std::vector<std::pair<const std::string*, string_id_t>> elements;
+            for (auto& [sid, edges] : poset.elements) {
+                elements.push_back({id_to_string().at(sid), sid});
+            }
+            std::sort(elements.begin(), elements.end(), [](auto const& a, auto const& b) {
+                return *a.first < *b.first;
+            });
+
+            std::unordered_map<string_id_t, uint64_t> index;
+            std::vector<uint64_t> relations;
+            put(elements.size());
+            for (size_t i = 0; i < elements.size(); i++) {
+                index[elements[i].second] = i;
+                put(*elements[i].first);
+            }
+            for (auto& [name, sid] : elements) {
+                for (auto& [neighbour, relation] : edges_of(poset, sid)) {
+                    if (relation == ELEMENT_GREATER) {
+                        relations.push_back(index.at(sid));
+                        relations.push_back(index.at(neighbour));
+                    }
+                }
+            }
+            put(relations.size() / 2);
+            for (uint64_t position : relations) {
+                put(position);
+            }
+        }
+
+        std::string data;
+    };
+
+    // Reads payloads written by journal_writer_t. Reading past the end only clears 'ok'.
+    class journal_reader_t {
+    public:
+        journal_reader_t(const char* data, size_t length) : cursor(data), end(data + length) {}
+
+        uint64_t get() {
+            uint64_t value = 0;
+            for (unsigned shift = 0; shift < 64; shift += 7) {
+                if (cursor == end) {
+                    ok = false;
+                    return 0;
+                }
+                uint8_t byte = *cursor++;
+                value |= uint64_t(byte & 0x7f) << shift;
+                if (byte < 0x80) {
+                    return value;
+                }
+            }
+            ok = false;
+            return 0;
+        }
+
+        std::string get_string() {
+            uint64_t length = get();
+            if (!ok || length > uint64_t(end - cursor)) {
+                ok = false;
+                return std::string();
+            }
+            cursor += length;
+            return std::string(cursor - length, length);
+        }
+
+        bool at_end() const {
+            return cursor == end;
+        }
+
+        bool ok = true;
+
+    private:
+        const char* cursor;
+        const char* end;
+    };
+
+    // FNV-1a, enough to tell a torn or damaged record from a complete one.
+    uint32_t journal_checksum(const char* data, size_t length) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; i++) {
+            hash = (hash ^ uint8_t(data[i])) * 16777619u;
+        }
+        return hash;
+    }
+
+    void append_frame(std::string& out, const std::string& payload) {
+        uint32_t frame[2] = {uint32_t(payload.size()), journal_checksum(payload.data(), payload.size())};
+        out.append(reinterpret_cast<const char*>(frame), sizeof(frame));
+        out.append(payload);
+    }
+
+    // The payload of the frame at 'offset', or false if the frame is torn or damaged.
+    bool read_frame(const char* data, size_t length, size_t& offset, journal_reader_t& payload) {
+        uint32_t frame[2];
+        if (length - offset < sizeof(frame)) {
+            return false;
+        }
+        std::memcpy(frame, data + offset, sizeof(frame));
+        if (length - offset - sizeof(frame) < frame[0] ||
+                journal_checksum(data + offset + sizeof(frame), frame[0]) != frame[1]) {
+            return false;
+        }
+
+        payload = journal_reader_t(data + offset + sizeof(frame), frame[0]);
+        offset += sizeof(frame) + frame[0];
+        return true;
+    }
+
+    inline journal_header_t make_journal_header(const char (&magic)[8]) {
+        journal_header_t header = {};
+        std::memcpy(header.magic, magic, sizeof(header.magic));
+        header.version = JOURNAL_VERSION;
+        return header;
+    }
+
+    inline bool is_journal_header_valid(const char* data, size_t length, const char (&magic)[8]) {
+        journal_header_t header;
+        if (length < sizeof(header)) {
+            return false;
+        }
+        std::memcpy(&header, data, sizeof(header));
+        return std::memcmp(header.magic, magic, sizeof(header.magic)) == 0 && header.version == JOURNAL_VERSION;
+    }
+
+    bool write_all(int fd, const char* data, size_t length) {
+        while (length > 0) {
+            ssize_t written = write(fd, data, length);
+            if (written < 0) {
+                return false;
+            }
+            data += written;
+            length -= written;
+        }
+        return true;
+    }
+
+    // Syncs the directory of 'path', so that a file renamed into it survives a crash.
+    bool sync_directory(const std::string& path) {
+        size_t slash = path.rfind('/');
+        std::string directory = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+        int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd < 0) {
+            return false;
+        }
+        bool status = fsync(fd) == 0;
+        close(fd);
+        return status;
+    }
+
+    /*
+     * Runs on the flusher thread. Records appended while the previous group is being written,
+     * or during the commit interval, are written and synced together.
+     */
+    void run_flusher(journal_t& journal) {
+        std::unique_lock<std::mutex> lock(journal.mutex);
+
+        while (true) {
+            journal.wake_flusher.wait(lock, [&journal] {
+                return journal.stopping || !journal.pending.empty();
+            });
+            if (journal.pending.empty()) {
+                return;
+            }
+            journal.wake_flusher.wait_for(lock, journal.commit_interval, [&journal] {
+                return journal.stopping || journal.sync_requested;
+            });
+
+            std::string group;
+            group.swap(journal.pending);
+            uint64_t lsn = journal.pending_lsn;
+            journal.sync_requested = false;
+
+            lock.unlock();
+            bool status = write_all(journal.fd, group.data(), group.size()) && fdatasync(journal.fd) == 0;
+            lock.lock();
+
+            journal.failed |= !status;
+            journal.synced_lsn = lsn;
+            journal.synced.notify_all();
+        }
+    }
+
+    // Waits until all appended records are on disk. The result is false if any write has failed.
+    bool sync_journal(journal_t& journal) {
+        std::unique_lock<std::mutex> lock(journal.mutex);
+        journal.sync_requested = true;
+        journal.wake_flusher.notify_one();
+        journal.synced.wait(lock, [&journal] {
+            return journal.synced_lsn >= journal.last_lsn;
+        });
+        return !journal.failed;
+    }
+
+    /*
+     * Writes the state of all posets: the sequence number of the last record, then for every slot
+     * its generation and kind (0 for an empty slot, 1 for a poset followed by its label dimensions
+     * and contents, 2 for a read-only poset).
+     */
+    bool write_snapshot(journal_t& journal) {
+        journal_writer_t payload;
+        const std::vector<poset_slot_t>& slots = poset_table().slots;
+
+        payload.put(journal.last_lsn);
+        payload.put(slots.size());
+        for (const poset_slot_t& slot : slots) {
+            payload.put(slot.generation);
+            if (slot.poset.has_value()) {
+                payload.put(1);
+                payload.put(slot.labeling == nullptr ? 0 : slot.labeling->dimensions);
+                payload.put(slot.poset->graph());
+            } else {
+                payload.put(slot.mapped != nullptr ? 2 : 0);
+            }
+        }
+
+        journal_header_t header = make_journal_header(SNAPSHOT_MAGIC);
+        std::string contents(reinterpret_cast<const char*>(&header), sizeof(header));
+        append_frame(contents, payload.data);
+
+        std::string path = journal.path + SNAPSHOT_SUFFIX, temporary = path + ".tmp";
+        int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        bool status = write_all(fd, contents.data(), contents.size()) && fsync(fd) == 0;
+        status = close(fd) == 0 && status;
+
+        if (!status || rename(temporary.c_str(), path.c_str()) != 0 || !sync_directory(path)) {
+            unlink(temporary.c_str());
+            return false;
+        }
+
+        journal.snapshot_bytes = contents.size();
+        return true;
+    }
+
+    // Replaces the journal with a snapshot. Records in the journal are already in the snapshot.
+    bool compact_journal(journal_t& journal) {
+        if (!sync_journal(journal) || !write_snapshot(journal)) {
+            return false;
+        }
+
+        // The flusher is idle, as there are no pending records.
+        if (ftruncate(journal.fd, sizeof(journal_header_t)) != 0 || fdatasync(journal.fd) != 0) {
+            std::lock_guard<std::mutex> lock(journal.mutex);
+            journal.failed = true;
+            return false;
+        }
+
+        journal.journal_bytes = sizeof(journal_header_t);
+        return true;
+    }
+
+    /*
+     * Appends a record of a successful change, if the journal is open. With a zero commit
+     * interval the call waits until the record is on disk.
+     */
+    template<typename... Ts>
+    void journal_append(journal_type_t type, poset_id_t pid, const Ts&... fields) {
+        journal_t* journal = journal_state().get();
+        if (journal == nullptr) {
+            return;
+        }
+
+        journal_writer_t record;
+        record.put(++journal->last_lsn);
+        record.put(type);
+        record.put(pid);
+        (record.put(fields), ...);
+
+        {
+            std::lock_guard<std::mutex> lock(journal->mutex);
+            append_frame(journal->pending, record.data);
+            journal->pending_lsn = journal->last_lsn;
+            if (journal->commit_interval.count() == 0 || journal->pending.size() >= GROUP_COMMIT_BYTES) {
+                journal->sync_requested = true;
+            }
+        }
+        journal->wake_flusher.notify_one();
+        journal->journal_bytes += JOURNAL_FRAME_SIZE + record.data.size();
+
+        if (journal->commit_interval.count() == 0) {
+            sync_journal(*journal);
+        }
+        if (journal->journal_bytes > std::max(JOURNAL_COMPACT_BYTES, 2 * journal->snapshot_bytes)) {
+            compact_journal(*journal);
+        }
+    }
+
+    // Takes the slot of the given id during recovery. The result is nullptr if the slot is in use.
+    poset_slot_t* claim_slot(poset_id_t id) {
+        std::vector<poset_slot_t>& slots = poset_table().slots;
+        poset_id_t index = id & POSET_SLOT_MASK;
+
+        if (index >= NO_FREE_SLOT) {
+            return nullptr;
+        }
+        if (index >= slots.size()) {
+            slots.resize(index + 1);
+        }
+
+        poset_slot_t& slot = slots[index];
+        if (slot.poset.has_value() || slot.mapped != nullptr) {
+            return nullptr;
+        }
+        slot.generation = id >> POSET_SLOT_BITS;
+        return &slot;
+    }
+
+    // Fills an empty poset with elements and relations written by journal_writer_t::put.
+    bool read_poset(journal_reader_t& in, poset_id_t pid) {
+        std::vector<string_id_t> sids(in.get());
+        poset_t& poset = get_poset(pid);
+
+        for (string_id_t& sid : sids) {
+            std::string name = in.get_string();
+            if (!in.ok || (is_string_mapped(name.c_str()) && poset.elements.count(get_string_id(name.c_str())) > 0)) {
+                return false;
+            }
+            sid = get_string_id(name.c_str(), true);
+            add_element(poset, sid);
+            add_string_reference(sid);
+        }
+
+        for (uint64_t relations = in.get(); in.ok && relations > 0; relations--) {
+            uint64_t greater = in.get(), lesser = in.get();
+            if (!in.ok || greater >= sids.size() || lesser >= sids.size()) {
+                return false;
+            }
+            add_edge(poset, sids[greater], sids[lesser]);
+        }
+
+        return in.ok;
+    }
+
+    // Checks that all elements belong to the poset during recovery.
+    template<typename... Ts>
+    bool are_in_poset(poset_id_t pid, const Ts&... values) {
+        return (is_element_in_poset(pid, values.c_str()) && ...);
+    }
+
+    // Applies a journal record, unless the poset or elements it refers to are missing.
+    bool replay_record(journal_reader_t& in, std::vector<poset_id_t>& reserved) {
+        uint64_t type = in.get();
+        poset_id_t pid = in.get();
+        poset_slot_t* slot = nullptr;
+        if (!in.ok) {
+            return false;
+        }
+
+        switch (type) {
+            case JOURNAL_NEW:
+            case JOURNAL_POSET:
+                if ((slot = claim_slot(pid)) == nullptr) {
+                    return false;
+                }
+                slot->poset.emplace();
+                return type == JOURNAL_NEW || read_poset(in, pid);
+
+            case JOURNAL_RESERVE:
+                if (claim_slot(pid) == nullptr) {
+                    return false;
+                }
+                reserved.push_back(pid);
+                return true;
+
+            case JOURNAL_CLONE: {
+                poset_id_t source = in.get();
+                if (!in.ok || !poset_exists(source) || (slot = claim_slot(pid)) == nullptr) {
+                    return false;
+                }
+                const poset_slot_t& source_slot = slot_of(source);
+                slot->poset = source_slot.poset;
+                if (source_slot.labeling != nullptr) {
+                    slot->labeling = std::make_unique<labeling_t>(*source_slot.labeling);
+                }
+                return true;
+            }
+
+            case JOURNAL_DELETE:
+                if (poset_exists(pid)) {
+                    remove_poset(pid);
+                } else if (find_slot(pid) != nullptr) {
+                    free_slot(pid);
+                } else {
+                    return false;
+                }
+                return true;
+        }
+
+        if (!poset_exists(pid)) {
+            return false;
+        }
+
+        switch (type) {
+            case JOURNAL_INSERT: {
+                std::string value = in.get_string();
+                if (!in.ok || is_element_in_poset(pid, value.c_str())) {
+                    return false;
+                }
+                insert_element(pid, value.c_str());
+                return true;
+            }
+
+            case JOURNAL_ADD:
+            case JOURNAL_DEL: {
+                std::string value1 = in.get_string(), value2 = in.get_string();
+                if (!in.ok || !are_in_poset(pid, value1, value2)) {
+                    return false;
+                }
+                string_id_t sid1 = get_string_id(value1.c_str()), sid2 = get_string_id(value2.c_str());
+                if (type == JOURNAL_ADD) {
+                    add_relation(pid, sid1, sid2);
+                } else {
+                    delete_relation(pid, sid1, sid2);
+                }
+                return true;
+            }
+
+            case JOURNAL_REMOVE: {
+                std::string value = in.get_string();
+                if (!in.ok || !are_in_poset(pid, value)) {
+                    return false;
+                }
+                // Much faster than remove_element, and the relation ends up the same.
+                remove_many_elements(pid, {value.c_str()});
+                return true;
+            }
+
+            case JOURNAL_REMOVE_MANY: {
+                std::vector<std::string> values(in.get());
+                std::unordered_set<std::string> distinct;
+                for (std::string& value : values) {
+                    value = in.get_string();
+                    if (!in.ok || !are_in_poset(pid, value) || !distinct.insert(value).second) {
+                        return false;
+                    }
+                }
+                std::vector<char const*> pointers;
+                for (const std::string& value : values) {
+                    pointers.push_back(value.c_str());
+                }
+                remove_many_elements(pid, pointers);
+                return true;
+            }
+
+            case JOURNAL_CLEAR:
+                clear_poset(pid);
+                return true;
+
+            case JOURNAL_LABELING: {
+                uint64_t dimensions = in.get();
+                if (!in.ok || dimensions > UINT_MAX) {
+                    return false;
+                }
+                set_labeling(pid, dimensions);
+                return true;
+            }
+
+            case JOURNAL_MERGE: {
+                poset_id_t source = in.get();
+                if (!in.ok || !poset_exists(source)) {
+                    return false;
+                }
+                merge_posets(pid, source);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Restores the posets from the snapshot, if there's one, and sets 'lsn' to the last record it includes.
+    bool read_snapshot(journal_t& journal, uint64_t& lsn, std::vector<poset_id_t>& reserved) {
+        size_t length = 0;
+        std::shared_ptr<const char> mapping = map_file((journal.path + SNAPSHOT_SUFFIX).c_str(), length);
+        lsn = 0;
+        if (mapping == nullptr) {
+            return access((journal.path + SNAPSHOT_SUFFIX).c_str(), F_OK) != 0;
+        }
+
+        size_t offset = sizeof(journal_header_t);
+        journal_reader_t in(nullptr, 0);
+        if (!is_journal_header_valid(mapping.get(), length, SNAPSHOT_MAGIC) ||
+                !read_frame(mapping.get(), length, offset, in)) {
+            return false;
+        }
+
+        lsn = in.get();
+        uint64_t slot_count = in.get();
+        for (uint64_t index = 0; in.ok && index < slot_count; index++) {
+            poset_id_t pid = (in.get() << POSET_SLOT_BITS) | index;
+            poset_slot_t* slot = claim_slot(pid);
+            uint64_t kind = in.get();
+
+            if (slot == nullptr || kind > 2) {
+                return false;
+            }
+            if (kind == 1) {
+                uint64_t dimensions = in.get();
+                slot->poset.emplace();
+                if (dimensions > UINT_MAX || !read_poset(in, pid)) {
+                    return false;
+                }
+                set_labeling(pid, dimensions);
+            } else if (kind == 2) {
+                reserved.push_back(pid);
+            }
+        }
+
+        journal.snapshot_bytes = length;
+        return in.ok && in.at_end();
+    }
+
+    /*
+     * Replays the records of the journal newer than the snapshot. A torn or damaged record ends
+     * the journal, it's cut off so that new records follow the last good one.
+     */
+    bool replay_journal(journal_t& journal, uint64_t snapshot_lsn, std::vector<poset_id_t>& reserved) {
+        struct stat file_stat;
+        if (fstat(journal.fd, &file_stat) != 0) {
+            return false;
+        }
+
+        journal.last_lsn = snapshot_lsn;
+        if (file_stat.st_size == 0) {
+            journal_header_t header = make_journal_header(JOURNAL_MAGIC);
+            journal.journal_bytes = sizeof(header);
+            return write_all(journal.fd, reinterpret_cast<const char*>(&header), sizeof(header)) &&
+                   fdatasync(journal.fd) == 0;
+        }
+
+        size_t length = 0;
+        std::shared_ptr<const char> mapping = map_file(journal.path.c_str(), length);
+        if (mapping == nullptr || !is_journal_header_valid(mapping.get(), length, JOURNAL_MAGIC)) {
+            return false;
+        }
+
+        size_t offset = sizeof(journal_header_t), end = offset;
+        journal_reader_t in(nullptr, 0);
+        while (read_frame(mapping.get(), length, offset, in)) {
+            uint64_t lsn = in.get();
+            if (!in.ok || (lsn > snapshot_lsn && !replay_record(in, reserved))) {
+                break;
+            }
+            journal.last_lsn = std::max(journal.last_lsn, lsn);
+            end = offset;
+        }
+
+        journal.journal_bytes = end;
+        return end == length || ftruncate(journal.fd, end) == 0;
+    }
+
+    // Ids of read-only posets become invalid and the free slots are collected again.
+    void finish_recovery(const std::vector<poset_id_t>& reserved) {
+        for (poset_id_t pid : reserved) {
+            if (find_slot(pid) != nullptr && !poset_exists(pid)) {
+                free_slot(pid);
+            }
+        }
+
+        poset_table_t& table = poset_table();
+        table.first_free = NO_FREE_SLOT;
+        for (size_t index = table.slots.size(); index-- > 0;) {
+            poset_slot_t& slot = table.slots[index];
+            if (!slot.poset.has_value() && slot.mapped == nullptr && slot.generation <= POSET_SLOT_MASK) {
+                slot.next_free = table.first_free;
+                table.first_free = index;
+            }
+        }
+    }
+
+    bool has_posets() {
+        for (const poset_slot_t& slot : poset_table().slots) {
+            if (slot.poset.has_value() || slot.mapped != nullptr) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void remove_all_posets() {
+        poset_table_t& table = poset_table();
+        for (size_t index = 0; index < table.slots.size(); index++) {
+            poset_id_t pid = (table.slots[index].generation << POSET_SLOT_BITS) | index;
+            if (table.slots[index].poset.has_value()) {
+                remove_poset(pid);
+            }
+        }
+        table = poset_table_t();
+    }
+
+    // Restores the posets from the snapshot and the journal at 'path' and opens the journal for appending.
+    bool open_journal(char const* path, unsigned commit_interval_ms) {
+        auto journal = std::make_unique<journal_t>();
+        journal->path = path;
+        journal->commit_interval = std::chrono::milliseconds(commit_interval_ms);
+        journal->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+
+        uint64_t snapshot_lsn = 0;
+        std::vector<poset_id_t> reserved;
+        if (journal->fd < 0 || !read_snapshot(*journal, snapshot_lsn, reserved) ||
+                !replay_journal(*journal, snapshot_lsn, reserved)) {
+            remove_all_posets();
+            return false;
+        }
+        finish_recovery(reserved);
+
+        journal->synced_lsn = journal->last_lsn;
+        journal->flusher = std::thread(run_flusher, std::ref(*journal));
+        journal_state() = std::move(journal);
+        return true;
+    }
+
+    // ----- Tracing API calls ----- //
+
+    // Id of the string in the string table, 0 if it's not interned.
+    inline uint64_t find_string_id(char const* str) {
+        auto it = string_to_id().find(str);
+        return it == string_to_id().end() ? 0 : it->second;
+    }
+
+    /*
+     * Records a call of an API function if tracing is enabled, otherwise it does nothing.
+     * The state of the poset and the ids of the values are taken before the call,
+     * the result and the duration when the object is destroyed.
+     */
+    class trace_call_t {
+    public:
+        trace_call_t(poset_trace::type_t type, poset_id_t id, char const* value1 = NULL,
+                     char const* value2 = NULL, uint64_t argument = 0)
+                : enabled(tracing_enabled.load(std::memory_order_relaxed)) {
+            if (!enabled) {
+                return;
+            }
+
+            values[0] = value1;
+            values[1] = value2;
+            record.type = type;
+            record.poset = id;
+            record.argument = argument;
+            record.value1 = value1 == NULL ? 0 : find_string_id(value1);
+            record.value2 = value2 == NULL ? 0 : find_string_id(value2);
+
+            bool exists = poset_exists(id), read_only = is_read_only(id);
+            record.flags = (exists ? poset_trace::POSET_EXISTS : 0) | (read_only ? poset_trace::POSET_READ_ONLY : 0);
+            if ((exists || read_only) && value1 != NULL && is_element_in_poset(id, value1)) {
+                record.flags |= poset_trace::VALUE1_IN_POSET;
+            }
+            if ((exists || read_only) && value2 != NULL && is_element_in_poset(id, value2)) {
+                record.flags |= poset_trace::VALUE2_IN_POSET;
+            }
+
+            start = trace_clock_t::now();
+        }
+
+        ~trace_call_t() {
+            if (!enabled) {
+                return;
+            }
+
+            auto end = trace_clock_t::now();
+            record.timestamp = trace_timestamp(start);
+            record.duration = std::min<uint64_t>(trace_timestamp(end) - record.timestamp, UINT32_MAX);
+
+            // Values interned by the call get their new ids, the others are traced inline.
+            resolve_value(values[0], record.value1);
+            resolve_value(values[1], record.value2);
+            for (listed_value_t& listed : listed_values) {
+                resolve_value(listed.value, listed.id);
+            }
+            push_trace_record(record);
+
+            for (size_t i = 0; i < listed_values.size(); i += 2) {
+                trace_record_t values_record = {};
+                values_record.type = poset_trace::VALUES;
+                values_record.argument = std::min<size_t>(listed_values.size() - i, 2);
+                values_record.value1 = listed_values[i].id;
+                values_record.flags = listed_values[i].in_poset ? poset_trace::VALUE1_IN_POSET : 0;
+                if (values_record.argument == 2) {
+                    values_record.value2 = listed_values[i + 1].id;
+                    values_record.flags |= listed_values[i + 1].in_poset ? poset_trace::VALUE2_IN_POSET : 0;
+                }
+                push_trace_record(values_record);
+            }
+        }
+
+        template<typename T>
+        T result(T value) {
+            record.result = value;
+            return value;
+        }
+
+        // For functions taking a second poset, which is passed as 'argument'.
+        void other_poset(poset_id_t id) {
+            if (enabled && poset_exists(id)) {
+                record.flags |= poset_trace::OTHER_POSET_EXISTS;
+            }
+        }
+
+        // For poset_remove_many called with NULL instead of an array of values.
+        void null_values() {
+            if (enabled) {
+                record.flags |= poset_trace::NULL_VALUES;
+            }
         }
-        else if (!is_element_in_poset(id, value2)) {
-            if constexpr (DEBUG) {
-                print_debug_message(function_name, ": poset ", std::to_string(id),
-                                    ", element \"", value2, "\" does not exist" );
+
+        // For poset_remove_many, every value before the call changes the poset, up to MAX_TRACED_VALUES.
+        void list_value(char const* value, bool in_poset) {
+            if (enabled && listed_values.size() < poset_trace::MAX_TRACED_VALUES) {
+                listed_values.push_back({value, value == NULL ? 0 : find_string_id(value), in_poset});
             }
-            return false;
         }
 
-        return true;
-    }
+    private:
+        struct listed_value_t {
+            char const* value;
+            uint64_t id;
+            bool in_poset;
+        };
 
-    void reachable_dfs(poset_t& poset, string_id_t v, std::unordered_set<string_id_t>& vis) {
-        vis.insert(v);
+        void resolve_value(char const* value, uint64_t& id) {
+            if (value == NULL || id != 0) {
+                return;
+            }
 
-        for (std::pair<const string_id_t, relation_t>& e : poset[v]) {
-            if (e.second == ELEMENT_GREATER && vis.find(e.first) == vis.end()) {
-                reachable_dfs(poset, e.first, vis);
+            id = find_string_id(value);
+            if (id == 0) {
+                id = poset_trace::INLINE_STRING | ++trace_registry().inline_strings;
+                trace_string(id, value);
             }
         }
-    }
 
-    inline std::unordered_set<string_id_t> reachable_from(poset_t& poset, poset_id_t source) {
-        std::unordered_set<string_id_t> vis;
-        reachable_dfs(poset, source, vis);
-        return vis;
-    }
+        bool enabled;
+        char const* values[2] = {NULL, NULL};
+        std::vector<listed_value_t> listed_values;
+        trace_record_t record = {};
+        trace_clock_t::time_point start;
+    };
 
-    inline void disconnect(poset_t& poset, string_id_t sid) {
-        for (edge_t neigh : poset[sid]) {
-            poset[neigh.first].erase(sid);
+    // Writes the string table and the records of all threads not dumped yet to 'path'.
+    bool dump_traces(char const* path) {
+        trace_registry_t& registry = trace_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+
+        poset_trace::file_header_t header = {};
+        std::memcpy(header.magic, poset_trace::FILE_MAGIC, sizeof(header.magic));
+        header.version = poset_trace::FILE_VERSION;
+        header.thread_count = registry.buffers.size();
+        header.string_count = id_to_string().size();
+        write_array(out, &header, 1);
+
+        for (auto& [sid, str] : id_to_string()) {
+            poset_trace::string_header_t string_header = {sid, str->size()};
+            write_array(out, &string_header, 1);
+            write_array(out, str->data(), str->size());
         }
-    }
 
-    bool can_be_removed(poset_t& poset, string_id_t lower, string_id_t upper) {
-        remove_edge(poset, upper, lower);
-        std::unordered_set<string_id_t> vis = reachable_from(poset, upper);
-        add_edge(poset, upper, lower);
+        for (auto& buffer : registry.buffers) {
+            std::vector<trace_record_t> records = drain_trace_buffer(*buffer);
+            poset_trace::thread_header_t thread_header = {buffer->thread, records.size()};
+            write_array(out, &thread_header, 1);
+            write_array(out, records.data(), records.size());
+        }
 
-        return vis.empty() || vis.count(lower) == 0;
+        tracing_strings.store(tracing_enabled.load());
+        return out.good();
     }
 
     namespace cxx {
 
         extern "C" poset_id_t poset_new() {
+            trace_call_t trace(poset_trace::POSET_NEW, POSET_INVALID_ID);
+
             poset_id_t pid = add_poset();
+            journal_append(JOURNAL_NEW, pid);
 
             if constexpr (DEBUG) {
                 print_debug_message("poset_new()\nposet_new: poset ", pid, " created");
             }
 
-            return pid;
+            return trace.result(pid);
         }
 
         extern "C" bool poset_insert(poset_id_t id, char const* value) {
+            trace_call_t trace(poset_trace::POSET_INSERT, id, value);
 
             if constexpr (DEBUG) {
                 if (value != NULL) {
@@ -361,23 +2589,20 @@ namespace {
             }
 
             if (value == NULL) {
-                return false;
+                return trace.result(false);
             }
 
             if (poset_exists(id)) {
-                string_id_t sid = get_string_id(value, true);
-                poset_t& poset = get_poset(id);
-
-                if (!is_string_in_poset(poset, value)) {
-                    poset[sid] = edge_collection_t();
-                    add_string_reference(sid);
+                if (!is_element_in_poset(id, value)) {
+                    insert_element(id, value);
+                    journal_append(JOURNAL_INSERT, id, value);
 
                     if constexpr (DEBUG) {
                         print_debug_message("poset_insert: poset ", std::to_string(id),
                                             ", element \"", value, "\" inserted" );
                     }
 
-                    return true;
+                    return trace.result(true);
                 }
                 else if constexpr (DEBUG) {
                     print_debug_message("poset_insert: poset ",  std::to_string(id),
@@ -388,71 +2613,117 @@ namespace {
                 print_does_not_exists(id, "poset_insert");
             }
 
-            return false;
+            return trace.result(false);
         }
 
         extern "C" bool poset_test(poset_id_t id, char const* value1, char const* value2) {
+            trace_call_t trace(poset_trace::POSET_TEST, id, value1, value2);
 
-            if (!validate_arguments(id, value1, value2, "poset_test")) {
-                return false;
+            if (!validate_arguments(id, value1, value2, "poset_test", true)) {
+                return trace.result(false);
+            }
+
+            bool result;
+            if (is_read_only(id)) {
+                const image_view_t& view = mapped_poset(id).view;
+                result = image_test(view, image_find(view, value1), image_find(view, value2));
+            } else {
+                result = does_relation_exist(id, value1, value2);
+            }
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_test: poset ", id, ", relation (\"", value1, "\", \"",
+                                    value2, "\") ",  (result ? "exists" : "does not exist"));
             }
 
-            string_id_t sid1 = get_string_id(value1);
-            string_id_t sid2 = get_string_id(value2);
+            return trace.result(result);
+        }
+
+        extern "C" size_t poset_test_many(poset_id_t id, char const* const* values1, char const* const* values2,
+                                          size_t n, bool* results) {
+            trace_call_t trace(poset_trace::POSET_TEST_MANY, id, NULL, NULL, n);
+
+            static const std::string FUNCTION_NAME = "poset_test_many";
+            if constexpr (DEBUG) {
+                print_debug_message(FUNCTION_NAME, "(", id, ", ", n, " pair(s))");
+            }
 
-            // We assume that the element is in relation with itself.
-            if (sid1 == sid2) {
+            if (!poset_exists(id) && !is_read_only(id)) {
                 if constexpr (DEBUG) {
-                    print_debug_message("poset_test: poset ", std::to_string(id),
-                                        ", relation (\"", value1, "\", \"", value2, "\") exists");
+                    print_does_not_exists(id, FUNCTION_NAME);
+                }
+                return trace.result(0);
+            }
+            if (n > 0 && (values1 == NULL || values2 == NULL || results == NULL)) {
+                if constexpr (DEBUG) {
+                    print_debug_message(FUNCTION_NAME, ": invalid arrays (NULL)");
+                }
+                return trace.result(0);
+            }
+
+            std::vector<std::pair<char const*, char const*>> pairs;
+            std::vector<size_t> positions;
+            for (size_t i = 0; i < n; i++) {
+                results[i] = false;
+                if (values1[i] != NULL && values2[i] != NULL) {
+                    pairs.push_back({values1[i], values2[i]});
+                    positions.push_back(i);
                 }
-                return true;
             }
 
-            bool result = poset_test_recursive(get_poset(id), sid1, sid2);
+            size_t count = 0;
+            std::vector<char> answers = test_relations(id, pairs);
+            for (size_t i = 0; i < pairs.size(); i++) {
+                results[positions[i]] = answers[i];
+                count += answers[i];
+            }
 
             if constexpr (DEBUG) {
-                print_debug_message("poset_test: poset ", id, ", relation (\"", value1, "\", \"",
-                                    value2, "\") ",  (result ? "exists" : "does not exist"));
+                print_debug_message(FUNCTION_NAME, ": poset ", id, ", ", count, " of ", n, " relation(s) exist");
             }
 
-            return result;
+            return trace.result(count);
         }
 
         extern "C" bool poset_add(poset_id_t id, char const* value1, char const* value2) {
+            trace_call_t trace(poset_trace::POSET_ADD, id, value1, value2);
 
             if (!validate_arguments(id, value1, value2, "poset_add")) {
-                return false;
+                return trace.result(false);
             }
 
             if (!does_relation_exist(id, value1, value2) &&
                     !does_relation_exist(id, value2, value1)) {
 
-                add_edge(get_poset(id), get_string_id(value2), get_string_id(value1));
+                add_relation(id, get_string_id(value1), get_string_id(value2));
+                journal_append(JOURNAL_ADD, id, value1, value2);
 
                 if constexpr (DEBUG) {
                     print_debug_message("poset_add: poset ", std::to_string(id), ", relation (\"",
                                         value1, "\", \"", value2, "\") added");
                 }
 
-                return true;
+                return trace.result(true);
             }
             else if constexpr (DEBUG) {
                 print_debug_message("poset_add: poset ", std::to_string(id), ", relation (\"",
                                     value1, "\", \"", value2, "\") cannot be added");
             }
 
-            return false;
+            return trace.result(false);
         }
 
         extern "C" size_t poset_size(poset_id_t id) {
+            trace_call_t trace(poset_trace::POSET_SIZE, id);
+
             if constexpr (DEBUG) {
                 print_debug_message("poset_size(", std::to_string(id), ")");
             }
 
             size_t poset_size = 0;
-            if (poset_exists(id)) {
-                poset_size = get_poset(id).size();
+            if (poset_exists(id) || is_read_only(id)) {
+                poset_size = is_read_only(id) ? mapped_poset(id).view.element_count
+                                              : view_poset(id).elements.size();
 
                 if constexpr (DEBUG) {
                     print_debug_message("poset_size: poset ", std::to_string(id), " contains ",
@@ -463,16 +2734,23 @@ namespace {
                 print_debug_message("poset_size: poset ", std::to_string(id), " does not exist");
             }
 
-            return poset_size;
+            return trace.result(poset_size);
         }
 
         extern "C" void poset_delete(poset_id_t id) {
+            trace_call_t trace(poset_trace::POSET_DELETE, id);
+
             if constexpr(DEBUG) {
                 print_debug_message("poset_delete(", id, ")");
             }
 
-            if (poset_exists(id)) {
-                remove_poset(id);
+            if (poset_exists(id) || is_read_only(id)) {
+                if (is_read_only(id)) {
+                    free_slot(id);
+                } else {
+                    remove_poset(id);
+                }
+                journal_append(JOURNAL_DELETE, id);
 
                 if constexpr(DEBUG) {
                     print_debug_message("poset_delete: poset ", id, " deleted");
@@ -484,12 +2762,15 @@ namespace {
         }
 
         extern "C" void poset_clear(poset_id_t id) {
+            trace_call_t trace(poset_trace::POSET_CLEAR, id);
+
             if constexpr (DEBUG) {
                 print_debug_message("poset_clear(", id, ")");
             }
 
             if (poset_exists(id)) {
                 clear_poset(id);
+                journal_append(JOURNAL_CLEAR, id);
 
                 if constexpr (DEBUG) {
                     print_debug_message("poset_clear: poset ", id, " cleared");
@@ -501,6 +2782,8 @@ namespace {
         }
 
         extern "C" bool poset_remove(poset_id_t id, char const* value) {
+            trace_call_t trace(poset_trace::POSET_REMOVE, id, value);
+
             static const std::string FUNCTION_NAME = "poset_remove";
             if constexpr (DEBUG) {
                 print_debug_message(FUNCTION_NAME, "(", id,
@@ -510,26 +2793,12 @@ namespace {
             bool status = false;
             if (poset_exists(id) && value != NULL) {
                 if (is_element_in_poset(id, value)) {
-                    poset_t& poset = get_poset(id);
-                    string_id_t sid = get_string_id(value);
-
-                    disconnect(poset, sid);
-
-                    auto [less, greater] = extract_neighbours(poset, sid);
-                    for (string_id_t sid_greater : greater) {
-                        std::unordered_set<string_id_t> reachable = reachable_from(poset, sid_greater);
-
-                        for (string_id_t sid_less : less)
-                            if (reachable.find(sid_less) == reachable.end())
-                                add_edge(poset, sid_greater, sid_less);
-                    }
-
                     if constexpr (DEBUG) {
                         print_debug_message(FUNCTION_NAME, ": poset ", id,
                                             ", element \"", value, "\" removed");
                     }
-                    poset.erase(sid);
-                    remove_string_reference(sid, value);
+                    remove_element(id, value);
+                    journal_append(JOURNAL_REMOVE, id, value);
 
                     status = true;
 
@@ -545,31 +2814,74 @@ namespace {
                     print_does_not_exists(id, FUNCTION_NAME);
             }
 
-            return status;
+            return trace.result(status);
+        }
+
+        extern "C" size_t poset_remove_many(poset_id_t id, char const* const* values, size_t n) {
+            trace_call_t trace(poset_trace::POSET_REMOVE_MANY, id, NULL, NULL, n);
+            if (values == NULL && n > 0) {
+                trace.null_values();
+            }
+
+            static const std::string FUNCTION_NAME = "poset_remove_many";
+            if constexpr (DEBUG) {
+                print_debug_message(FUNCTION_NAME, "(", id, ", ", n, " value(s))");
+            }
+
+            if (!poset_exists(id) || (values == NULL && n > 0)) {
+                if constexpr (DEBUG) {
+                    if (!poset_exists(id))
+                        print_does_not_exists(id, FUNCTION_NAME);
+                    else
+                        print_debug_message(FUNCTION_NAME, ": invalid values (NULL)");
+                }
+                return trace.result(0);
+            }
+
+            std::unordered_map<string_id_t, char const*> removed;
+            for (size_t i = 0; i < n; i++) {
+                bool in_poset = values[i] != NULL && is_element_in_poset(id, values[i]);
+                trace.list_value(values[i], in_poset);
+                if (in_poset) {
+                    removed.insert({get_string_id(values[i]), values[i]});
+                } else if constexpr (DEBUG) {
+                    print_debug_message(FUNCTION_NAME, ": poset ", id, ", element ",
+                                        char_pointer_to_string(values[i]), " does not exist");
+                }
+            }
+
+            if (!removed.empty()) {
+                std::vector<char const*> removed_values;
+                std::vector<std::string_view> journaled;
+                for (auto& [sid, value] : removed) {
+                    removed_values.push_back(value);
+                    journaled.push_back(value);
+                }
+                remove_many_elements(id, removed_values);
+                journal_append(JOURNAL_REMOVE_MANY, id, journaled);
+            }
+
+            if constexpr (DEBUG) {
+                print_debug_message(FUNCTION_NAME, ": poset ", id, ", ",
+                                    removed.size(), " element(s) removed");
+            }
+
+            return trace.result(removed.size());
         }
 
         extern "C" bool poset_del(poset_id_t id, char const* value1, char const* value2) {
+            trace_call_t trace(poset_trace::POSET_DEL, id, value1, value2);
+
             bool status = false;
             bool are_arguments_valid = validate_arguments(id, value1, value2, "poset_del");
 
             if (are_arguments_valid && does_relation_exist(id, value1, value2)) {
 
                 string_id_t sid1 = get_string_id(value1), sid2 = get_string_id(value2);
-                poset_t& poset = get_poset(id);
-
-                if (can_be_removed(poset, sid1, sid2)) {
-                    remove_edge(poset, sid1, sid2);
-
-                    auto [less, greater] = extract_neighbours(poset, sid1);
-                    for (string_id_t l : less) {
-                        add_edge(poset, sid2, l);
-                    }
-
-                    auto [less2, greater2] = extract_neighbours(poset, sid2);
-                    for (string_id_t g2 : greater2) {
-                        add_edge(poset, g2, sid1);
-                    }
 
+                if (can_be_removed(view_poset(id), sid1, sid2)) {
+                    delete_relation(id, sid1, sid2);
+                    journal_append(JOURNAL_DEL, id, value1, value2);
                     status = true;
 
                     if constexpr (DEBUG) {
@@ -589,6 +2901,319 @@ namespace {
                 }
             }
 
+            return trace.result(status);
+        }
+
+        extern "C" poset_id_t poset_clone(poset_id_t id) {
+            trace_call_t trace(poset_trace::POSET_CLONE, id);
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_clone(", id, ")");
+            }
+
+            poset_id_t pid = POSET_INVALID_ID;
+            if (poset_exists(id)) {
+                pid = clone_poset(id);
+                journal_append(JOURNAL_CLONE, pid, id);
+            } else if (is_read_only(id)) {
+                pid = clone_poset(id);
+                journal_append(JOURNAL_RESERVE, pid);
+            }
+
+            if constexpr (DEBUG) {
+                if (pid != POSET_INVALID_ID)
+                    print_debug_message("poset_clone: poset ", pid, " cloned from poset ", id);
+                else
+                    print_does_not_exists(id, "poset_clone");
+            }
+
+            return trace.result(pid);
+        }
+
+        extern "C" size_t poset_merge(poset_id_t id1, poset_id_t id2, pair_visitor_t visitor, void* context) {
+            trace_call_t trace(poset_trace::POSET_MERGE, id1, NULL, NULL, id2);
+            trace.other_poset(id2);
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_merge(", id1, ", ", id2, ")");
+            }
+
+            if (!poset_exists(id1) || !poset_exists(id2)) {
+                if constexpr (DEBUG) {
+                    if (!poset_exists(id1))
+                        print_does_not_exists(id1, "poset_merge");
+                    if (!poset_exists(id2))
+                        print_debug_message("poset_merge: poset ", id2, " does not exist");
+                }
+                return trace.result(0);
+            }
+
+            auto rejected = merge_posets(id1, id2);
+            journal_append(JOURNAL_MERGE, id1, id2);
+
+            if (visitor != NULL) {
+                for (auto& [sid1, sid2] : rejected) {
+                    visitor(id_to_string().at(sid1)->c_str(), id_to_string().at(sid2)->c_str(), context);
+                }
+            }
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_merge: poset ", id2, " merged into poset ", id1, ", ",
+                                    rejected.size(), " relation(s) rejected");
+            }
+
+            return trace.result(rejected.size());
+        }
+
+        extern "C" size_t poset_lower_set(poset_id_t id, char const* value,
+                                          visitor_t visitor, void* context) {
+            trace_call_t trace(poset_trace::POSET_LOWER_SET, id, value);
+            return trace.result(visit_element_subset(id, value, subset_t::LOWER_SET, visitor, context,
+                                                     "poset_lower_set"));
+        }
+
+        extern "C" size_t poset_upper_set(poset_id_t id, char const* value,
+                                          visitor_t visitor, void* context) {
+            trace_call_t trace(poset_trace::POSET_UPPER_SET, id, value);
+            return trace.result(visit_element_subset(id, value, subset_t::UPPER_SET, visitor, context,
+                                                     "poset_upper_set"));
+        }
+
+        extern "C" size_t poset_minimal(poset_id_t id, visitor_t visitor, void* context) {
+            trace_call_t trace(poset_trace::POSET_MINIMAL, id);
+            return trace.result(visit_extremal(id, subset_t::MINIMAL, visitor, context,
+                                               "poset_minimal"));
+        }
+
+        extern "C" size_t poset_maximal(poset_id_t id, visitor_t visitor, void* context) {
+            trace_call_t trace(poset_trace::POSET_MAXIMAL, id);
+            return trace.result(visit_extremal(id, subset_t::MAXIMAL, visitor, context,
+                                               "poset_maximal"));
+        }
+
+        extern "C" bool poset_set_labeling(poset_id_t id, unsigned dimensions) {
+            trace_call_t trace(poset_trace::POSET_SET_LABELING, id, NULL, NULL, dimensions);
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_set_labeling(", id, ", ", dimensions, ")");
+            }
+
+            if (!poset_exists(id)) {
+                if constexpr (DEBUG) {
+                    print_does_not_exists(id, "poset_set_labeling");
+                }
+                return trace.result(false);
+            }
+
+            set_labeling(id, dimensions);
+            journal_append(JOURNAL_LABELING, id, dimensions);
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_set_labeling: poset ", id, ", labels with ", dimensions,
+                                    " dimension(s) ", (dimensions == 0 ? "disabled" : "enabled"));
+            }
+
+            return trace.result(true);
+        }
+
+        extern "C" bool poset_save(poset_id_t id, char const* path, bool with_closure) {
+            trace_call_t trace(poset_trace::POSET_SAVE, id, path, NULL, with_closure);
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_save(", id, ", ", char_pointer_to_string(path),
+                                    ", ", (with_closure ? "true" : "false"), ")");
+            }
+
+            if (path == NULL || !(poset_exists(id) || is_read_only(id))) {
+                if constexpr (DEBUG) {
+                    if (path == NULL)
+                        print_debug_message("poset_save: invalid path (NULL)");
+                    else
+                        print_does_not_exists(id, "poset_save");
+                }
+                return trace.result(false);
+            }
+
+            bool status = is_read_only(id) ? save_mapped_poset(mapped_poset(id), path)
+                                           : save_poset(view_poset(id), path, with_closure);
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_save: poset ", id, (status ? " saved to " : " cannot be saved to "),
+                                    char_pointer_to_string(path));
+            }
+
+            return trace.result(status);
+        }
+
+        extern "C" poset_id_t poset_load(char const* path) {
+            trace_call_t trace(poset_trace::POSET_LOAD, POSET_INVALID_ID, path);
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_load(", char_pointer_to_string(path), ")");
+            }
+
+            size_t length = 0;
+            std::shared_ptr<const char> mapping = path == NULL ? nullptr : map_file(path, length);
+            image_view_t view;
+
+            if (mapping == nullptr || !parse_image(mapping.get(), length, view) || !is_image_acyclic(view)) {
+                if constexpr (DEBUG) {
+                    print_debug_message("poset_load: cannot load a poset from ", char_pointer_to_string(path));
+                }
+                return trace.result(POSET_INVALID_ID);
+            }
+
+            poset_id_t pid = load_image(view);
+            journal_append(JOURNAL_POSET, pid, view_poset(pid));
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_load: poset ", pid, " loaded from ", char_pointer_to_string(path));
+            }
+
+            return trace.result(pid);
+        }
+
+        extern "C" poset_id_t poset_open(char const* path) {
+            trace_call_t trace(poset_trace::POSET_OPEN, POSET_INVALID_ID, path);
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_open(", char_pointer_to_string(path), ")");
+            }
+
+            mapped_poset_t mapped;
+            mapped.mapping = path == NULL ? nullptr : map_file(path, mapped.length);
+
+            if (mapped.mapping == nullptr || !parse_image(mapped.mapping.get(), mapped.length, mapped.view)) {
+                if constexpr (DEBUG) {
+                    print_debug_message("poset_open: cannot open a poset from ", char_pointer_to_string(path));
+                }
+                return trace.result(POSET_INVALID_ID);
+            }
+
+            poset_id_t pid = allocate_slot();
+            slot_of(pid).mapped = std::make_unique<mapped_poset_t>(std::move(mapped));
+            journal_append(JOURNAL_RESERVE, pid);
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_open: poset ", pid, " opened read-only from ",
+                                    char_pointer_to_string(path));
+            }
+
+            return trace.result(pid);
+        }
+
+        extern "C" size_t poset_memory_usage(poset_id_t id) {
+            trace_call_t trace(poset_trace::POSET_MEMORY_USAGE, id);
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_memory_usage(", id, ")");
+            }
+
+            size_t bytes = 0;
+            if (poset_exists(id) || is_read_only(id)) {
+                bytes = poset_memory(id);
+
+                if constexpr (DEBUG) {
+                    print_debug_message("poset_memory_usage: poset ", id, " uses ", bytes, " byte(s)");
+                }
+            }
+            else if constexpr (DEBUG) {
+                print_debug_message("poset_memory_usage: poset ", id, " does not exist");
+            }
+
+            return trace.result(bytes);
+        }
+
+        extern "C" size_t poset_total_memory_usage(void) {
+            trace_call_t trace(poset_trace::POSET_TOTAL_MEMORY_USAGE, POSET_INVALID_ID);
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_total_memory_usage()");
+            }
+
+            size_t bytes = total_memory();
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_total_memory_usage: posets use ", bytes, " byte(s)");
+            }
+
+            return trace.result(bytes);
+        }
+
+        extern "C" bool poset_journal_open(char const* path, unsigned commit_interval_ms) {
+            if constexpr (DEBUG) {
+                print_debug_message("poset_journal_open(", char_pointer_to_string(path), ", ",
+                                    commit_interval_ms, ")");
+            }
+
+            bool status = path != NULL && journal_state() == nullptr && !has_posets() &&
+                          open_journal(path, commit_interval_ms);
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_journal_open: journal ", (status ? "opened at " : "cannot be opened at "),
+                                    char_pointer_to_string(path));
+            }
+
+            return status;
+        }
+
+        extern "C" bool poset_journal_sync(void) {
+            bool status = journal_state() != nullptr && sync_journal(*journal_state());
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_journal_sync()\nposet_journal_sync: journal ",
+                                    (status ? "synced" : "cannot be synced"));
+            }
+
+            return status;
+        }
+
+        extern "C" bool poset_journal_compact(void) {
+            bool status = journal_state() != nullptr && compact_journal(*journal_state());
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_journal_compact()\nposet_journal_compact: journal ",
+                                    (status ? "compacted" : "cannot be compacted"));
+            }
+
+            return status;
+        }
+
+        extern "C" bool poset_journal_close(void) {
+            bool status = journal_state() != nullptr && sync_journal(*journal_state());
+            journal_state() = nullptr;
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_journal_close()\nposet_journal_close: journal ",
+                                    (status ? "closed" : "closed with unsaved changes"));
+            }
+
+            return status;
+        }
+
+        extern "C" void poset_trace_enable(bool enabled) {
+            if constexpr (DEBUG) {
+                print_debug_message("poset_trace_enable(", (enabled ? "true" : "false"), ")");
+            }
+
+            if (enabled) {
+                tracing_strings.store(true);
+            }
+            tracing_enabled.store(enabled);
+        }
+
+        extern "C" bool poset_trace_dump(char const* path) {
+            if constexpr (DEBUG) {
+                print_debug_message("poset_trace_dump(", char_pointer_to_string(path), ")");
+            }
+
+            bool status = path != NULL && dump_traces(path);
+
+            if constexpr (DEBUG) {
+                print_debug_message("poset_trace_dump: traces ", (status ? "written to " : "cannot be written to "),
+                                    char_pointer_to_string(path));
+            }
+
             return status;
         }
     }
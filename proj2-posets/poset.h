@@ -11,6 +11,11 @@ namespace cxx {
 #include <stdbool.h>
 #endif
 
+/*
+ * Identifier returned instead of a poset id when a poset cannot be created.
+ */
+#define POSET_INVALID_ID ((unsigned long) -1)
+
     /*
      * Creates a new poset and returns its id.
      */
@@ -30,6 +35,16 @@ namespace cxx {
      */
     bool poset_test(unsigned long id, char const *value1, char const *value2);
 
+    /*
+     * If a poset with the given id exists, it sets 'results[i]' to the result of
+     * 'poset_test(id, values1[i], values2[i])' for every i < n, otherwise, it does nothing.
+     * The result is the number of true results. Large batches are answered together by
+     * all hardware threads: the pairs are grouped by 'values2[i]' and every 256 distinct values take
+     * a single pass over the poset, marking the elements below each of them with one bit.
+     */
+    size_t poset_test_many(unsigned long id, char const* const* values1, char const* const* values2,
+                           size_t n, bool *results);
+
     /*
      * If a poset with the given id exists, and elements 'value1' and 'value2' belong to this set
      * and are not in relation, it adds the relation in a way that element 'value1' now precedes element 'value2'
@@ -45,6 +60,7 @@ namespace cxx {
 
     /*
      * If a poset with the 'id' exists, it deletes it, otherwise, it does nothing.
+     * The id stays invalid, even after a new poset has taken the place of the deleted one.
      */
     void poset_delete(unsigned long id);
 
@@ -60,6 +76,15 @@ namespace cxx {
      */
     bool poset_remove(unsigned long id, char const* value);
 
+    /*
+     * If there exists a poset with the 'id', it removes every element of the array 'values' of length 'n'
+     * that belongs to the poset. The remaining elements stay in the same relation as they would
+     * after removing the elements one by one with 'poset_remove'. NULL values and values
+     * that don't belong to the poset are skipped.
+     * The result is the number of removed elements.
+     */
+    size_t poset_remove_many(unsigned long id, char const* const* values, size_t n);
+
     /*
      * If there exists a poset with the 'id', and elements 'value1' and 'value2' belong to this poset,
      * with 'value1' being in relation with 'value2', and removing the relationship between 'value1' and 'value2'
@@ -69,6 +94,167 @@ namespace cxx {
      */
     bool poset_del(unsigned long id, char const* value1, char const* value2);
 
+    /*
+     * Function called for every element of a set enumerated by the functions below.
+     * The 'value' pointer is valid only during the call.
+     */
+    typedef void (*poset_visitor_t)(char const *value, void *context);
+
+    /*
+     * If there exists a poset with the 'id' and the element 'value' belongs to this poset, it calls
+     * 'visitor' (unless it's NULL) with 'context' for every element preceding 'value', otherwise,
+     * it does nothing. The result is the number of such elements. The elements are found with
+     * a single traversal of the poset, in no particular order.
+     */
+    size_t poset_lower_set(unsigned long id, char const *value, poset_visitor_t visitor, void *context);
+
+    /*
+     * Works like 'poset_lower_set', but for the elements preceded by 'value'.
+     */
+    size_t poset_upper_set(unsigned long id, char const *value, poset_visitor_t visitor, void *context);
+
+    /*
+     * If a poset with the 'id' exists, it calls 'visitor' (unless it's NULL) with 'context' for every
+     * minimal element of this poset, otherwise, it does nothing. The result is the number of minimal
+     * elements. Minimal elements are maintained with the poset, so this takes time proportional to
+     * their number.
+     */
+    size_t poset_minimal(unsigned long id, poset_visitor_t visitor, void *context);
+
+    /*
+     * Works like 'poset_minimal', but for the maximal elements.
+     */
+    size_t poset_maximal(unsigned long id, poset_visitor_t visitor, void *context);
+
+    /*
+     * If a poset with the 'id' exists, it creates a copy of it and returns the id of the copy,
+     * otherwise, the result is POSET_INVALID_ID. The copy is made in constant time, both posets
+     * share their elements and relations until one of them is modified. The first change copies
+     * the table of elements, which takes time proportional to their number, but the relations stay
+     * shared and only the ones of the modified elements are copied.
+     */
+    unsigned long poset_clone(unsigned long id);
+
+    /*
+     * Function called for every pair of elements reported by 'poset_merge'.
+     * The pointers are valid only during the call.
+     */
+    typedef void (*poset_pair_visitor_t)(char const *value1, char const *value2, void *context);
+
+    /*
+     * If posets with the identifiers 'id1' and 'id2' exist, it adds the elements and relations of the poset 'id2'
+     * to the poset 'id1', otherwise, it does nothing. The result is the same as inserting the missing elements
+     * and calling 'poset_add' for every pair of elements 'value1' preceding 'value2' in the poset 'id2',
+     * ordered by 'value1' and then by 'value2' (as with strcmp). The pairs that cannot be added, because
+     * 'value2' already precedes 'value1' in the poset 'id1', are rejected: 'visitor' (unless it's NULL)
+     * is called with 'context' for each of them, in that order. The result is the number of rejected pairs.
+     * The relations are added in bulk, with O(n^2) bits of temporary memory for n elements of the poset 'id2'.
+     * Read-only posets are treated as nonexistent.
+     */
+    size_t poset_merge(unsigned long id1, unsigned long id2, poset_pair_visitor_t visitor, void *context);
+
+    /*
+     * If a poset with the 'id' exists, it enables reachability labels with the given number
+     * of dimensions for this poset (0 disables them), and the result is true, otherwise, it's false.
+     * Labels take O(dimensions) memory per element and let 'poset_test', 'poset_add' and 'poset_del'
+     * reject most pairs of unrelated elements without searching the poset. They are built lazily,
+     * inserted elements get labels of their own, and added relations widen the labels until
+     * there are more of them than elements. Then the labels are rebuilt once searches without them
+     * have visited as many elements as building them takes. Read-only posets are not labeled.
+     */
+    bool poset_set_labeling(unsigned long id, unsigned dimensions);
+
+    /*
+     * If a poset with the 'id' exists, it writes the poset to the file 'path' in a binary format.
+     * If 'with_closure' is true, the file additionally contains the transitive closure of the relation
+     * (n^2 bits for n elements), which makes 'poset_test' on posets opened with 'poset_open' constant time.
+     * Read-only posets are written unchanged. The file is written as 'path' followed by ".tmp"
+     * and then renamed to 'path', so posets opened from the old file keep working. The result
+     * is true if the file has been written, and false otherwise.
+     */
+    bool poset_save(unsigned long id, char const *path, bool with_closure);
+
+    /*
+     * Creates a new poset from the file 'path' written by 'poset_save' and returns its id.
+     * Relations are restored without checking them one by one. If the file cannot be read
+     * or is malformed, the result is POSET_INVALID_ID.
+     */
+    unsigned long poset_load(char const *path);
+
+    /*
+     * Maps the file 'path' written by 'poset_save' into memory and returns the id of a read-only
+     * poset backed by it. 'poset_test', 'poset_test_many', 'poset_size', 'poset_lower_set', 'poset_upper_set',
+     * 'poset_minimal', 'poset_maximal', 'poset_save', 'poset_memory_usage' and 'poset_delete' work on such
+     * a poset directly, 'poset_clone' makes another read-only poset sharing the mapping, and other functions
+     * treat it as nonexistent. The file must not be modified
+     * in place until the poset is deleted, replacing it with 'poset_save' is fine. If the file cannot be read or is malformed,
+     * the result is POSET_INVALID_ID.
+     */
+    unsigned long poset_open(char const *path);
+
+    /*
+     * If a poset with the 'id' exists, the result is the number of bytes of memory it takes, otherwise, it's 0.
+     * Every poset allocates its elements and relations from its own arena, which is released at once
+     * when the poset is deleted or cleared, except for the relations still shared with its clones, which
+     * keep the arena until they are modified. Arenas of clones sharing relations with this poset are
+     * included in full. A shared arena takes no new relations and frees none until it's released,
+     * so changing a poset doesn't change the result for its clones. For read-only posets the result
+     * is the size of the mapped file.
+     * The element values themselves are shared by all posets and are not included.
+     */
+    size_t poset_memory_usage(unsigned long id);
+
+    /*
+     * The result is the number of bytes of memory taken by all posets, with memory shared between
+     * posets counted once. Like in 'poset_memory_usage', element values are not included.
+     */
+    size_t poset_total_memory_usage(void);
+
+    /*
+     * Opens the journal at 'path' and the snapshot at 'path' with ".snapshot" appended. Posets
+     * saved in them are restored with the same ids, then every successful change of a poset
+     * is appended to the journal. Read-only posets are not restored and their ids stay invalid.
+     * Records are written and synced to disk in groups, once per 'commit_interval_ms'
+     * milliseconds. With 0 every change waits until its record is on disk. Once the journal
+     * outgrows the snapshot, the state of all posets is written to a new snapshot and the
+     * journal starts over. It must be called before any poset is created. The result is true
+     * if the journal has been opened, and false otherwise.
+     */
+    bool poset_journal_open(char const *path, unsigned commit_interval_ms);
+
+    /*
+     * Waits until all changes are on disk. The result is true if they are,
+     * and false if the journal isn't open or cannot be written.
+     */
+    bool poset_journal_sync(void);
+
+    /*
+     * Writes the state of all posets to a new snapshot and empties the journal. The result is true
+     * if the snapshot has been written, and false otherwise.
+     */
+    bool poset_journal_compact(void);
+
+    /*
+     * Writes the remaining changes and closes the journal, the posets stay unchanged.
+     * The result is true if all changes have been written, and false otherwise.
+     */
+    bool poset_journal_close(void);
+
+    /*
+     * Enables or disables recording of the calls of the functions above. Every thread records its
+     * calls into its own buffer, which keeps the most recent ones. Buffers of exited threads are
+     * reused by new threads. Disabled tracing costs a single flag check per call.
+     */
+    void poset_trace_enable(bool enabled);
+
+    /*
+     * Writes the calls recorded by all threads since the previous dump to the file 'path' and
+     * removes them from the buffers. The file can be turned into the messages printed by debug builds
+     * with the poset_trace_decode tool. The result is true if the file has been written,
+     * and false otherwise.
+     */
+    bool poset_trace_dump(char const *path);
+
 #ifdef __cplusplus
     }
 }
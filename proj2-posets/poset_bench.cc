@@ -0,0 +1,583 @@
+/*
+ * Benchmark suite for the poset C API. Every workload drives the 'cxx::poset_*' functions
+ * and reports, for each kind of operation, the throughput, latency percentiles and heap
+ * allocations per call, followed by the peak heap usage of the whole workload.
+ * Allocations are counted by replacing the global operator new and delete.
+ *
+ * g++ -Wall -Wextra -O2 -std=c++17 -DNDEBUG -c poset.cc -o poset.o
+ * g++ -Wall -Wextra -O2 -std=c++17 -c poset_bench.cc -o poset_bench.o
+ * g++ poset_bench.o poset.o -pthread -o poset_bench
+ *
+ * './poset_bench' runs every workload, './poset_bench chain mixed' only the given ones.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "poset.h"
+#include "basic_poset.h"
+
+namespace {
+    // Updated by every thread, including the ones of poset_test_many, so the counters are atomic.
+    struct heap_counters_t {
+        std::atomic<size_t> allocations{0};
+        std::atomic<size_t> live_bytes{0};
+        std::atomic<size_t> peak_bytes{0};
+    };
+
+    heap_counters_t heap;
+
+    // Every block is preceded by its size, so that unsized deletes are accounted for too.
+    constexpr size_t HEADER_SIZE = alignof(std::max_align_t);
+
+    void* counted_allocate(size_t size) {
+        char* block = static_cast<char*>(std::malloc(size + HEADER_SIZE));
+        if (block == nullptr) {
+            throw std::bad_alloc();
+        }
+
+        *reinterpret_cast<size_t*>(block) = size;
+        heap.allocations.fetch_add(1, std::memory_order_relaxed);
+        size_t live = heap.live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+        size_t peak = heap.peak_bytes.load(std::memory_order_relaxed);
+        while (peak < live &&
+               !heap.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+        return block + HEADER_SIZE;
+    }
+
+    void counted_free(void* pointer) {
+        if (pointer == nullptr) {
+            return;
+        }
+
+        char* block = static_cast<char*>(pointer) - HEADER_SIZE;
+        heap.live_bytes.fetch_sub(*reinterpret_cast<size_t*>(block), std::memory_order_relaxed);
+        std::free(block);
+    }
+}
+
+void* operator new(size_t size) {
+    return counted_allocate(size);
+}
+
+void* operator new[](size_t size) {
+    return counted_allocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    counted_free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    counted_free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    counted_free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    counted_free(pointer);
+}
+
+namespace {
+    using clock_type = std::chrono::steady_clock;
+
+    struct operation_stats_t {
+        std::vector<double> latencies; // In nanoseconds.
+        size_t allocations = 0;
+    };
+
+    // Records the latency and allocations of a single call for the lifetime of the object.
+    class call_timer_t {
+    public:
+        explicit call_timer_t(operation_stats_t& stats)
+                : stats(stats), allocations(heap.allocations.load(std::memory_order_relaxed)), start(clock_type::now()) {}
+
+        ~call_timer_t() {
+            auto end = clock_type::now();
+            stats.allocations += heap.allocations.load(std::memory_order_relaxed) - allocations;
+            stats.latencies.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+        }
+
+    private:
+        operation_stats_t& stats;
+        size_t allocations;
+        clock_type::time_point start;
+    };
+
+    class workload_t {
+    public:
+        explicit workload_t(std::string name)
+                : name(std::move(name)), baseline(heap.live_bytes.load(std::memory_order_relaxed)) {
+            heap.peak_bytes.store(baseline, std::memory_order_relaxed);
+        }
+
+        template <typename F>
+        decltype(auto) measure(const std::string& operation, F&& f) {
+            call_timer_t timer(operations[operation]);
+            return f();
+        }
+
+        void report() {
+            for (auto& [operation, stats] : operations) {
+                std::vector<double>& latencies = stats.latencies;
+                std::sort(latencies.begin(), latencies.end());
+
+                double total = 0;
+                for (double latency : latencies) {
+                    total += latency;
+                }
+                auto percentile = [&](double p) {
+                    return latencies[std::min(latencies.size() - 1, size_t(p * latencies.size()))] / 1000;
+                };
+
+                std::printf("%-26s %-12s %9zu %12.0f %9.2f %9.2f %9.2f %10.2f %10.2f\n",
+                            name.c_str(), operation.c_str(), latencies.size(), latencies.size() / total * 1e9,
+                            percentile(0.5), percentile(0.9), percentile(0.99), latencies.back() / 1000,
+                            double(stats.allocations) / latencies.size());
+            }
+            std::printf("%-26s peak heap %.2f MiB\n\n", name.c_str(),
+                        double(heap.peak_bytes.load(std::memory_order_relaxed) - baseline) / (1 << 20));
+        }
+
+    private:
+        std::string name;
+        size_t baseline;
+        std::map<std::string, operation_stats_t> operations;
+    };
+
+    std::vector<std::string> element_names(size_t n) {
+        std::vector<std::string> names;
+        for (size_t i = 0; i < n; i++) {
+            names.push_back("e" + std::to_string(i));
+        }
+        return names;
+    }
+
+    unsigned long new_poset(workload_t& workload, unsigned labels) {
+        unsigned long id = workload.measure("new", [] { return cxx::poset_new(); });
+        cxx::poset_set_labeling(id, labels);
+        return id;
+    }
+
+    void insert_all(workload_t& workload, unsigned long id, const std::vector<std::string>& names) {
+        for (const std::string& name : names) {
+            workload.measure("insert", [&] { return cxx::poset_insert(id, name.c_str()); });
+        }
+    }
+
+    /*
+     * Adds random relations that always go from a lower to a higher element index,
+     * so none of them can close a cycle.
+     */
+    void add_random_relations(workload_t& workload, unsigned long id, const std::vector<std::string>& names,
+                              size_t relations, std::mt19937& random) {
+        std::uniform_int_distribution<size_t> element(0, names.size() - 1);
+        for (size_t i = 0; i < relations; i++) {
+            size_t a = element(random), b = element(random);
+            if (a != b) {
+                char const* lower = names[std::min(a, b)].c_str();
+                char const* upper = names[std::max(a, b)].c_str();
+                workload.measure("add", [&] { return cxx::poset_add(id, lower, upper); });
+            }
+        }
+    }
+
+    void test_random_pairs(workload_t& workload, unsigned long id, const std::vector<std::string>& names,
+                           size_t queries, std::mt19937& random) {
+        std::uniform_int_distribution<size_t> element(0, names.size() - 1);
+        for (size_t i = 0; i < queries; i++) {
+            char const* a = names[element(random)].c_str();
+            char const* b = names[element(random)].c_str();
+            workload.measure("test", [&] { return cxx::poset_test(id, a, b); });
+        }
+    }
+
+    void delete_poset(workload_t& workload, unsigned long id) {
+        workload.measure("delete", [&] { cxx::poset_delete(id); });
+    }
+
+    void chain() {
+        workload_t workload("chain n=5000");
+        std::mt19937 random(1);
+        std::vector<std::string> names = element_names(5000);
+
+        unsigned long id = new_poset(workload, 0);
+        insert_all(workload, id, names);
+        for (size_t i = 1; i < names.size(); i++) {
+            workload.measure("add", [&] { return cxx::poset_add(id, names[i - 1].c_str(), names[i].c_str()); });
+        }
+        test_random_pairs(workload, id, names, 5000, random);
+        delete_poset(workload, id);
+        workload.report();
+    }
+
+    void antichain() {
+        workload_t workload("antichain n=100000");
+        std::mt19937 random(2);
+        std::vector<std::string> names = element_names(100000);
+
+        unsigned long id = new_poset(workload, 0);
+        insert_all(workload, id, names);
+        test_random_pairs(workload, id, names, 100000, random);
+        for (size_t i = 0; i < names.size(); i += 2) {
+            workload.measure("remove", [&] { return cxx::poset_remove(id, names[i].c_str()); });
+        }
+        delete_poset(workload, id);
+        workload.report();
+    }
+
+    void random_dag(const char* name, size_t n, size_t relations, size_t queries, unsigned labels) {
+        workload_t workload(std::string(name) + " labels=" + std::to_string(labels));
+        std::mt19937 random(n + relations);
+        std::vector<std::string> names = element_names(n);
+
+        unsigned long id = new_poset(workload, labels);
+        insert_all(workload, id, names);
+        add_random_relations(workload, id, names, relations, random);
+        test_random_pairs(workload, id, names, queries, random);
+        delete_poset(workload, id);
+        workload.report();
+    }
+
+    // Without labels every 'poset_test' searches the poset, so the unlabeled dense workload is kept small.
+    void sparse_dag() {
+        random_dag("sparse n=20000", 20000, 40000, 20000, 0);
+        random_dag("sparse n=20000", 20000, 40000, 20000, 2);
+    }
+
+    void dense_dag() {
+        random_dag("dense n=400", 400, 2500, 5000, 0);
+        random_dag("dense n=400", 400, 2500, 5000, 2);
+    }
+
+    /*
+     * Every new element is inserted, put above a random earlier one and followed by tests of random pairs,
+     * so labels have to follow a poset that keeps growing.
+     */
+    void interleaved_dag(unsigned labels) {
+        const size_t n = 6000, queries = 20;
+        workload_t workload("interleave n=6000 labels=" + std::to_string(labels));
+        std::mt19937 random(7);
+        std::vector<std::string> names = element_names(n);
+
+        unsigned long id = new_poset(workload, labels);
+        for (size_t i = 0; i < n; i++) {
+            workload.measure("insert", [&] { return cxx::poset_insert(id, names[i].c_str()); });
+            if (i == 0) {
+                continue;
+            }
+            char const* lower = names[random() % i].c_str();
+            workload.measure("add", [&] { return cxx::poset_add(id, lower, names[i].c_str()); });
+            for (size_t q = 0; q < queries; q++) {
+                char const* a = names[random() % (i + 1)].c_str();
+                char const* b = names[random() % (i + 1)].c_str();
+                workload.measure("test", [&] { return cxx::poset_test(id, a, b); });
+            }
+        }
+        delete_poset(workload, id);
+        workload.report();
+    }
+
+    void interleaved() {
+        interleaved_dag(0);
+        interleaved_dag(2);
+        interleaved_dag(4);
+    }
+
+    // Layers of equal width, with every element above a few random elements of the previous layer.
+    void layered_dag() {
+        const size_t layers = 20, width = 200, degree = 3;
+        workload_t workload("layered 20x200 labels=2");
+        std::mt19937 random(3);
+        std::vector<std::string> names = element_names(layers * width);
+
+        unsigned long id = new_poset(workload, 2);
+        insert_all(workload, id, names);
+        std::uniform_int_distribution<size_t> column(0, width - 1);
+        for (size_t layer = 1; layer < layers; layer++) {
+            for (size_t i = 0; i < width; i++) {
+                char const* upper = names[layer * width + i].c_str();
+                for (size_t d = 0; d < degree; d++) {
+                    char const* lower = names[(layer - 1) * width + column(random)].c_str();
+                    workload.measure("add", [&] { return cxx::poset_add(id, lower, upper); });
+                }
+            }
+        }
+        test_random_pairs(workload, id, names, 20000, random);
+        delete_poset(workload, id);
+        workload.report();
+    }
+
+    /*
+     * Random stream of inserts, relation additions, tests, relation deletions and removals
+     * spread over the given posets, all sharing a pool of 'names_per_poset' element names.
+     */
+    void mixed_stream(const std::string& name, size_t posets, size_t names_per_poset,
+                      size_t operations, unsigned labels) {
+        workload_t workload(name + " labels=" + std::to_string(labels));
+        std::mt19937 random(posets + names_per_poset);
+        std::vector<std::string> names = element_names(names_per_poset);
+
+        std::vector<unsigned long> ids;
+        for (size_t i = 0; i < posets; i++) {
+            ids.push_back(new_poset(workload, labels));
+        }
+
+        std::uniform_int_distribution<size_t> poset(0, posets - 1), element(0, names_per_poset - 1);
+        std::uniform_int_distribution<int> kind(0, 99);
+        for (size_t i = 0; i < operations; i++) {
+            unsigned long id = ids[poset(random)];
+            size_t a = element(random), b = element(random);
+            char const* lower = names[std::min(a, b)].c_str();
+            char const* upper = names[std::max(a, b)].c_str();
+
+            int k = kind(random);
+            if (k < 30) {
+                workload.measure("insert", [&] { return cxx::poset_insert(id, lower); });
+            } else if (k < 55) {
+                workload.measure("add", [&] { return cxx::poset_add(id, lower, upper); });
+            } else if (k < 85) {
+                workload.measure("test", [&] { return cxx::poset_test(id, lower, upper); });
+            } else if (k < 95) {
+                workload.measure("del", [&] { return cxx::poset_del(id, lower, upper); });
+            } else {
+                workload.measure("remove", [&] { return cxx::poset_remove(id, lower); });
+            }
+        }
+
+        for (unsigned long id : ids) {
+            delete_poset(workload, id);
+        }
+        workload.report();
+    }
+
+    // The unlabeled mixed workload on integer elements, without interning strings.
+    void typed() {
+        workload_t workload("typed n=2000 labels=0");
+        std::mt19937 random(2001);
+        cxx::basic_poset<size_t> poset;
+
+        std::uniform_int_distribution<size_t> element(0, 1999);
+        std::uniform_int_distribution<int> kind(0, 99);
+        for (size_t i = 0; i < 200000; i++) {
+            size_t a = element(random), b = element(random);
+            size_t lower = std::min(a, b), upper = std::max(a, b);
+
+            int k = kind(random);
+            if (k < 30) {
+                workload.measure("insert", [&] { return poset.insert(lower); });
+            } else if (k < 55) {
+                workload.measure("add", [&] { return poset.add(lower, upper); });
+            } else if (k < 85) {
+                workload.measure("test", [&] { return poset.test(lower, upper); });
+            } else if (k < 95) {
+                workload.measure("del", [&] { return poset.del(lower, upper); });
+            } else {
+                workload.measure("remove", [&] { return poset.remove(lower); });
+            }
+        }
+
+        workload.measure("clear", [&] { poset.clear(); });
+        workload.report();
+    }
+
+    void mixed() {
+        mixed_stream("mixed n=2000", 1, 2000, 200000, 0);
+        mixed_stream("mixed n=2000", 1, 2000, 200000, 2);
+    }
+
+    // The labeled mixed workload with every call traced, to be compared with 'mixed'.
+    void traced() {
+        cxx::poset_trace_enable(true);
+        mixed_stream("traced n=2000", 1, 2000, 200000, 2);
+        cxx::poset_trace_enable(false);
+        cxx::poset_trace_dump("/dev/null");
+    }
+
+    const char BENCH_JOURNAL[] = "/tmp/poset_bench.journal";
+    const char BENCH_SNAPSHOT[] = "/tmp/poset_bench.journal.snapshot";
+
+    void journaled_stream(unsigned commit_interval_ms, size_t operations) {
+        std::remove(BENCH_JOURNAL);
+        std::remove(BENCH_SNAPSHOT);
+        cxx::poset_journal_open(BENCH_JOURNAL, commit_interval_ms);
+        mixed_stream("journal " + std::to_string(commit_interval_ms) + "ms n=2000", 1, 2000, operations, 2);
+        cxx::poset_journal_close();
+    }
+
+    /*
+     * The labeled mixed workload with group commits every 10ms, the recovery of its journal,
+     * and a shorter run with every change synced on its own.
+     */
+    void journaled() {
+        journaled_stream(10, 200000);
+
+        workload_t workload("journal recovery");
+        workload.measure("journal_open", [] { return cxx::poset_journal_open(BENCH_JOURNAL, 10); });
+        workload.measure("journal_compact", [] { return cxx::poset_journal_compact(); });
+        cxx::poset_journal_close();
+        workload.report();
+
+        journaled_stream(0, 20000);
+        std::remove(BENCH_JOURNAL);
+        std::remove(BENCH_SNAPSHOT);
+    }
+
+    // The same number of operations on many small posets and on a single huge one.
+    void small_vs_huge() {
+        mixed_stream("5000 posets n=32", 5000, 32, 500000, 0);
+        mixed_stream("1 poset n=160000", 1, 160000, 500000, 0);
+    }
+
+    // Removing a quarter of a sparse DAG one element at a time and in a single call.
+    void bulk_removal() {
+        workload_t workload("removal n=20000");
+        std::mt19937 random(4);
+        std::vector<std::string> names = element_names(20000);
+
+        unsigned long id = new_poset(workload, 2);
+        insert_all(workload, id, names);
+        add_random_relations(workload, id, names, 40000, random);
+        unsigned long clone = workload.measure("clone", [&] { return cxx::poset_clone(id); });
+
+        std::vector<char const*> removed;
+        for (size_t i = 0; i < names.size(); i += 4) {
+            removed.push_back(names[i].c_str());
+        }
+        for (char const* value : removed) {
+            workload.measure("remove", [&] { return cxx::poset_remove(id, value); });
+        }
+        workload.measure("remove_many", [&] {
+            return cxx::poset_remove_many(clone, removed.data(), removed.size());
+        });
+
+        delete_poset(workload, id);
+        delete_poset(workload, clone);
+        workload.report();
+    }
+
+    /*
+     * The same random pairs of a layered DAG (see layered_dag) tested one by one and in a single batch.
+     * Every element is above most of the lower layers, so single tests search large parts of the poset.
+     */
+    void batch_test() {
+        const size_t layers = 50, width = 2000, degree = 3;
+        workload_t workload("batch 50x2000 labels=0");
+        std::mt19937 random(6);
+        std::vector<std::string> names = element_names(layers * width);
+
+        unsigned long id = new_poset(workload, 0);
+        insert_all(workload, id, names);
+        // Built from the top, so that the searches of 'poset_add' only reach the layer being added.
+        std::uniform_int_distribution<size_t> column(0, width - 1);
+        for (size_t layer = layers - 1; layer > 0; layer--) {
+            for (size_t i = 0; i < width; i++) {
+                char const* upper = names[layer * width + i].c_str();
+                for (size_t d = 0; d < degree; d++) {
+                    char const* lower = names[(layer - 1) * width + column(random)].c_str();
+                    workload.measure("add", [&] { return cxx::poset_add(id, lower, upper); });
+                }
+            }
+        }
+
+        const size_t queries = 2000;
+        std::vector<char const*> lower, upper;
+        std::uniform_int_distribution<size_t> element(0, names.size() - 1);
+        for (size_t i = 0; i < queries; i++) {
+            size_t a = element(random), b = element(random);
+            lower.push_back(names[std::min(a, b)].c_str());
+            upper.push_back(names[std::max(a, b)].c_str());
+        }
+
+        for (size_t i = 0; i < queries; i++) {
+            workload.measure("test", [&] { return cxx::poset_test(id, lower[i], upper[i]); });
+        }
+        std::unique_ptr<bool[]> results(new bool[queries]);
+        workload.measure("test_many", [&] {
+            return cxx::poset_test_many(id, lower.data(), upper.data(), queries, results.get());
+        });
+
+        delete_poset(workload, id);
+        workload.report();
+    }
+
+    // Combining two random DAGs by replaying the relations of one with 'poset_add' and with 'poset_merge'.
+    void merge() {
+        workload_t workload("merge n=2000");
+        std::mt19937 random(5);
+        std::vector<std::string> names = element_names(2000);
+
+        unsigned long target = new_poset(workload, 0), source = new_poset(workload, 0);
+        insert_all(workload, target, names);
+        insert_all(workload, source, names);
+        add_random_relations(workload, target, names, 2000, random);
+
+        std::vector<std::pair<char const*, char const*>> relations;
+        std::uniform_int_distribution<size_t> element(0, names.size() - 1);
+        for (size_t i = 0; i < 4000; i++) {
+            // Reversed in a tenth of the pairs, which then conflict with the target.
+            size_t a = element(random), b = element(random), lower = std::min(a, b), upper = std::max(a, b);
+            if (i % 10 == 0) {
+                std::swap(lower, upper);
+            }
+            if (cxx::poset_add(source, names[lower].c_str(), names[upper].c_str())) {
+                relations.push_back({names[lower].c_str(), names[upper].c_str()});
+            }
+        }
+
+        unsigned long clone = workload.measure("clone", [&] { return cxx::poset_clone(target); });
+        for (auto& [lower, upper] : relations) {
+            workload.measure("replay add", [&] { return cxx::poset_add(target, lower, upper); });
+        }
+        workload.measure("merge", [&] { return cxx::poset_merge(clone, source, NULL, NULL); });
+
+        delete_poset(workload, target);
+        delete_poset(workload, source);
+        delete_poset(workload, clone);
+        workload.report();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const std::vector<std::pair<std::string, std::function<void()>>> workloads = {
+        {"chain", chain},
+        {"antichain", antichain},
+        {"sparse", sparse_dag},
+        {"dense", dense_dag},
+        {"layered", layered_dag},
+        {"interleaved", interleaved},
+        {"mixed", mixed},
+        {"typed", typed},
+        {"traced", traced},
+        {"journaled", journaled},
+        {"small_vs_huge", small_vs_huge},
+        {"removal", bulk_removal},
+        {"merge", merge},
+        {"batch", batch_test},
+    };
+
+    std::printf("%-26s %-12s %9s %12s %9s %9s %9s %10s %10s\n", "workload", "operation", "calls",
+                "ops/s", "p50 us", "p90 us", "p99 us", "max us", "allocs/op");
+    for (auto& [name, run] : workloads) {
+        if (argc == 1 || std::find(argv + 1, argv + argc, name) != argv + argc) {
+            run();
+        }
+    }
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::printf("max resident set size %.2f MiB\n", usage.ru_maxrss / 1024.0);
+}
@@ -0,0 +1,791 @@
+/*
+ * Tests of the poset library. Every test compares a result with the same one computed another way
+ * and prints whether they agree.
+ *
+ * g++ -Wall -Wextra -O2 -std=c++17 -DNDEBUG poset.cc poset_test.cc -pthread -o poset_test
+ *
+ * './poset_test' runs every test, './poset_test persist' only the given ones.
+ * The exit status is 1 if any of them fails.
+ */
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "poset.h"
+
+namespace {
+    size_t failures = 0;
+
+    // Runs a check, which returns what went wrong, or nothing if it passed.
+    template<typename F>
+    void check(const char* test, const char* step, F&& f) {
+        std::string problem = f();
+        printf("%-24s %-48s %s\n", test, step, problem.empty() ? "ok" : ("FAILED: " + problem).c_str());
+        failures += !problem.empty();
+    }
+
+    std::vector<std::string> element_names(size_t n) {
+        std::vector<std::string> names;
+        for (size_t i = 0; i < n; i++) {
+            names.push_back("e" + std::to_string(i));
+        }
+        return names;
+    }
+
+    /*
+     * A new poset with random names out of 'names' and random relations between them, some of which
+     * are deleted again. Relations go from lower to higher indices, so the order is mostly random,
+     * but most of the pairs can be added.
+     */
+    unsigned long random_poset(const std::vector<std::string>& names, size_t elements, size_t relations,
+                               unsigned seed) {
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<size_t> element(0, names.size() - 1);
+        unsigned long id = cxx::poset_new();
+
+        for (size_t i = 0; i < elements; i++) {
+            cxx::poset_insert(id, names[element(random)].c_str());
+        }
+        for (size_t i = 0; i < relations; i++) {
+            size_t a = element(random), b = element(random);
+            char const* lower = names[std::min(a, b)].c_str();
+            char const* upper = names[std::max(a, b)].c_str();
+            if (i % 8 == 7) {
+                cxx::poset_del(id, lower, upper);
+            } else {
+                cxx::poset_add(id, lower, upper);
+            }
+        }
+        return id;
+    }
+
+    // The size of the poset followed by the results of 'poset_test' for every pair of the names.
+    std::string describe(unsigned long id, const std::vector<std::string>& names) {
+        std::string description = std::to_string(cxx::poset_size(id)) + ':';
+        for (const std::string& lower : names) {
+            for (const std::string& upper : names) {
+                description += cxx::poset_test(id, lower.c_str(), upper.c_str()) ? '1' : '0';
+            }
+        }
+        return description;
+    }
+
+    std::string read_file(const char* path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    void write_file(const char* path, const std::string& contents) {
+        std::ofstream(path, std::ios::binary).write(contents.data(), contents.size());
+    }
+
+    // Whether 'poset_load' and, unless 'opened_too' is false, 'poset_open' reject the file with the given contents.
+    std::string rejected(const char* path, const std::string& contents, bool opened_too = true) {
+        write_file(path, contents);
+        unsigned long loaded = cxx::poset_load(path);
+        unsigned long opened = opened_too ? cxx::poset_open(path) : POSET_INVALID_ID;
+        std::remove(path);
+        cxx::poset_delete(loaded);
+        cxx::poset_delete(opened);
+        return loaded == POSET_INVALID_ID && opened == POSET_INVALID_ID ? "" : "accepted";
+    }
+
+    /*
+     * Offsets into a saved image of n elements: a header of 40 bytes, then n + 1 string offsets and n + 1
+     * edge offsets, each of 8 bytes, then the 4-byte edge targets.
+     */
+    const size_t IMAGE_HEADER_SIZE = 40;
+
+    size_t edge_offsets_at(size_t n) {
+        return IMAGE_HEADER_SIZE + (n + 1) * sizeof(uint64_t);
+    }
+
+    size_t edge_targets_at(size_t n) {
+        return IMAGE_HEADER_SIZE + 2 * (n + 1) * sizeof(uint64_t);
+    }
+
+    // Saved posets are loaded and opened with the same relations, malformed files are rejected.
+    void persist() {
+        const char* path = "poset_test.tmp";
+        const char* copy_path = "poset_test.copy.tmp";
+        std::vector<std::string> names = element_names(240);
+        unsigned long id = random_poset(names, 200, 600, 1);
+        std::string expected = describe(id, names);
+
+        for (bool with_closure : {false, true}) {
+            std::string closure = with_closure ? ", with the closure" : ", without the closure";
+            check("persist", ("save and load" + closure).c_str(), [&]() -> std::string {
+                if (!cxx::poset_save(id, path, with_closure))
+                    return "not saved";
+                unsigned long loaded = cxx::poset_load(path);
+                std::string problem = loaded == POSET_INVALID_ID ? "not loaded"
+                                      : describe(loaded, names) != expected ? "relations differ" : "";
+                cxx::poset_delete(loaded);
+                return problem;
+            });
+            check("persist", ("save and open" + closure).c_str(), [&]() -> std::string {
+                unsigned long opened = cxx::poset_open(path);
+                std::string problem = opened == POSET_INVALID_ID ? "not opened"
+                                      : describe(opened, names) != expected ? "relations differ" : "";
+                cxx::poset_delete(opened);
+                return problem;
+            });
+            check("persist", ("open, save and load" + closure).c_str(), [&]() -> std::string {
+                unsigned long opened = cxx::poset_open(path);
+                bool saved = cxx::poset_save(opened, copy_path, false);
+                cxx::poset_delete(opened);
+                unsigned long loaded = cxx::poset_load(copy_path);
+                std::remove(copy_path);
+                std::string problem = !saved ? "not saved" : loaded == POSET_INVALID_ID ? "not loaded"
+                                      : describe(loaded, names) != expected ? "relations differ" : "";
+                cxx::poset_delete(loaded);
+                return problem;
+            });
+        }
+
+        check("persist", "save over an opened file", [&]() -> std::string {
+            unsigned long opened = cxx::poset_open(path);
+            unsigned long other = random_poset(names, 100, 200, 2);
+            bool saved = cxx::poset_save(other, path, true);
+            std::string problem = !saved ? "not saved" : describe(opened, names) != expected ? "opened poset changed" : "";
+            unsigned long reopened = cxx::poset_open(path);
+            if (problem.empty() && describe(reopened, names) != describe(other, names))
+                problem = "new file differs";
+            cxx::poset_delete(opened);
+            cxx::poset_delete(reopened);
+            cxx::poset_delete(other);
+            cxx::poset_save(id, path, true);
+            return problem;
+        });
+
+        std::string saved = read_file(path);
+        check("persist", "truncated files", [&]() -> std::string {
+            for (size_t cut = 0; cut < saved.size(); cut += 1 + saved.size() / 300) {
+                if (!rejected(path, saved.substr(0, cut)).empty())
+                    return "accepted " + std::to_string(cut) + " bytes";
+            }
+            return cxx::poset_load("poset_test.missing") == POSET_INVALID_ID ? "" : "missing file accepted";
+        });
+        check("persist", "corrupted files", [&]() -> std::string {
+            size_t n = cxx::poset_size(id);
+            auto corrupted = [&](size_t at, const void* bytes, size_t length) {
+                std::string contents = saved;
+                contents.replace(at, length, static_cast<const char*>(bytes), length);
+                return contents;
+            };
+
+            // The first element with an edge, whose first target is set to itself.
+            size_t row = 0;
+            uint64_t offsets[2] = {0, 0};
+            for (; row < n; row++) {
+                std::memcpy(offsets, saved.data() + edge_offsets_at(n) + row * sizeof(uint64_t), sizeof(offsets));
+                if (offsets[0] < offsets[1])
+                    break;
+            }
+            uint32_t self = row, outside = n, version = 2, flags = 0;
+            const std::vector<std::pair<const char*, std::string>> files = {
+                {"magic", corrupted(0, "POSETIMX", 8)},
+                {"version", corrupted(8, &version, sizeof(version))},
+                {"closure flag", corrupted(12, &flags, sizeof(flags))},
+                {"edge to itself", corrupted(edge_targets_at(n) + offsets[0] * sizeof(uint32_t), &self, sizeof(self))},
+                {"edge outside", corrupted(edge_targets_at(n), &outside, sizeof(outside))},
+                {"null in an element", corrupted(saved.size() - 1, "\0", 1)},
+                {"trailing byte", saved + '\0'},
+            };
+            for (auto& [corruption, contents] : files) {
+                if (!rejected(path, contents).empty())
+                    return std::string(corruption) + " accepted";
+            }
+            return "";
+        });
+        check("persist", "cycle", [&]() -> std::string {
+            // Elements a, b and c with a < b and a < c, whose edges are turned into b < c and c < b.
+            unsigned long small = cxx::poset_new();
+            for (char const* value : {"a", "b", "c"}) {
+                cxx::poset_insert(small, value);
+            }
+            cxx::poset_add(small, "a", "b");
+            cxx::poset_add(small, "a", "c");
+            bool saved_small = cxx::poset_save(small, path, false);
+            cxx::poset_delete(small);
+            std::string contents = read_file(path);
+            uint32_t targets[2] = {2, 1};
+            if (!saved_small || contents.size() < edge_targets_at(3) + sizeof(targets))
+                return "not saved";
+            contents.replace(edge_targets_at(3), sizeof(targets), reinterpret_cast<const char*>(targets),
+                             sizeof(targets));
+            // Only loading checks for cycles, opened files are trusted to come from 'poset_save'.
+            return rejected(path, contents, false).empty() ? "" : "loaded";
+        });
+
+        std::remove(path);
+        cxx::poset_delete(id);
+    }
+
+    // Inserts, adds, deletes and removes random elements and relations of the poset.
+    void change_randomly(unsigned long id, const std::vector<std::string>& names, size_t changes, unsigned seed) {
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<size_t> element(0, names.size() - 1);
+        for (size_t i = 0; i < changes; i++) {
+            size_t a = element(random), b = element(random);
+            char const* lower = names[std::min(a, b)].c_str();
+            char const* upper = names[std::max(a, b)].c_str();
+            switch (i % 8) {
+                case 0:
+                    cxx::poset_insert(id, lower);
+                    break;
+                case 1:
+                    cxx::poset_remove(id, upper);
+                    break;
+                case 2:
+                    cxx::poset_del(id, lower, upper);
+                    break;
+                default:
+                    cxx::poset_add(id, lower, upper);
+            }
+        }
+    }
+
+    // The relations and memory usage of a poset, to be compared before and after changing another one.
+    std::string describe_with_memory(unsigned long id, const std::vector<std::string>& names) {
+        return describe(id, names) + ':' + std::to_string(cxx::poset_memory_usage(id));
+    }
+
+    // A poset and its clone change independently of each other, like posets built separately.
+    void clones() {
+        std::vector<std::string> names = element_names(150);
+        // Built and changed in the same way as the original and the clone.
+        unsigned long reference = random_poset(names, 120, 300, 3);
+        unsigned long changed_reference = random_poset(names, 120, 300, 3);
+        change_randomly(changed_reference, names, 2000, 4);
+
+        unsigned long original = random_poset(names, 120, 300, 3);
+        unsigned long copy = cxx::poset_clone(original);
+        check("clone", "clone of a poset", [&]() -> std::string {
+            return describe(copy, names) == describe(reference, names) ? "" : "relations differ";
+        });
+        check("clone", "changing the clone", [&]() -> std::string {
+            std::string before = describe_with_memory(original, names);
+            change_randomly(copy, names, 2000, 4);
+            if (describe_with_memory(original, names) != before)
+                return "original changed";
+            return describe(copy, names) == describe(changed_reference, names) ? "" : "clone differs";
+        });
+        check("clone", "changing the original", [&]() -> std::string {
+            std::string before = describe_with_memory(copy, names);
+            change_randomly(original, names, 2000, 4);
+            if (describe_with_memory(copy, names) != before)
+                return "clone changed " + before.substr(before.rfind(':')) + " " + std::to_string(cxx::poset_memory_usage(copy));
+            return describe(original, names) == describe(changed_reference, names) ? "" : "original differs";
+        });
+        check("clone", "changing the original first", [&]() -> std::string {
+            unsigned long source = random_poset(names, 120, 300, 3), other = cxx::poset_clone(source);
+            std::string before = describe_with_memory(other, names);
+            change_randomly(source, names, 2000, 4);
+            std::string problem = describe_with_memory(other, names) != before ? "clone changed"
+                                  : describe(source, names) != describe(changed_reference, names) ? "original differs" : "";
+            before = describe_with_memory(source, names);
+            change_randomly(other, names, 2000, 4);
+            if (problem.empty() && describe_with_memory(source, names) != before)
+                problem = "original changed";
+            cxx::poset_delete(source);
+            cxx::poset_delete(other);
+            return problem;
+        });
+        check("clone", "deleting the original of a clone", [&]() -> std::string {
+            unsigned long source = random_poset(names, 120, 300, 3), other = cxx::poset_clone(source);
+            std::string before = describe_with_memory(other, names);
+            cxx::poset_delete(source);
+            if (describe_with_memory(other, names) != before || describe(other, names) != describe(reference, names))
+                return "clone changed";
+            change_randomly(other, names, 2000, 4);
+            std::string problem = describe(other, names) == describe(changed_reference, names) ? "" : "clone differs";
+            cxx::poset_delete(other);
+            return problem;
+        });
+        check("clone", "deleting the original after changing the clone", [&]() -> std::string {
+            unsigned long source = random_poset(names, 120, 300, 3), other = cxx::poset_clone(source);
+            change_randomly(other, names, 100, 4);
+            cxx::poset_delete(source);
+            change_randomly(other, names, 200, 5);
+            unsigned long expected = random_poset(names, 120, 300, 3);
+            change_randomly(expected, names, 100, 4);
+            change_randomly(expected, names, 200, 5);
+            std::string problem = describe(other, names) == describe(expected, names) ? "" : "clone differs";
+            cxx::poset_delete(other);
+            cxx::poset_delete(expected);
+            return problem;
+        });
+
+        for (unsigned long id : {reference, changed_reference, original, copy}) {
+            cxx::poset_delete(id);
+        }
+    }
+
+    /*
+     * Labeled posets give the same results as unlabeled ones, while they grow one element at a time,
+     * are cloned, and lose elements and relations.
+     */
+    void labels() {
+        std::vector<std::string> names = element_names(3000);
+        for (unsigned dimensions : {1, 2, 4}) {
+            std::string step = std::to_string(dimensions) + " dimensions";
+            check("labels", step.c_str(), [&]() -> std::string {
+                std::mt19937 random(dimensions);
+                unsigned long labeled = cxx::poset_new(), unlabeled = cxx::poset_new();
+                cxx::poset_set_labeling(labeled, dimensions);
+                std::string problem;
+
+                for (size_t i = 0; i < names.size() && problem.empty(); i++) {
+                    char const* value = names[i].c_str();
+                    char const* lower = names[random() % (i + 1)].c_str();
+                    char const* other = names[random() % (i + 1)].c_str();
+                    if (cxx::poset_insert(labeled, value) != cxx::poset_insert(unlabeled, value) ||
+                            cxx::poset_add(labeled, lower, value) != cxx::poset_add(unlabeled, lower, value) ||
+                            cxx::poset_add(labeled, other, lower) != cxx::poset_add(unlabeled, other, lower))
+                        problem = "changed differently at element " + std::to_string(i);
+                    if (i % 500 == 499) {
+                        unsigned long clone = cxx::poset_clone(labeled);
+                        cxx::poset_delete(labeled);
+                        labeled = clone;
+                    }
+                    if (i % 7 == 6) {
+                        cxx::poset_remove(labeled, other);
+                        cxx::poset_remove(unlabeled, other);
+                    }
+                    if (i % 5 == 4) {
+                        cxx::poset_del(labeled, lower, value);
+                        cxx::poset_del(unlabeled, lower, value);
+                    }
+                    for (size_t q = 0; q < 20 && problem.empty(); q++) {
+                        char const* a = names[random() % (i + 1)].c_str();
+                        char const* b = names[random() % (i + 1)].c_str();
+                        if (cxx::poset_test(labeled, a, b) != cxx::poset_test(unlabeled, a, b))
+                            problem = "test of " + std::string(a) + " and " + b + " differs";
+                    }
+                }
+
+                cxx::poset_delete(labeled);
+                cxx::poset_delete(unlabeled);
+                return problem;
+            });
+        }
+    }
+
+    /*
+     * Runs 'f' in a child process and returns its result. The journal can only be opened before
+     * any poset is created, and the child can exit without closing it, like a crashed process.
+     */
+    std::string in_child(const std::function<std::string()>& f) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            return "no pipe";
+        }
+
+        fflush(stdout);
+        pid_t child = fork();
+        if (child == 0) {
+            close(fds[0]);
+            std::string result = f();
+            for (size_t written = 0; written < result.size();) {
+                ssize_t status = write(fds[1], result.data() + written, result.size() - written);
+                if (status <= 0) {
+                    break;
+                }
+                written += status;
+            }
+            _exit(0);
+        }
+
+        close(fds[1]);
+        std::string result;
+        char buffer[4096];
+        for (ssize_t length; (length = read(fds[0], buffer, sizeof(buffer))) > 0;) {
+            result.append(buffer, length);
+        }
+        close(fds[0]);
+
+        int status = 0;
+        if (child < 0 || waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            return "child failed";
+        }
+        return result;
+    }
+
+    const size_t JOURNALED_CHANGES = 600;
+    // The number of posets created by the journaled changes.
+    const size_t JOURNALED_POSETS = 4;
+
+    /*
+     * Applies the change number 'i' of the journal tests, creating posets into 'ids'. Every kind
+     * of change is journaled, and the last one always succeeds, so losing its record is visible.
+     */
+    void journaled_change(std::vector<unsigned long>& ids, const std::vector<std::string>& names, size_t i) {
+        std::mt19937 random(i);
+        std::uniform_int_distribution<size_t> element(0, names.size() - 1);
+        size_t a = element(random), b = element(random);
+        char const* lower = names[std::min(a, b)].c_str();
+        char const* upper = names[std::max(a, b)].c_str();
+        unsigned long id = ids.empty() ? 0 : ids[random() % ids.size()];
+
+        if (i == 0) {
+            ids = {cxx::poset_new(), cxx::poset_new()};
+        } else if (i == 150) {
+            ids.push_back(cxx::poset_clone(ids[0]));
+        } else if (i == 200) {
+            cxx::poset_set_labeling(ids[1], 2);
+        } else if (i == 300) {
+            char const* removed[] = {lower, upper, names[0].c_str()};
+            cxx::poset_remove_many(ids[2], removed, 3);
+        } else if (i == 350) {
+            cxx::poset_merge(ids[2], ids[1], nullptr, nullptr);
+        } else if (i == 400) {
+            cxx::poset_delete(ids[1]);
+            ids.push_back(cxx::poset_new());
+        } else if (i == 450) {
+            cxx::poset_clear(ids[0]);
+        } else if (i == JOURNALED_CHANGES - 1) {
+            cxx::poset_insert(ids[0], "last");
+        } else {
+            switch (random() % 8) {
+                case 0:
+                    cxx::poset_remove(id, upper);
+                    break;
+                case 1:
+                    cxx::poset_del(id, lower, upper);
+                    break;
+                case 2:
+                case 3:
+                    cxx::poset_insert(id, lower);
+                    cxx::poset_insert(id, upper);
+                    break;
+                default:
+                    cxx::poset_add(id, lower, upper);
+            }
+        }
+    }
+
+    // The descriptions of all posets created by the journaled changes, deleted and not yet created ones included.
+    std::string describe_all(std::vector<unsigned long> ids, const std::vector<std::string>& names) {
+        ids.resize(JOURNALED_POSETS, POSET_INVALID_ID);
+        std::string description;
+        for (unsigned long id : ids) {
+            description += describe(id, names) + '|';
+        }
+        return description;
+    }
+
+    std::string join_ids(const std::vector<unsigned long>& ids) {
+        std::string joined;
+        for (unsigned long id : ids) {
+            joined += std::to_string(id) + ' ';
+        }
+        return joined;
+    }
+
+    std::vector<unsigned long> split_ids(const std::string& joined) {
+        std::vector<unsigned long> ids;
+        for (size_t start = 0, end; (end = joined.find(' ', start)) != std::string::npos; start = end + 1) {
+            ids.push_back(std::stoul(joined.substr(start, end - start)));
+        }
+        return ids;
+    }
+
+    /*
+     * Posets restored from the journal after the process exits without closing it are the same
+     * as the ones built by the changes it has written, without the torn or damaged last record.
+     */
+    void journal() {
+        std::vector<std::string> names = element_names(30);
+        const char* path = "poset_test.journal";
+        std::string snapshot = std::string(path) + ".snapshot";
+
+        // The descriptions after every number of changes, computed without the journal.
+        std::vector<std::string> expected(JOURNALED_CHANGES + 1);
+        std::vector<unsigned long> reference;
+        expected[0] = describe_all(reference, names);
+        for (size_t i = 0; i < JOURNALED_CHANGES; i++) {
+            journaled_change(reference, names, i);
+            expected[i + 1] = describe_all(reference, names);
+        }
+        // Children delete the reference posets first, the journal can only be opened without posets.
+        auto without_reference = [&](const std::function<std::string()>& f) {
+            return [&, f]() {
+                for (unsigned long id : reference) {
+                    cxx::poset_delete(id);
+                }
+                return f();
+            };
+        };
+
+        auto remove_files = [&]() {
+            std::remove(path);
+            std::remove(snapshot.c_str());
+        };
+        // Starts a new journal, applies the changes, syncs the journal after 'synced' of them, compacts it
+        // after 'compacted' of them, and exits without closing it. The result is the ids of the posets.
+        auto write_changes = [&](unsigned interval, size_t synced, size_t compacted) {
+            remove_files();
+            return in_child(without_reference([&]() -> std::string {
+                if (!cxx::poset_journal_open(path, interval)) {
+                    return "not opened";
+                }
+                std::vector<unsigned long> ids;
+                for (size_t i = 0; i < JOURNALED_CHANGES; i++) {
+                    if (i == synced && !cxx::poset_journal_sync()) {
+                        return "not synced";
+                    }
+                    if (i == compacted && !cxx::poset_journal_compact()) {
+                        return "not compacted";
+                    }
+                    journaled_change(ids, names, i);
+                }
+                return join_ids(ids);
+            }));
+        };
+        // Reopens the journal, and the result is the description of the restored posets.
+        auto restore = [&](const std::string& ids, const std::function<void()>& then = [] {}) {
+            return in_child(without_reference([&]() -> std::string {
+                if (!cxx::poset_journal_open(path, 0)) {
+                    return "not opened";
+                }
+                std::string description = describe_all(split_ids(ids), names);
+                then();
+                return description;
+            }));
+        };
+        // The number of changes after which the posets are like the restored ones, from 'first' on.
+        auto restored_after = [&](const std::string& restored, size_t first) -> std::string {
+            for (size_t i = first; i <= JOURNALED_CHANGES; i++) {
+                if (restored == expected[i]) {
+                    return std::to_string(i);
+                }
+            }
+            return restored.size() < 40 ? restored : "no match";
+        };
+
+        check("journal", "abrupt exit, commit interval 0", [&]() -> std::string {
+            std::string ids = write_changes(0, JOURNALED_CHANGES, JOURNALED_CHANGES);
+            std::string restored = restored_after(restore(ids), 0);
+            return restored == std::to_string(JOURNALED_CHANGES) ? "" : "restored " + restored;
+        });
+        check("journal", "abrupt exit, commit interval 60s", [&]() -> std::string {
+            // Changes after the sync may or may not be written, but the synced ones are.
+            std::string ids = write_changes(60000, JOURNALED_CHANGES / 2, JOURNALED_CHANGES);
+            std::string restored = restored_after(restore(ids), JOURNALED_CHANGES / 2);
+            return isdigit(restored[0]) ? "" : "restored " + restored;
+        });
+        for (bool torn : {true, false}) {
+            check("journal", torn ? "torn last record" : "bad checksum of the last record", [&]() -> std::string {
+                std::string ids = write_changes(0, JOURNALED_CHANGES, JOURNALED_CHANGES);
+                std::string contents = read_file(path);
+                if (torn) {
+                    contents.resize(contents.size() - 3);
+                } else {
+                    contents.back() ^= 1;
+                }
+                write_file(path, contents);
+
+                std::string restored = restored_after(restore(ids, [&]() {
+                    cxx::poset_insert(split_ids(ids)[0], "after");
+                }), 0);
+                if (restored != std::to_string(JOURNALED_CHANGES - 1)) {
+                    return "restored " + restored;
+                }
+                // The record written after reopening follows the last good one, and it inserts an element
+                // in place of the lost one, like the last change.
+                std::string reopened = restored_after(restore(ids), 0);
+                return reopened == std::to_string(JOURNALED_CHANGES) ? "" : "reopened " + reopened;
+            });
+        }
+        check("journal", "reopening after compaction", [&]() -> std::string {
+            std::string ids = write_changes(0, JOURNALED_CHANGES, JOURNALED_CHANGES / 2);
+            std::string restored = restored_after(restore(ids), 0);
+            if (restored != std::to_string(JOURNALED_CHANGES)) {
+                return "restored " + restored;
+            }
+            // Compacted again on reopening, and restored from the snapshot alone.
+            restore(ids, [] { cxx::poset_journal_compact(); });
+            restored = restored_after(restore(ids), 0);
+            return restored == std::to_string(JOURNALED_CHANGES) ? "" : "restored " + restored + " after compaction";
+        });
+
+        remove_files();
+        for (unsigned long id : reference) {
+            cxx::poset_delete(id);
+        }
+    }
+
+    using pairs_t = std::vector<std::pair<std::string, std::string>>;
+
+    void collect_pair(char const* value1, char const* value2, void* context) {
+        static_cast<pairs_t*>(context)->push_back({value1, value2});
+    }
+
+    /*
+     * Merging a poset is the same as inserting its elements and calling 'poset_add' for every pair
+     * of them in strcmp order, with the same pairs rejected in the same order. Every other source
+     * poset has its relations reversed, so that many of its pairs are rejected.
+     */
+    void merges() {
+        std::vector<std::string> names = element_names(40);
+        std::vector<std::string> reversed(names.rbegin(), names.rend());
+        std::vector<std::string> sorted = names;
+        std::sort(sorted.begin(), sorted.end(), [](const std::string& a, const std::string& b) {
+            return strcmp(a.c_str(), b.c_str()) < 0;
+        });
+
+        for (unsigned batch = 1; batch <= 4; batch++) {
+            std::string step = "seeds " + std::to_string(100 * batch - 99) + " to " + std::to_string(100 * batch);
+            check("merge", step.c_str(), [&]() -> std::string {
+                for (unsigned s = 100 * batch - 99; s <= 100 * batch; s++) {
+                    unsigned long target = random_poset(names, 25, 40 + s % 80, s);
+                    unsigned long expected = random_poset(names, 25, 40 + s % 80, s);
+                    unsigned long source = random_poset(s % 2 == 0 ? reversed : names, 25, 40 + s % 80, s + 1000);
+                    if (s % 3 == 0) {
+                        cxx::poset_set_labeling(target, 2);
+                    }
+
+                    pairs_t rejected, expected_rejected;
+                    for (const std::string& value : sorted) {
+                        if (cxx::poset_test(source, value.c_str(), value.c_str())) {
+                            cxx::poset_insert(expected, value.c_str());
+                        }
+                    }
+                    for (const std::string& value1 : sorted) {
+                        for (const std::string& value2 : sorted) {
+                            char const* lower = value1.c_str();
+                            char const* upper = value2.c_str();
+                            if (value1 != value2 && cxx::poset_test(source, lower, upper) &&
+                                    !cxx::poset_add(expected, lower, upper) && cxx::poset_test(expected, upper, lower)) {
+                                expected_rejected.push_back({value1, value2});
+                            }
+                        }
+                    }
+                    size_t count = cxx::poset_merge(target, source, collect_pair, &rejected);
+
+                    std::string problem;
+                    if (describe(target, names) != describe(expected, names))
+                        problem = "relations differ";
+                    else if (rejected != expected_rejected || count != rejected.size())
+                        problem = "rejected pairs differ";
+                    for (unsigned long id : {target, expected, source}) {
+                        cxx::poset_delete(id);
+                    }
+                    if (!problem.empty())
+                        return problem + " for seed " + std::to_string(s);
+                }
+                return "";
+            });
+        }
+    }
+
+    /*
+     * Calls 'poset_test_many' for n random pairs of the names, some of them NULL, and compares
+     * every result with 'poset_test'. Second values are drawn from the first 'uppers' names, and
+     * every other first value precedes its second value in the names, like related elements do.
+     */
+    std::string test_many_like_test(unsigned long id, const std::vector<std::string>& names, size_t n,
+                                    size_t uppers, unsigned seed) {
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<size_t> lower(0, names.size()), upper(0, uppers);
+        std::vector<char const*> values1, values2;
+        for (size_t i = 0; i < n; i++) {
+            size_t b = upper(random), a = i % 2 == 0 ? lower(random) : lower(random) % (b + 1);
+            values1.push_back(a < names.size() ? names[a].c_str() : nullptr);
+            values2.push_back(b < uppers ? names[b].c_str() : nullptr);
+        }
+
+        std::unique_ptr<bool[]> results(new bool[n]);
+        size_t count = cxx::poset_test_many(id, values1.data(), values2.data(), n, results.get());
+        size_t expected_count = 0;
+        for (size_t i = 0; i < n; i++) {
+            bool expected = cxx::poset_test(id, values1[i], values2[i]);
+            expected_count += expected;
+            if (results[i] != expected) {
+                return "pair " + std::to_string(i) + " differs";
+            }
+        }
+        return count == expected_count ? "" : "count differs";
+    }
+
+    /*
+     * 'poset_test_many' gives the same results as 'poset_test' for batches answered pair by pair
+     * and in sweeps, for many distinct second values, and for read-only posets. Names beyond
+     * the ones in the poset and NULL values are in every batch.
+     */
+    void test_many() {
+        std::vector<std::string> names = element_names(600);
+        unsigned long id = random_poset(names, 600, 8000, 6);
+        struct batch_t {
+            const char* step;
+            size_t n, uppers;
+        };
+        const batch_t batches[] = {
+            {"fewer than 64 pairs", 40, 600},
+            {"more than 64 pairs", 2000, 100},
+            {"more than 256 second values", 20000, 600},
+        };
+
+        auto check_batches = [&](unsigned long tested, const char* kind) {
+            for (const batch_t& batch : batches) {
+                std::string step = std::string(batch.step) + kind;
+                check("test_many", step.c_str(), [&]() -> std::string {
+                    if (tested == POSET_INVALID_ID)
+                        return "not opened";
+                    return test_many_like_test(tested, names, batch.n, batch.uppers, batch.n);
+                });
+            }
+        };
+        check_batches(id, "");
+
+        const char* path = "poset_test.tmp";
+        for (bool with_closure : {false, true}) {
+            cxx::poset_save(id, path, with_closure);
+            unsigned long opened = cxx::poset_open(path);
+            check_batches(opened, with_closure ? ", opened, closure" : ", opened");
+            cxx::poset_delete(opened);
+        }
+        std::remove(path);
+
+        check("test_many", "deleted poset", [&]() -> std::string {
+            cxx::poset_delete(id);
+            char const* values[] = {names[0].c_str()};
+            bool result = true;
+            return cxx::poset_test_many(id, values, values, 1, &result) == 0 && result ? "" : "results changed";
+        });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const std::vector<std::pair<const char*, std::function<void()>>> tests = {
+        {"persist", persist},
+        {"clone", clones},
+        {"labels", labels},
+        {"journal", journal},
+        {"merge", merges},
+        {"test_many", test_many},
+    };
+
+    for (auto& [name, test] : tests) {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; i++) {
+            selected |= strcmp(argv[i], name) == 0;
+        }
+        if (selected) {
+            test();
+        }
+    }
+    return failures > 0;
+}
@@ -0,0 +1,118 @@
+#ifndef POSET_TRACE_H
+#define POSET_TRACE_H
+
+#include <cstdint>
+
+/*
+ * Binary format of the call traces written by 'poset_trace_dump' and read by poset_trace_decode.
+ * All numbers are in host byte order.
+ *
+ *   file_header_t
+ *   'string_count' times: string_header_t followed by 'length' bytes of the string
+ *   'thread_count' times: thread_header_t followed by 'record_count' records of the thread
+ *
+ * The string table contains the strings interned at the moment of the dump. Strings erased
+ * earlier and values that were not interned when they were traced are defined by STRING records
+ * among the records, so every string id used by a record can be resolved. Ids of strings that
+ * were not interned have the INLINE_STRING bit set.
+ */
+namespace poset_trace {
+    constexpr char FILE_MAGIC[8] = {'P', 'O', 'S', 'E', 'T', 'T', 'R', 'C'};
+    constexpr uint32_t FILE_VERSION = 2;
+
+    constexpr uint64_t INLINE_STRING = uint64_t(1) << 63;
+    // Longer strings are truncated, the record keeps their full length.
+    constexpr uint64_t MAX_STRING_LENGTH = 1024;
+    // Values of a poset_remove_many call traced by VALUES records, the record of the call keeps their number.
+    constexpr uint64_t MAX_TRACED_VALUES = 1024;
+
+    struct file_header_t {
+        char magic[8];
+        uint32_t version;
+        uint32_t thread_count;
+        uint64_t string_count;
+    };
+
+    struct string_header_t {
+        uint64_t id;
+        uint64_t length;
+    };
+
+    // Threads are numbered by their buffers, a buffer is reused by a new thread once its thread exits.
+    struct thread_header_t {
+        uint64_t thread;
+        uint64_t record_count;
+    };
+
+    enum type_t : uint16_t {
+        STRING = 1,  // Defines the string 'value1': 'argument' is its length, 'result' the number of stored bytes.
+        STRING_DATA, // Next STRING_PAYLOAD bytes of the string, stored from 'poset' onwards.
+        POSET_NEW,
+        POSET_DELETE,
+        POSET_SIZE,
+        POSET_INSERT,
+        POSET_REMOVE,
+        POSET_REMOVE_MANY,
+        POSET_ADD,
+        POSET_DEL,
+        POSET_TEST,
+        POSET_CLEAR,
+        POSET_CLONE,
+        POSET_LOWER_SET,
+        POSET_UPPER_SET,
+        POSET_MINIMAL,
+        POSET_MAXIMAL,
+        POSET_SET_LABELING,
+        POSET_SAVE,
+        POSET_LOAD,
+        POSET_OPEN,
+        POSET_MEMORY_USAGE,
+        POSET_TOTAL_MEMORY_USAGE,
+        POSET_MERGE,
+        POSET_TEST_MANY,
+        VALUES, // Next values of the preceding call: 'value1' and, if 'argument' is 2, 'value2'.
+        TYPE_COUNT
+    };
+
+    constexpr const char* FUNCTION_NAMES[TYPE_COUNT] = {
+        "", "", "",
+        "poset_new", "poset_delete", "poset_size", "poset_insert", "poset_remove", "poset_remove_many",
+        "poset_add", "poset_del", "poset_test", "poset_clear", "poset_clone", "poset_lower_set",
+        "poset_upper_set", "poset_minimal", "poset_maximal", "poset_set_labeling", "poset_save",
+        "poset_load", "poset_open", "poset_memory_usage", "poset_total_memory_usage", "poset_merge",
+        "poset_test_many", ""
+    };
+
+    // State of the poset and its arguments before the call.
+    enum flag_t : uint16_t {
+        POSET_EXISTS = 1,    // A modifiable poset with the id exists.
+        POSET_READ_ONLY = 2, // A read-only poset with the id exists.
+        VALUE1_IN_POSET = 4,
+        VALUE2_IN_POSET = 8,
+        OTHER_POSET_EXISTS = 16, // A modifiable poset with the id in 'argument' exists.
+        NULL_VALUES = 32         // poset_remove_many got NULL instead of 'argument' values.
+    };
+
+    /*
+     * A single call of an API function. Element values and paths are string ids, 0 stands for NULL.
+     * 'argument' holds the other argument of the call: the number of values for poset_remove_many,
+     * which are listed by the VALUES records right after the call, and of pairs for poset_test_many,
+     * the dimensions for poset_set_labeling, 'with_closure' for poset_save and the merged poset for poset_merge.
+     * Functions creating a poset store its id in 'result'.
+     */
+    struct record_t {
+        uint64_t timestamp; // Steady clock nanoseconds at the start of the call.
+        uint32_t duration;  // Nanoseconds, saturated.
+        uint16_t type;      // type_t
+        uint16_t flags;     // flag_t
+        uint64_t poset;
+        uint64_t value1;
+        uint64_t value2;
+        uint64_t argument;
+        uint64_t result;
+    };
+
+    constexpr uint64_t STRING_PAYLOAD = sizeof(record_t) - 2 * sizeof(uint64_t);
+}
+
+#endif // POSET_TRACE_H
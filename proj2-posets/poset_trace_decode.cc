@@ -0,0 +1,392 @@
+/*
+ * Decodes a trace written by 'poset_trace_dump' into the messages printed by debug builds
+ * of the poset library. With '-t' every call is additionally preceded by the thread,
+ * the start time relative to the first call and the duration of the call.
+ *
+ * g++ -Wall -Wextra -O2 -std=c++17 poset_trace_decode.cc -o poset_trace_decode
+ * ./poset_trace_decode [-t] trace.bin
+ */
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "poset_trace.h"
+
+namespace {
+    using namespace poset_trace;
+
+    struct call_t {
+        uint64_t thread;
+        record_t record;
+        std::vector<std::pair<uint64_t, bool>> values; // From VALUES records, with VALUE1_IN_POSET.
+    };
+
+    class trace_t {
+    public:
+        bool read(std::istream& in) {
+            file_header_t header;
+            if (!read_value(in, header) || std::memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) != 0 ||
+                    header.version != FILE_VERSION) {
+                return false;
+            }
+
+            for (uint64_t i = 0; i < header.string_count; i++) {
+                string_header_t string_header;
+                if (!read_value(in, string_header)) {
+                    return false;
+                }
+                std::string& value = strings[string_header.id];
+                value.resize(string_header.length);
+                if (!in.read(value.data(), string_header.length)) {
+                    return false;
+                }
+            }
+
+            for (uint32_t i = 0; i < header.thread_count; i++) {
+                thread_header_t thread_header;
+                if (!read_value(in, thread_header)) {
+                    return false;
+                }
+                std::vector<record_t> records(thread_header.record_count);
+                if (!in.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(record_t))) {
+                    return false;
+                }
+                add_records(thread_header.thread, records);
+            }
+
+            std::stable_sort(calls.begin(), calls.end(), [](const call_t& a, const call_t& b) {
+                return a.record.timestamp < b.record.timestamp;
+            });
+            return true;
+        }
+
+        void print(std::ostream& out, bool with_timing) const {
+            uint64_t first = calls.empty() ? 0 : calls.front().record.timestamp;
+
+            for (const call_t& call : calls) {
+                if (with_timing) {
+                    out << "[thread " << call.thread << " +" << (call.record.timestamp - first) / 1000.0
+                        << "us " << call.record.duration / 1000.0 << "us]\n";
+                }
+                for (const std::string& message : messages(call)) {
+                    out << message << "\n";
+                }
+            }
+        }
+
+    private:
+        template<typename T>
+        static bool read_value(std::istream& in, T& value) {
+            return bool(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+        }
+
+        /*
+         * Splits the records into calls and string definitions. Truncated strings end with "...".
+         * VALUES records go to the call right before them, they are dropped if the buffer has
+         * overwritten the call.
+         */
+        void add_records(uint64_t thread, const std::vector<record_t>& records) {
+            bool has_values = false; // The last record is a call followed by VALUES records.
+            for (size_t i = 0; i < records.size(); i++) {
+                const record_t& record = records[i];
+
+                if (record.type == VALUES) {
+                    if (has_values) {
+                        calls.back().values.push_back({record.value1, record.flags & VALUE1_IN_POSET});
+                        if (record.argument == 2) {
+                            calls.back().values.push_back({record.value2, record.flags & VALUE2_IN_POSET});
+                        }
+                    }
+                    continue;
+                }
+                has_values = record.type == POSET_REMOVE_MANY;
+
+                if (record.type == STRING) {
+                    std::string value;
+                    for (size_t j = i + 1; j < records.size() && records[j].type == STRING_DATA &&
+                                           value.size() < record.result; j++, i++) {
+                        const char* payload = reinterpret_cast<const char*>(&records[j]) + offsetof(record_t, poset);
+                        value.append(payload, std::min<uint64_t>(STRING_PAYLOAD, record.result - value.size()));
+                    }
+                    if (record.result < record.argument) {
+                        value += "...";
+                    }
+                    strings[record.value1] = value;
+                } else if (record.type > STRING_DATA && record.type < TYPE_COUNT) {
+                    calls.push_back({thread, record, {}});
+                }
+            }
+        }
+
+        // Same as 'char_pointer_to_string' in poset.cc.
+        std::string quoted(uint64_t id) const {
+            if (id == 0) {
+                return "NULL";
+            }
+            auto it = strings.find(id);
+            if (it == strings.end()) {
+                return "<unknown string " + std::to_string(id & ~INLINE_STRING) + ">";
+            }
+            return "\"" + it->second + "\"";
+        }
+
+        std::vector<std::string> messages(const call_t& call) const {
+            const record_t& r = call.record;
+            const std::string name = FUNCTION_NAMES[r.type];
+            const std::string poset = std::to_string(r.poset);
+            const bool exists = r.flags & POSET_EXISTS, read_only = r.flags & POSET_READ_ONLY;
+            const std::string does_not_exist = name + ": poset " + poset +
+                                               (read_only ? " is read-only" : " does not exist");
+            const std::string v1 = quoted(r.value1), v2 = quoted(r.value2);
+            const std::string result = std::to_string(r.result);
+
+            std::vector<std::string> lines;
+            auto add = [&lines](const std::string& line) {
+                lines.push_back(line);
+            };
+
+            switch (r.type) {
+                case POSET_NEW:
+                    add("poset_new()");
+                    add("poset_new: poset " + result + " created");
+                    break;
+
+                case POSET_DELETE:
+                case POSET_CLEAR:
+                    add(name + "(" + poset + ")");
+                    if (exists || (read_only && r.type == POSET_DELETE)) {
+                        add(name + ": poset " + poset + (r.type == POSET_DELETE ? " deleted" : " cleared"));
+                    } else {
+                        add(does_not_exist);
+                    }
+                    break;
+
+                case POSET_SIZE:
+                    add("poset_size(" + poset + ")");
+                    if (exists || read_only) {
+                        add("poset_size: poset " + poset + " contains " + result + " element(s)");
+                    } else {
+                        add("poset_size: poset " + poset + " does not exist");
+                    }
+                    break;
+
+                case POSET_INSERT:
+                    add("poset_insert(" + poset + ", " + v1 + ")");
+                    if (r.value1 == 0) {
+                        add("poset_insert: invalid value (NULL)");
+                    } else if (!exists) {
+                        add(does_not_exist);
+                    } else {
+                        add("poset_insert: poset " + poset + ", element " + v1 +
+                            (r.result ? " inserted" : " already exists"));
+                    }
+                    break;
+
+                case POSET_REMOVE:
+                case POSET_LOWER_SET:
+                case POSET_UPPER_SET: {
+                    add(name + "(" + poset + ", " + v1 + ")");
+                    bool accepted = r.type == POSET_REMOVE ? exists : exists || read_only;
+                    if (r.value1 == 0) {
+                        add(name + ": invalid value (NULL)");
+                    }
+                    // Only poset_remove reports both problems.
+                    if (!accepted && (r.value1 != 0 || r.type == POSET_REMOVE)) {
+                        add(does_not_exist);
+                    }
+                    if (!accepted || r.value1 == 0) {
+                        break;
+                    }
+
+                    if (!(r.flags & VALUE1_IN_POSET)) {
+                        add(name + ": poset " + poset + ", element " + v1 + " does not exist");
+                    } else if (r.type == POSET_REMOVE) {
+                        add(name + ": poset " + poset + ", element " + v1 + " removed");
+                    } else {
+                        add(name + ": poset " + poset + ", " + result + " element(s) " +
+                            (r.type == POSET_LOWER_SET ? "below " : "above ") + v1);
+                    }
+                    break;
+                }
+
+                case POSET_REMOVE_MANY:
+                    add("poset_remove_many(" + poset + ", " + std::to_string(r.argument) + " value(s))");
+                    if (!exists) {
+                        add(does_not_exist);
+                        break;
+                    }
+                    if (r.flags & NULL_VALUES) {
+                        add("poset_remove_many: invalid values (NULL)");
+                        break;
+                    }
+
+                    for (auto& [value, in_poset] : call.values) {
+                        if (!in_poset) {
+                            add("poset_remove_many: poset " + poset + ", element " + quoted(value) + " does not exist");
+                        }
+                    }
+                    if (r.argument > call.values.size()) {
+                        add("poset_remove_many: poset " + poset + ", " + std::to_string(r.argument - call.values.size()) +
+                            " value(s) not traced");
+                    }
+                    add("poset_remove_many: poset " + poset + ", " + result + " element(s) removed");
+                    break;
+
+                case POSET_TEST_MANY:
+                    add("poset_test_many(" + poset + ", " + std::to_string(r.argument) + " pair(s))");
+                    if (!exists && !read_only) {
+                        add(does_not_exist);
+                    } else {
+                        add("poset_test_many: poset " + poset + ", " + result + " of " +
+                            std::to_string(r.argument) + " relation(s) exist");
+                    }
+                    break;
+
+                case POSET_ADD:
+                case POSET_DEL:
+                case POSET_TEST: {
+                    add(name + "(" + poset + ", " + v1 + ", " + v2 + ")");
+                    if (r.value1 == 0) {
+                        add(name + ": invalid value1 (NULL)");
+                    }
+                    if (r.value2 == 0) {
+                        add(name + ": invalid value2 (NULL)");
+                    }
+
+                    bool accepted = exists || (read_only && r.type == POSET_TEST);
+                    if (!accepted) {
+                        add(does_not_exist);
+                    }
+                    if (!accepted || r.value1 == 0 || r.value2 == 0) {
+                        break;
+                    }
+
+                    std::string relation = name + ": poset " + poset + ", relation (" + v1 + ", " + v2 + ") ";
+                    if (!(r.flags & VALUE1_IN_POSET)) {
+                        add(name + ": poset " + poset + ", element " + v1 + " does not exist");
+                    } else if (!(r.flags & VALUE2_IN_POSET)) {
+                        add(name + ": poset " + poset + ", element " + v2 + " does not exist");
+                    } else if (r.type == POSET_TEST) {
+                        add(relation + (r.result ? "exists" : "does not exist"));
+                    } else if (r.type == POSET_ADD) {
+                        add(relation + (r.result ? "added" : "cannot be added"));
+                    } else {
+                        add(relation + (r.result ? "deleted" : "cannot be deleted"));
+                    }
+                    break;
+                }
+
+                case POSET_CLONE:
+                    add("poset_clone(" + poset + ")");
+                    if (exists || read_only) {
+                        add("poset_clone: poset " + result + " cloned from poset " + poset);
+                    } else {
+                        add(does_not_exist);
+                    }
+                    break;
+
+                case POSET_MEMORY_USAGE:
+                    add("poset_memory_usage(" + poset + ")");
+                    if (exists || read_only) {
+                        add("poset_memory_usage: poset " + poset + " uses " + result + " byte(s)");
+                    } else {
+                        add("poset_memory_usage: poset " + poset + " does not exist");
+                    }
+                    break;
+
+                case POSET_TOTAL_MEMORY_USAGE:
+                    add("poset_total_memory_usage()");
+                    add("poset_total_memory_usage: posets use " + result + " byte(s)");
+                    break;
+
+                case POSET_MERGE: {
+                    std::string other = std::to_string(r.argument);
+                    add("poset_merge(" + poset + ", " + other + ")");
+                    if (!exists) {
+                        add(does_not_exist);
+                    }
+                    if (!(r.flags & OTHER_POSET_EXISTS)) {
+                        add("poset_merge: poset " + other + " does not exist");
+                    }
+                    if (exists && (r.flags & OTHER_POSET_EXISTS)) {
+                        add("poset_merge: poset " + other + " merged into poset " + poset + ", " +
+                            result + " relation(s) rejected");
+                    }
+                    break;
+                }
+
+                case POSET_MINIMAL:
+                case POSET_MAXIMAL:
+                    add(name + "(" + poset + ")");
+                    if (exists || read_only) {
+                        add(name + ": poset " + poset + " has " + result + " " +
+                            (r.type == POSET_MINIMAL ? "minimal" : "maximal") + " element(s)");
+                    } else {
+                        add(does_not_exist);
+                    }
+                    break;
+
+                case POSET_SET_LABELING: {
+                    std::string dimensions = std::to_string(r.argument);
+                    add("poset_set_labeling(" + poset + ", " + dimensions + ")");
+                    if (exists) {
+                        add("poset_set_labeling: poset " + poset + ", labels with " + dimensions +
+                            " dimension(s) " + (r.argument == 0 ? "disabled" : "enabled"));
+                    } else {
+                        add(does_not_exist);
+                    }
+                    break;
+                }
+
+                case POSET_SAVE:
+                    add("poset_save(" + poset + ", " + v1 + ", " + (r.argument ? "true" : "false") + ")");
+                    if (r.value1 == 0) {
+                        add("poset_save: invalid path (NULL)");
+                    } else if (!exists && !read_only) {
+                        add(does_not_exist);
+                    } else {
+                        add("poset_save: poset " + poset + (r.result ? " saved to " : " cannot be saved to ") + v1);
+                    }
+                    break;
+
+                case POSET_LOAD:
+                case POSET_OPEN: {
+                    add(name + "(" + v1 + ")");
+                    bool load = r.type == POSET_LOAD;
+                    if (r.result == uint64_t(-1)) {
+                        add(name + (load ? ": cannot load a poset from " : ": cannot open a poset from ") + v1);
+                    } else {
+                        add(name + ": poset " + result + (load ? " loaded from " : " opened read-only from ") + v1);
+                    }
+                    break;
+                }
+            }
+
+            return lines;
+        }
+
+        std::unordered_map<uint64_t, std::string> strings;
+        std::vector<call_t> calls;
+    };
+}
+
+int main(int argc, char* argv[]) {
+    bool with_timing = argc == 3 && std::strcmp(argv[1], "-t") == 0;
+    if (argc != 2 && !with_timing) {
+        std::cerr << "usage: " << argv[0] << " [-t] trace.bin" << std::endl;
+        return 2;
+    }
+
+    std::ifstream in(argv[argc - 1], std::ios::binary);
+    trace_t trace;
+    if (!in || !trace.read(in)) {
+        std::cerr << argv[argc - 1] << ": not a poset trace" << std::endl;
+        return 1;
+    }
+
+    trace.print(std::cout, with_timing);
+}
@@ -0,0 +1,320 @@
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include "crossword_fill.h"
+
+// Dictionary implementation:
+
+Dictionary::Dictionary(const std::vector<std::string>& dictionary_words) {
+	std::unordered_set<std::string> seen;
+	for (std::string word : dictionary_words) {
+		if (word.empty() || !std::all_of(word.begin(), word.end(), [](char c) { return isalpha(c); }))
+			continue;
+		std::transform(word.begin(), word.end(), word.begin(), ::toupper);
+		if (seen.insert(word).second)
+			words.push_back(std::move(word));
+	}
+
+	for (size_t i = 0; i < words.size(); i++) {
+		if (words[i].size() >= by_length.size())
+			by_length.resize(words[i].size() + 1);
+		by_length[words[i].size()].words.push_back(i);
+	}
+
+	for (size_t length = 1; length < by_length.size(); length++) {
+		LengthIndex& index = by_length[length];
+		index.blocks = (index.words.size() + 64 * CHUNK_BLOCKS - 1) / (64 * CHUNK_BLOCKS) * CHUNK_BLOCKS;
+		index.all.assign(index.blocks, 0);
+		index.bits.assign(length * LETTERS * index.blocks, 0);
+
+		for (size_t k = 0; k < index.words.size(); k++) {
+			uint64_t bit = uint64_t(1) << (k % 64);
+			index.all[k / 64] |= bit;
+			const std::string& word = words[index.words[k]];
+			for (size_t p = 0; p < length; p++)
+				index.bits[(p * LETTERS + (word[p] - 'A')) * index.blocks + k / 64] |= bit;
+		}
+	}
+}
+
+size_t Dictionary::count_matching(std::string_view pattern) const {
+	size_t count = 0;
+	for_each_chunk(pattern, [&count](const LengthIndex&, size_t, const uint64_t* chunk) {
+		for (size_t b = 0; b < CHUNK_BLOCKS; b++)
+			count += std::popcount(chunk[b]);
+		return true;
+	});
+	return count;
+}
+
+// Filling:
+
+namespace {
+	constexpr size_t NO_WORD = SIZE_MAX;
+	// Words for the slots filled at the first that many levels of the search are handed to idle threads as tasks.
+	constexpr size_t FILL_SPLIT_DEPTH = 4;
+
+	struct Crossing {
+		size_t position;
+		size_t other;
+		size_t other_position;
+	};
+
+	// The words chosen for the slots, NO_WORD for the empty ones.
+	using Filling = std::vector<size_t>;
+
+	class FillSearch {
+		public:
+			FillSearch(const Dictionary& dictionary, std::vector<std::string> patterns,
+					std::vector<std::vector<Crossing>> crossings) :
+				dictionary(dictionary), patterns(std::move(patterns)), crossings(std::move(crossings)) {}
+
+			std::optional<Filling> run(unsigned threads) {
+				Filling filling(patterns.size(), NO_WORD);
+				if (threads == 1) {
+					extend(filling, 0, nullptr);
+					return result;
+				}
+
+				queues = std::vector<TaskQueue>(threads);
+				push(0, std::move(filling));
+				std::vector<std::thread> workers;
+				for (size_t t = 1; t < threads; t++) {
+					workers.emplace_back([this, t]() { work(t); });
+				}
+				work(0);
+				for (std::thread& worker : workers) {
+					worker.join();
+				}
+				return result;
+			}
+
+		private:
+			// Fillings to extend, taken by the owner from the back and by the other threads from the front.
+			struct TaskQueue {
+				std::mutex mutex;
+				std::deque<Filling> tasks;
+			};
+
+			// The pattern of the slot with the letters of the filled crossing slots.
+			std::string pattern_of(const Filling& filling, size_t slot) const {
+				std::string pattern = patterns[slot];
+				for (const Crossing& c : crossings[slot]) {
+					if (filling[c.other] != NO_WORD)
+						pattern[c.position] = dictionary.word(filling[c.other])[c.other_position];
+				}
+				return pattern;
+			}
+
+			// Fills the emptiest slot with every fitting word in turn. True once a complete filling is found.
+			bool extend(Filling& filling, size_t depth, TaskQueue* queue) {
+				if (found.load(std::memory_order_relaxed))
+					return false;
+
+				size_t slot = NO_WORD, fewest = SIZE_MAX;
+				for (size_t s = 0; s < filling.size(); s++) {
+					if (filling[s] != NO_WORD)
+						continue;
+					size_t count = dictionary.count_matching(pattern_of(filling, s));
+					if (count == 0)
+						return false;
+					if (count < fewest) {
+						slot = s;
+						fewest = count;
+					}
+				}
+				if (slot == NO_WORD) {
+					{
+						std::lock_guard<std::mutex> lock(result_mutex);
+						if (!found.exchange(true))
+							result = filling;
+					}
+					wake_workers(true);
+					return true;
+				}
+
+				bool complete = false;
+				dictionary.for_each_matching(pattern_of(filling, slot), [&](size_t word) {
+					if (std::find(filling.begin(), filling.end(), word) != filling.end())
+						return true;
+
+					filling[slot] = word;
+					if (crossings_fit(filling, slot)) {
+						if (queue != nullptr && depth < FILL_SPLIT_DEPTH && idle.load(std::memory_order_relaxed) > 0)
+							push(queue - queues.data(), filling);
+						else
+							complete = extend(filling, depth + 1, queue);
+					}
+					filling[slot] = NO_WORD;
+					return !complete && !found.load(std::memory_order_relaxed);
+				});
+				return complete;
+			}
+
+			// Whether every empty slot crossing the slot still has a matching word.
+			bool crossings_fit(const Filling& filling, size_t slot) const {
+				for (const Crossing& c : crossings[slot]) {
+					if (filling[c.other] == NO_WORD && dictionary.count_matching(pattern_of(filling, c.other)) == 0)
+						return false;
+				}
+				return true;
+			}
+
+			void push(size_t worker, Filling filling) {
+				pending++;
+				{
+					std::lock_guard<std::mutex> lock(queues[worker].mutex);
+					queues[worker].tasks.push_back(std::move(filling));
+				}
+				queued++;
+				wake_workers(false);
+			}
+
+			// Taking the mutex orders the change before the check of a worker about to wait.
+			void wake_workers(bool all) {
+				{ std::lock_guard<std::mutex> lock(wake_mutex); }
+				if (all)
+					wake.notify_all();
+				else
+					wake.notify_one();
+			}
+
+			std::optional<Filling> take(size_t worker) {
+				for (size_t k = 0; k < queues.size(); k++) {
+					TaskQueue& queue = queues[(worker + k) % queues.size()];
+					std::lock_guard<std::mutex> lock(queue.mutex);
+					if (queue.tasks.empty())
+						continue;
+
+					Filling filling;
+					if (k == 0) {
+						filling = std::move(queue.tasks.back());
+						queue.tasks.pop_back();
+					} else {
+						filling = std::move(queue.tasks.front());
+						queue.tasks.pop_front();
+					}
+					queued--;
+					return filling;
+				}
+				return {};
+			}
+
+			/*
+			 * Runs tasks until a filling is found or there are no tasks left, including the running ones.
+			 * Idle threads wait until a task is pushed, the last one ends or a filling is found.
+			 */
+			void work(size_t worker) {
+				bool waiting = false;
+				while (!found.load()) {
+					std::optional<Filling> filling = take(worker);
+					if (!filling.has_value()) {
+						if (pending.load() == 0)
+							break;
+						if (!waiting)
+							idle++;
+						waiting = true;
+						std::unique_lock<std::mutex> lock(wake_mutex);
+						wake.wait(lock, [this]() { return found.load() || pending.load() == 0 || queued.load() > 0; });
+						continue;
+					}
+					if (waiting)
+						idle--;
+					waiting = false;
+
+					size_t depth = filling->size() - std::count(filling->begin(), filling->end(), NO_WORD);
+					extend(*filling, depth, &queues[worker]);
+					if (--pending == 0)
+						wake_workers(true);
+				}
+				if (waiting)
+					idle--;
+			}
+
+			const Dictionary& dictionary;
+			std::vector<std::string> patterns;
+			std::vector<std::vector<Crossing>> crossings;
+
+			std::vector<TaskQueue> queues;
+			std::atomic<size_t> pending{0};
+			// Tasks in the queues, unlike 'pending' without the running ones.
+			std::atomic<size_t> queued{0};
+			std::mutex wake_mutex;
+			std::condition_variable wake;
+			std::atomic<unsigned> idle{0};
+			std::atomic<bool> found{false};
+			std::mutex result_mutex;
+			std::optional<Filling> result;
+	};
+
+	Word with_content(const Word& slot, std::string content) {
+		pos_t start = slot.get_start_position();
+		return Word(start.first, start.second, slot.get_orientation(), std::move(content));
+	}
+}
+
+std::optional<Crossword> fill(const std::vector<Word>& slots, const Dictionary& dictionary, unsigned threads) {
+	if (slots.empty())
+		return {};
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	// Whether words fit together doesn't depend on their letters, except on the crossings. So if the slots
+	// with the same letter everywhere form a crossword, any filling that agrees on the crossings does too.
+	Crossword layout(with_content(slots[0], std::string(slots[0].length(), 'A')), {});
+	for (size_t s = 1; s < slots.size(); s++) {
+		if (!layout.insert_word(with_content(slots[s], std::string(slots[s].length(), 'A'))))
+			return {};
+	}
+
+	std::vector<std::string> patterns(slots.size());
+	std::map<pos_t, std::vector<std::pair<size_t, size_t>>> cells;
+	for (size_t s = 0; s < slots.size(); s++) {
+		for (size_t i = 0; i < slots[s].length(); i++) {
+			char letter = slots[s].at(i);
+			patterns[s] += isalpha(letter) ? letter : DEFAULT_CHAR;
+			pos_t pos = slots[s].get_orientation() == H
+				? pos_t{slots[s].get_start_position().first + i, slots[s].get_start_position().second}
+				: pos_t{slots[s].get_start_position().first, slots[s].get_start_position().second + i};
+			cells[pos].emplace_back(s, i);
+		}
+	}
+
+	// Only an H and a V slot can share a cell; slots starting at the same position pass the layout check.
+	// Letters given in one of the crossing slots are given in both.
+	std::vector<std::vector<Crossing>> crossings(slots.size());
+	for (auto const& [pos, in_slots] : cells) {
+		if (in_slots.size() < 2)
+			continue;
+
+		auto [s1, p1] = in_slots[0];
+		auto [s2, p2] = in_slots[1];
+		if (in_slots.size() > 2 || slots[s1].get_orientation() == slots[s2].get_orientation())
+			return {};
+		char& letter1 = patterns[s1][p1];
+		char& letter2 = patterns[s2][p2];
+		if (letter1 == DEFAULT_CHAR)
+			letter1 = letter2;
+		else if (letter2 == DEFAULT_CHAR)
+			letter2 = letter1;
+		else if (letter1 != letter2)
+			return {};
+		crossings[s1].push_back({p1, s2, p2});
+		crossings[s2].push_back({p2, s1, p1});
+	}
+
+	std::optional<Filling> filling = FillSearch(dictionary, std::move(patterns), std::move(crossings)).run(threads);
+	if (!filling.has_value())
+		return {};
+
+	Crossword result(with_content(slots[0], dictionary.word((*filling)[0])), {});
+	for (size_t s = 1; s < slots.size(); s++) {
+		if (!result.insert_word(with_content(slots[s], dictionary.word((*filling)[s]))))
+			return {};
+	}
+	return result;
+}
@@ -0,0 +1,110 @@
+#ifndef CROSSWORD_FILL_H
+#define CROSSWORD_FILL_H
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "crosswords.h"
+
+/*
+ * Words of a dictionary indexed for pattern queries. For every length, position and letter there's
+ * a bitset of the words of that length with the letter at the position, so a pattern like "??A?E"
+ * is answered by intersecting a bitset per known letter, a chunk of blocks at a time.
+ */
+class Dictionary {
+	public:
+		// Keeps the words made only of letters, in upper case and without repetitions, in the given order.
+		explicit Dictionary(const std::vector<std::string>& words);
+
+		inline size_t size() const {
+			return words.size();
+		}
+		inline const std::string& word(size_t index) const {
+			return words[index];
+		}
+
+		// The number of words matching the pattern, in which every character other than a letter matches any letter.
+		size_t count_matching(std::string_view pattern) const;
+
+		// Calls f(index) for the words matching the pattern in the order of the dictionary, while f returns true.
+		template<typename F>
+		void for_each_matching(std::string_view pattern, F&& f) const {
+			for_each_chunk(pattern, [&](const LengthIndex& index, size_t first_block, const uint64_t* chunk) {
+				for (size_t b = 0; b < CHUNK_BLOCKS; b++) {
+					for (uint64_t bits = chunk[b]; bits != 0; bits &= bits - 1) {
+						if (!f(index.words[(first_block + b) * 64 + std::countr_zero(bits)]))
+							return false;
+					}
+				}
+				return true;
+			});
+		}
+
+	private:
+		static constexpr size_t LETTERS = 26;
+		// Blocks of 64 words intersected together; bitsets are padded to a multiple of that.
+		static constexpr size_t CHUNK_BLOCKS = 8;
+
+		/*
+		 * Bitsets of the words of a single length, by position, then letter, then block ('all' has every word).
+		 * 'blocks' is a multiple of CHUNK_BLOCKS.
+		 */
+		struct LengthIndex {
+			std::vector<size_t> words;
+			size_t blocks = 0;
+			std::vector<uint64_t> all;
+			std::vector<uint64_t> bits;
+
+			inline const uint64_t* bitset(size_t position, char letter) const {
+				return &bits[(position * LETTERS + (letter - 'A')) * blocks];
+			}
+		};
+
+		/*
+		 * Calls f(index, first_block, chunk) with the CHUNK_BLOCKS blocks of matching words
+		 * from 'first_block' on, while f returns true.
+		 */
+		template<typename F>
+		void for_each_chunk(std::string_view pattern, F&& f) const {
+			if (pattern.size() >= by_length.size() || by_length[pattern.size()].words.empty())
+				return;
+
+			const LengthIndex& index = by_length[pattern.size()];
+			uint64_t chunk[CHUNK_BLOCKS];
+			for (size_t first = 0; first < index.blocks; first += CHUNK_BLOCKS) {
+				std::copy_n(&index.all[first], CHUNK_BLOCKS, chunk);
+				for (size_t p = 0; p < pattern.size(); p++) {
+					char letter = (char) toupper((unsigned char) pattern[p]);
+					if (letter < 'A' || letter > 'Z')
+						continue;
+					const uint64_t* bits = index.bitset(p, letter) + first;
+					for (size_t b = 0; b < CHUNK_BLOCKS; b++)
+						chunk[b] &= bits[b];
+				}
+				if (!f(index, first, chunk))
+					return;
+			}
+		}
+
+		std::vector<std::string> words;
+		std::vector<LengthIndex> by_length;
+};
+
+/*
+ * Fills the slots (words whose characters other than letters are to be chosen) with distinct words
+ * of the dictionary that agree on the crossings, and returns the crossword of them. Nothing if there's
+ * no such filling, or if the slots can't be words of one crossword whatever their letters.
+ *
+ * The search fills the slot with the fewest matching words first and skips the words that leave a crossing
+ * slot without any. Its first levels are split into tasks run by up to 'threads' threads (all hardware
+ * threads with 0), which take tasks from each other when they run out. With a single thread
+ * the filling is the first one in the order of the dictionary, otherwise it may be any.
+ */
+std::optional<Crossword> fill(const std::vector<Word>& slots, const Dictionary& dictionary, unsigned threads = 0);
+
+#endif
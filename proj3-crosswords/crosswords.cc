@@ -2,67 +2,85 @@
 #include <algorithm>
 #include <compare>
 #include <vector>
+#include <atomic>
+#include <barrier>
 #include <cctype>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "crosswords.h"
 
-#define FIND_CLOSEST_WORD_AND_RETURN(word_set, to) { \
-		auto it = (word_set)->upper_bound(&to); \
-		if (it != (word_set)->begin()) \
-			it--; \
-		if (it == (word_set)->end()) \
-			return {}; \
-		return *it; \
+namespace {
+	// The area that a crossword without words has.
+	template<typename Cord>
+	BasicRectArea<Cord> empty_area() {
+		return BasicRectArea<Cord>({1, 1}, {0, 0});
 	}
+}
 
-const RectArea DEFAULT_EMPTY_RECT_AREA = RectArea({1, 1}, {0, 0});
+const RectArea DEFAULT_EMPTY_RECT_AREA = empty_area<cord_t>();
 char CROSSWORD_BACKGROUND = '.';
 
 // Word implementation:
 
-Word::Word(size_t x, size_t y, orientation_t wordOrientation, std::string&& wordContent) :
+template<typename Cord>
+BasicWord<Cord>::BasicWord(cord_t x, cord_t y, orientation_t wordOrientation, std::string&& wordContent) :
         wordStart({x, y}), orientation(wordOrientation), content(wordContent) {
     construct(x, y);
 }
 
-Word::Word(size_t x, size_t y, orientation_t wordOrientation, std::string& wordContent) :
+template<typename Cord>
+BasicWord<Cord>::BasicWord(cord_t x, cord_t y, orientation_t wordOrientation, std::string& wordContent) :
         wordStart({x, y}), orientation(wordOrientation), content(wordContent) {
     construct(x, y);
 }
 
-Word::Word(const Word& word):
+template<typename Cord>
+BasicWord<Cord>::BasicWord(const Word& word):
 	wordStart(word.wordStart),
 	orientation(word.orientation),
 	content(word.content) {}
 
-Word::Word(Word&& word):
+template<typename Cord>
+BasicWord<Cord>::BasicWord(Word&& word) noexcept:
 	wordStart(std::move(word.wordStart)),
 	orientation(std::move(word.orientation)),
 	content(std::move(word.content)) {}
 
-Word& Word::operator=(const Word& word) {
+template<typename Cord>
+BasicWord<Cord>& BasicWord<Cord>::operator=(const Word& word) {
 	wordStart = word.wordStart;
 	orientation = word.orientation;
 	content = word.content;
 	return *this;
 }
 
-Word& Word::operator=(Word&& word) {
+template<typename Cord>
+BasicWord<Cord>& BasicWord<Cord>::operator=(Word&& word) noexcept {
 	wordStart = std::move(word.wordStart);
 	orientation = std::move(word.orientation);
 	content = std::move(word.content);
 	return *this;
 }
 
-pos_t Word::get_end_position() const {
+template<typename Cord>
+typename BasicWord<Cord>::pos_t BasicWord<Cord>::get_end_position() const {
 	return pos_of_letter(content.size() - 1);
 }
 
-char Word::at(size_t pos) const {
+template<typename Cord>
+char BasicWord<Cord>::at(size_t pos) const {
 	if (pos >= content.size()) return DEFAULT_CHAR;
 	return content[pos];
 }
 
-std::weak_ordering Word::operator<=>(const Word& word) const {
+template<typename Cord>
+std::weak_ordering BasicWord<Cord>::operator<=>(const Word& word) const {
 	if (wordStart.first == word.wordStart.first) {
 		if (wordStart.second == word.wordStart.second) {
 			if (orientation == word.orientation) {
@@ -80,19 +98,23 @@ std::weak_ordering Word::operator<=>(const Word& word) const {
 	}
 }
 
-bool Word::operator==(const Word& word) const {
+template<typename Cord>
+bool BasicWord<Cord>::operator==(const Word& word) const {
 	return ((*this <=> word) == std::weak_ordering::equivalent);
 }
 
-bool Word::operator!=(const Word& word) const {
+template<typename Cord>
+bool BasicWord<Cord>::operator!=(const Word& word) const {
 	return !(*this == word);
 }
 
-RectArea Word::rect_area() const {
+template<typename Cord>
+BasicRectArea<Cord> BasicWord<Cord>::rect_area() const {
 	return RectArea(get_start_position(), get_end_position());
 }
 
-std::optional<char> Word::at(pos_t pos) const {
+template<typename Cord>
+std::optional<char> BasicWord<Cord>::at(pos_t pos) const {
 	if (wordStart <= pos && pos <= get_end_position()) {
 		if (orientation == H && pos.second == wordStart.second) {
 			return content[pos.first - wordStart.first];
@@ -104,7 +126,8 @@ std::optional<char> Word::at(pos_t pos) const {
 	return {};
 }
 
-pos_t Word::pos_of_letter(size_t offset) const {
+template<typename Cord>
+typename BasicWord<Cord>::pos_t BasicWord<Cord>::pos_of_letter(size_t offset) const {
 	// offset - the position of the letter in the word
 	if (orientation == H) {
 		return {wordStart.first + offset, wordStart.second};
@@ -113,7 +136,8 @@ pos_t Word::pos_of_letter(size_t offset) const {
 	}
 }
 
-void Word::construct(size_t x, size_t y) {
+template<typename Cord>
+void BasicWord<Cord>::construct(cord_t x, cord_t y) {
     if (content.empty()) {
         content = DEFAULT_WORD;
     } else {
@@ -132,7 +156,8 @@ void Word::construct(size_t x, size_t y) {
 
 // RectArea implementation:
 
-bool RectArea::pointInRect(pos_t point) const {
+template<typename Cord>
+bool BasicRectArea<Cord>::pointInRect(pos_t point) const {
 	return
 		point.first >= leftUpper.first &&
 		point.second >= leftUpper.second &&
@@ -140,7 +165,8 @@ bool RectArea::pointInRect(pos_t point) const {
 		point.second <= rightBottom.second;
 }
 
-bool RectArea::rectInRect(RectArea rectArea) const {
+template<typename Cord>
+bool BasicRectArea<Cord>::rectInRect(RectArea rectArea) const {
 	return
 		pointInRect(rectArea.get_left_top()) &&
 		pointInRect(rectArea.get_right_top()) &&
@@ -148,35 +174,42 @@ bool RectArea::rectInRect(RectArea rectArea) const {
 		pointInRect(rectArea.get_right_bottom());
 }
 
-RectArea::RectArea(pos_t left_top, pos_t right_bottom):
+template<typename Cord>
+BasicRectArea<Cord>::BasicRectArea(pos_t left_top, pos_t right_bottom):
 	leftUpper(left_top),
 	rightBottom(right_bottom) {}
 
-RectArea::RectArea(const RectArea& rectArea):
+template<typename Cord>
+BasicRectArea<Cord>::BasicRectArea(const RectArea& rectArea):
 	leftUpper(rectArea.leftUpper),
 	rightBottom(rectArea.rightBottom) {}
 
-RectArea::RectArea(RectArea&& rectArea):
+template<typename Cord>
+BasicRectArea<Cord>::BasicRectArea(RectArea&& rectArea):
 	leftUpper(std::move(rectArea.leftUpper)),
 	rightBottom(std::move(rectArea.rightBottom)) {}
 
-RectArea& RectArea::operator=(const RectArea& rectArea) {
+template<typename Cord>
+BasicRectArea<Cord>& BasicRectArea<Cord>::operator=(const RectArea& rectArea) {
 	leftUpper = rectArea.leftUpper;
 	rightBottom = rectArea.rightBottom;
 	return *this;
 }
 
-RectArea& RectArea::operator=(RectArea&& rectArea) {
+template<typename Cord>
+BasicRectArea<Cord>& BasicRectArea<Cord>::operator=(RectArea&& rectArea) {
 	leftUpper = std::move(rectArea.leftUpper);
 	rightBottom = std::move(rectArea.rightBottom);
 	return *this;
 }
 
-const RectArea RectArea::operator*(const RectArea& rectArea) const {
+template<typename Cord>
+const BasicRectArea<Cord> BasicRectArea<Cord>::operator*(const RectArea& rectArea) const {
 	return RectArea(*this) *= rectArea;
 }
 
-RectArea& RectArea::operator*=(const RectArea& rectArea) {
+template<typename Cord>
+BasicRectArea<Cord>& BasicRectArea<Cord>::operator*=(const RectArea& rectArea) {
 	if (empty()) {
 		return *this;
 	}
@@ -186,42 +219,23 @@ RectArea& RectArea::operator*=(const RectArea& rectArea) {
 		return *this;
 	}
 
-	if (rectInRect(rectArea)) {
-		set_left_top(rectArea.get_left_top());
-		set_right_bottom(rectArea.get_right_bottom());
-	}
-	else if (rectArea.rectInRect(*this)) {
-		set_left_top(get_left_top());
-		set_right_bottom(get_right_bottom());
-	}
-	// rectArea on right-bottom:
-	else if (pointInRect(rectArea.get_left_top())) {
-		set_left_top(rectArea.get_left_top());
-		set_right_bottom(get_right_bottom());
-	}
-	// rectArea on left-bottom:
-	else if (pointInRect(rectArea.get_right_top())) {
-		set_right_top(rectArea.get_right_top());
-		set_left_bottom(get_left_bottom());
-	}
-	// rectArea on left-top:
-	else if (pointInRect(rectArea.get_right_bottom())) {
-		set_left_top(get_left_top());
-		set_right_bottom(rectArea.get_right_bottom());
-	}
-	// rectArea on right-top:
-	else if (pointInRect(rectArea.get_left_bottom())) {
-		set_right_top(get_right_top());
-		set_left_bottom(rectArea.get_left_bottom());
-	} else {
-		set_left_top({1, 1});
-		set_right_bottom({0, 0});
+	// The rectangles are ordered sets of rows and columns, so the intersection is the overlap of both.
+	pos_t lt = {std::max(leftUpper.first, rectArea.leftUpper.first),
+				std::max(leftUpper.second, rectArea.leftUpper.second)};
+	pos_t rb = {std::min(rightBottom.first, rectArea.rightBottom.first),
+				std::min(rightBottom.second, rectArea.rightBottom.second)};
+	if (lt.first > rb.first || lt.second > rb.second) {
+		lt = {1, 1};
+		rb = {0, 0};
 	}
+	set_left_top(lt);
+	set_right_bottom(rb);
 
 	return *this;
 }
 
-dim_t RectArea::size() const {
+template<typename Cord>
+typename BasicRectArea<Cord>::dim_t BasicRectArea<Cord>::size() const {
 	if (empty()) return {0, 0};
 
 	size_t width = get_right_top().first - get_left_top().first + 1;
@@ -229,7 +243,8 @@ dim_t RectArea::size() const {
 	return {width, height};
 }
 
-void RectArea::embrace(pos_t point) {
+template<typename Cord>
+void BasicRectArea<Cord>::embrace(pos_t point) {
 	if (pointInRect(point)) return;
 
 	if (empty()) {
@@ -251,55 +266,355 @@ void RectArea::embrace(pos_t point) {
 	}
 }
 
-bool vertical_cmp::operator()(Word *w1, Word *w2) const {
-	return w1->get_start_position() < w2->get_start_position();
+// TileIndex implementation:
+
+template<typename Cord>
+size_t BasicTileIndex<Cord>::tile_hash::operator()(pos_t tile) const {
+	return std::hash<cord_t>()(tile.first * 0x9E3779B97F4A7C15ULL ^ tile.second);
 }
 
-bool horizontal_cmp::operator()(Word *w1, Word *w2) const {
-	pos_t p1 = w1->get_start_position();
-	pos_t p2 = w2->get_start_position();
-	std::swap(p1.first, p1.second);
-	std::swap(p2.first, p2.second);
-	return p1 < p2;
+template<typename Cord>
+std::optional<char> BasicTileIndex<Cord>::letter_at(pos_t pos) const {
+	auto it = tiles.find(tile_of(pos));
+	if (it == tiles.end())
+		return {};
+
+	size_t cell = cell_of(pos);
+	if (it->second->orientations[cell] == 0)
+		return {};
+	return it->second->letters[cell];
 }
 
-Crossword::Crossword(Word const& first, std::initializer_list<Word> other) :
-	h_words(),
-	v_words(),
-	words(),
-	area(DEFAULT_EMPTY_RECT_AREA) {
-		insert_word(first, false);
-		std::for_each(other.begin(), other.end(), [this](Word const& w){
-			this->insert_word(w);
+template<typename Cord>
+typename BasicTileIndex<Cord>::Tile& BasicTileIndex<Cord>::mutable_tile(pos_t tile_pos) {
+	std::shared_ptr<Tile>& tile = tiles.find(tile_pos)->second;
+	if (tile.use_count() > 1) {
+		tile = std::make_shared<Tile>(*tile);
+		ordered.find(tile_pos)->second = tile.get();
+	}
+	return *tile;
+}
+
+template<typename Cord>
+void BasicTileIndex<Cord>::create_tile(pos_t tile_pos) {
+	auto found = tiles.emplace(tile_pos, std::make_shared<Tile>()).first;
+	try {
+		auto in_order = ordered.emplace_hint(ordered.end(), tile_pos, found->second.get());
+		try {
+			tile_columns[tile_pos.first]++;
+		} catch (...) {
+			ordered.erase(in_order);
+			throw;
+		}
+	} catch (...) {
+		tiles.erase(found);
+		throw;
+	}
+}
+
+template<typename Cord>
+void BasicTileIndex<Cord>::prepare(const Word& w, std::vector<pos_t>* created) {
+	pos_t first = tile_of(w.get_start_position()), last = tile_of(w.get_end_position());
+	for (cord_t x = first.first; x <= last.first; x++) {
+		for (cord_t y = first.second; y <= last.second; y++) {
+			auto found = tiles.find({x, y});
+			if (found == tiles.end()) {
+				create_tile({x, y});
+				if (created != nullptr)
+					created->push_back({x, y});
+			}
+
+			std::vector<size_t>& words = mutable_tile({x, y}).words;
+			if (words.size() == words.capacity())
+				words.reserve(2 * words.size() + 1);
+		}
+	}
+
+	std::vector<std::pair<uint16_t, size_t>>& starts = tiles.find(first)->second->starts[w.get_orientation()];
+	if (starts.size() == starts.capacity())
+		starts.reserve(2 * starts.size() + 1);
+}
+
+template<typename Cord>
+void BasicTileIndex<Cord>::add(const Word& w) {
+	uint8_t bit = orientation_bit(w.get_orientation());
+	Tile* tile = nullptr;
+	pos_t tile_pos;
+
+	for (size_t i = 0; i < w.length(); i++) {
+		pos_t pos = w.pos_of_letter(i);
+		pos_t letter_tile = tile_of(pos);
+		if (tile == nullptr || letter_tile != tile_pos) {
+			// The tile exists and isn't shared (see prepare), so the map doesn't change.
+			tile = tiles.find(letter_tile)->second.get();
+			tile_pos = letter_tile;
+		}
+
+		size_t cell = cell_of(pos);
+		if (bit == orientation_bit(H) || !(tile->orientations[cell] & orientation_bit(H)))
+			tile->letters[cell] = w.at(i);
+		tile->orientations[cell] |= bit;
+	}
+}
+
+template<typename Cord>
+bool BasicTileIndex<Cord>::index_word(const Word& w, size_t index) {
+	pos_t first = tile_of(w.get_start_position()), last = tile_of(w.get_end_position());
+	for (cord_t x = first.first; x <= last.first; x++) {
+		for (cord_t y = first.second; y <= last.second; y++)
+			mutable_tile({x, y}).words.push_back(index);
+	}
+
+	pos_t start = w.get_start_position();
+	std::vector<std::pair<uint16_t, size_t>>& starts = mutable_tile(tile_of(start)).starts[w.get_orientation()];
+	uint16_t cell = cell_of(start);
+
+	auto it = std::lower_bound(starts.begin(), starts.end(), cell, [](const std::pair<uint16_t, size_t>& entry, uint16_t c) {
+		return entry.first < c;
+	});
+	if (it != starts.end() && it->first == cell)
+		return false;
+	starts.insert(it, {cell, index});
+	start_counts[w.get_orientation()]++;
+	return true;
+}
+
+template<typename Cord>
+void BasicTileIndex<Cord>::remove_if_empty(pos_t tile_pos) {
+	auto found = tiles.find(tile_pos);
+	if (found == tiles.end())
+		return;
+
+	const uint8_t* orientations = found->second->orientations;
+	if (std::all_of(orientations, orientations + TILE_SIZE * TILE_SIZE, [](uint8_t o) { return o == 0; })) {
+		ordered.erase(tile_pos);
+		auto column = tile_columns.find(tile_pos.first);
+		if (--column->second == 0)
+			tile_columns.erase(column);
+		tiles.erase(found);
+	}
+}
+
+template<typename Cord>
+void BasicTileIndex<Cord>::remove_empty(const std::vector<pos_t>& tile_positions) {
+	for (pos_t tile_pos : tile_positions)
+		remove_if_empty(tile_pos);
+}
+
+template<typename Cord>
+bool BasicTileIndex<Cord>::append_tile(pos_t tile_pos) {
+	if (!ordered.empty() && !horizontal_cmp()(ordered.rbegin()->first, tile_pos))
+		return false;
+	create_tile(tile_pos);
+	return true;
+}
+
+template<typename Cord>
+void BasicTileIndex<Cord>::remove(const Word& w, size_t index, const std::function<const Word&(size_t)>& word_at) {
+	pos_t first = tile_of(w.get_start_position()), last = tile_of(w.get_end_position());
+	// Copying the shared tiles is all that may throw, so it comes before any change.
+	for (cord_t x = first.first; x <= last.first; x++) {
+		for (cord_t y = first.second; y <= last.second; y++)
+			mutable_tile({x, y});
+	}
+
+	std::vector<std::pair<uint16_t, size_t>>& starts = tiles.find(first)->second->starts[w.get_orientation()];
+	auto entry = std::find(starts.begin(), starts.end(), std::pair<uint16_t, size_t>(cell_of(w.get_start_position()), index));
+	if (entry != starts.end()) {
+		starts.erase(entry);
+		start_counts[w.get_orientation()]--;
+	}
+
+	for (size_t i = 0; i < w.length(); i++) {
+		pos_t pos = w.pos_of_letter(i);
+		tiles.find(tile_of(pos))->second->orientations[cell_of(pos)] = 0;
+	}
+
+	// The words left in the tiles put their letters back into the cells they share with the word.
+	for (cord_t x = first.first; x <= last.first; x++) {
+		for (cord_t y = first.second; y <= last.second; y++) {
+			Tile& tile = *tiles.find({x, y})->second;
+			tile.words.erase(std::find(tile.words.begin(), tile.words.end(), index));
+
+			RectArea cleared = w.rect_area() * RectArea({x * TILE_SIZE, y * TILE_SIZE},
+				{x * TILE_SIZE + (TILE_SIZE - 1), y * TILE_SIZE + (TILE_SIZE - 1)});
+			for (size_t other : tile.words) {
+				const Word& o = word_at(other);
+				RectArea common = o.rect_area() * cleared;
+				if (common.empty())
+					continue;
+
+				// Both words are lines, so the common cells are a part of o.
+				uint8_t bit = orientation_bit(o.get_orientation());
+				pos_t from = common.get_left_top(), o_start = o.get_start_position();
+				dim_t dims = common.size();
+				for (size_t i = 0; i < dims.first * dims.second; i++) {
+					pos_t pos = dims.first > 1 ? pos_t{from.first + i, from.second} : pos_t{from.first, from.second + i};
+					size_t cell = cell_of(pos);
+					if (bit == orientation_bit(H) || !(tile.orientations[cell] & orientation_bit(H)))
+						tile.letters[cell] = o.at((pos.first - o_start.first) + (pos.second - o_start.second));
+					tile.orientations[cell] |= bit;
+				}
+			}
+		}
+	}
+
+	for (cord_t x = first.first; x <= last.first; x++) {
+		for (cord_t y = first.second; y <= last.second; y++)
+			remove_if_empty({x, y});
+	}
+}
+
+template<typename Cord>
+BasicRectArea<Cord> BasicTileIndex<Cord>::bounds() const {
+	if (ordered.empty())
+		return empty_area<Cord>();
+
+	constexpr size_t CELLS = TILE_SIZE * TILE_SIZE;
+	auto has_letter = [](uint8_t o) { return o != 0; };
+	auto has_letter_in_column = [](const Tile& tile, size_t column) {
+		for (size_t cell = column; cell < CELLS; cell += TILE_SIZE) {
+			if (tile.orientations[cell] != 0)
+				return true;
+		}
+		return false;
+	};
+	// Calls f(tile) for the tiles of the row (H) or column (V) of tiles.
+	auto for_each_tile_of = [this](orientation_t ori, cord_t line, auto&& f) {
+		cord_t from = line * TILE_SIZE, to = from + (TILE_SIZE - 1);
+		RectArea tiles_area = ori == H ? RectArea({0, from}, {MAX_COORDINATE, to}) : RectArea({from, 0}, {to, MAX_COORDINATE});
+		for_each_tile_in(tiles_area, [&](pos_t tile_pos, const std::vector<size_t>&) {
+			f(*tiles.find(tile_pos)->second);
 		});
+	};
+
+	// Rows and columns of cells in the outermost tiles.
+	cord_t top_row = ordered.begin()->first.second, bottom_row = ordered.rbegin()->first.second;
+	cord_t left_column = tile_columns.begin()->first, right_column = tile_columns.rbegin()->first;
+	size_t top = TILE_SIZE - 1, bottom = 0, left = TILE_SIZE - 1, right = 0;
+
+	for_each_tile_of(H, top_row, [&](const Tile& tile) {
+		const uint8_t* o = tile.orientations;
+		top = std::min(top, size_t(std::find_if(o, o + CELLS, has_letter) - o) / TILE_SIZE);
+	});
+	for_each_tile_of(H, bottom_row, [&](const Tile& tile) {
+		const uint8_t* o = tile.orientations;
+		auto found = std::find_if(std::make_reverse_iterator(o + CELLS), std::make_reverse_iterator(o), has_letter);
+		bottom = std::max(bottom, size_t(found.base() - o - 1) / TILE_SIZE);
+	});
+	for_each_tile_of(V, left_column, [&](const Tile& tile) {
+		for (size_t column = 0; column < left; column++) {
+			if (has_letter_in_column(tile, column))
+				left = column;
+		}
+	});
+	for_each_tile_of(V, right_column, [&](const Tile& tile) {
+		for (size_t column = TILE_SIZE - 1; column > right; column--) {
+			if (has_letter_in_column(tile, column))
+				right = column;
+		}
+	});
+
+	return RectArea({left_column * TILE_SIZE + left, top_row * TILE_SIZE + top},
+		{right_column * TILE_SIZE + right, bottom_row * TILE_SIZE + bottom});
 }
 
-Crossword::Crossword(const Crossword& other) :
-	h_words(),
-	v_words(),
-	words(),
-	area(other.area) {
-	for (Word* w : other.words) {
-		insert_word(*w, false);
+template<typename Cord>
+std::vector<BasicWord<Cord>>& BasicCrossword<Cord>::WordStore::mutable_chunk(std::shared_ptr<std::vector<Word>>& chunk) {
+	if (chunk.use_count() > 1) {
+		auto copy = std::make_shared<std::vector<Word>>();
+		copy->reserve(CHUNK_WORDS);
+		copy->assign(chunk->begin(), chunk->end());
+		chunk = std::move(copy);
 	}
+	return *chunk;
+}
+
+template<typename Cord>
+std::vector<BasicWord<Cord>>& BasicCrossword<Cord>::WordStore::reserve_next() {
+	if (chunks.empty() || chunks.back()->size() == CHUNK_WORDS) {
+		auto chunk = std::make_shared<std::vector<Word>>();
+		chunk->reserve(CHUNK_WORDS);
+		chunks.push_back(std::move(chunk));
+	}
+	return mutable_chunk(chunks.back());
+}
+
+template<typename Cord>
+BasicWord<Cord>& BasicCrossword<Cord>::WordStore::mutable_word(size_t index) {
+	return mutable_chunk(chunks[index / CHUNK_WORDS])[index % CHUNK_WORDS];
+}
+
+template<typename Cord>
+void BasicCrossword<Cord>::WordStore::trim() {
+	while (!chunks.empty()) {
+		std::shared_ptr<std::vector<Word>>& chunk = chunks.back();
+		if (chunk->empty()) {
+			chunks.pop_back();
+		} else if (chunk.use_count() == 1 && chunk->back().length() == 0) {
+			chunk->pop_back();
+			size--;
+		} else {
+			break;
+		}
+	}
+}
+
+template<typename Cord>
+typename BasicCrossword<Cord>::WordStore& BasicCrossword<Cord>::mutable_store() {
+	if (store.use_count() > 1)
+		store = std::make_shared<WordStore>(*store);
+	return *store;
+}
+
+template<typename Cord>
+BasicTileIndex<Cord>& BasicCrossword<Cord>::mutable_cells() {
+	if (cells.use_count() > 1)
+		cells = std::make_shared<TileIndex>(*cells);
+	return *cells;
 }
 
-Crossword::Crossword(Crossword &&other) :
-	h_words(std::move(other.h_words)),
-	v_words(std::move(other.v_words)),
-	words(std::move(other.words)),
-	area(std::move(other.area))  {
-    other.words.clear();
-    other.h_words.clear();
-    other.v_words.clear();
-    other.area = DEFAULT_EMPTY_RECT_AREA;
+template<typename Cord>
+BasicCrossword<Cord>::BasicCrossword(Word const& first, std::initializer_list<Word> other) :
+	store(std::make_shared<WordStore>()),
+	cells(std::make_shared<TileIndex>()),
+	area(empty_area<Cord>()) {
+		insert_word(first, false);
+		std::for_each(other.begin(), other.end(), [this](Word const& w){
+			this->insert_word(w);
+		});
 }
 
-Crossword::~Crossword() {
-	delete_words();
+template<typename Cord>
+BasicCrossword<Cord>::BasicCrossword() :
+	store(std::make_shared<WordStore>()),
+	cells(std::make_shared<TileIndex>()),
+	area(empty_area<Cord>()) {}
+
+template<typename Cord>
+BasicCrossword<Cord>::BasicCrossword(const Crossword& other) :
+	store(other.store),
+	cells(other.cells),
+	area(other.area),
+	may_collide(other.may_collide) {}
+
+template<typename Cord>
+BasicCrossword<Cord>::BasicCrossword(Crossword &&other) :
+	store(std::move(other.store)),
+	cells(std::move(other.cells)),
+	area(std::move(other.area)),
+	may_collide(other.may_collide) {
+    other.store = std::make_shared<WordStore>();
+    other.cells = std::make_shared<TileIndex>();
+    other.area = empty_area<Cord>();
+    other.may_collide = false;
 }
 
-bool Crossword::does_collide(const Word &w) const {
+template<typename Cord>
+BasicCrossword<Cord>::~BasicCrossword() = default;
+
+template<typename Cord>
+bool BasicCrossword<Cord>::does_collide(const Word &w) const {
 	for (size_t i = 0; i < w.length(); i++) {
 		pos_t pos = w.pos_of_letter(i);
 		std::optional<char> letter = letter_at(pos);
@@ -386,117 +701,761 @@ bool Crossword::does_collide(const Word &w) const {
 	return false;
 }
 
-std::optional<char> Crossword::letter_at(pos_t pos) const {
-	auto extract_letter = [](pos_t pos, std::optional<const Word *>&& w) {
-			if (w.has_value()) {
-				std::optional<char> let = w.value()->at(pos);
-				if (let.has_value())
-					return let;
-			}
-			return std::optional<char>();
-		};
+template<typename Cord>
+bool BasicCrossword<Cord>::insert_word(const Word& w, bool check_collisions) {
+	if (check_collisions && does_collide(w))
+		return false;
 
-	std::optional<char> l = extract_letter(pos, closest_word(pos, H));
-	if (l.has_value())
-		return l;
-	return extract_letter(pos, closest_word(pos, V));
+	// Everything that may throw comes before the first change. w may be a word of this crossword,
+	// so it's copied before the store is unshared.
+	Word added(w);
+	mutable_store().reserve_next();
+	TileIndex& index = mutable_cells();
+	index.prepare(added);
+	index.add(added);
+	store_word(std::move(added));
+	may_collide |= !check_collisions && store->size > 1;
+	return true;
 }
 
-std::optional<const Word*> Crossword::closest_word(const pos_t &pos, orientation_t ori) const {
-	if ((ori == H && h_words.empty()) || (ori == V && v_words.empty()))
+template<typename Cord>
+std::optional<BasicWord<Cord>> BasicCrossword<Cord>::remove_word(pos_t start, orientation_t orientation) {
+	std::optional<size_t> found;
+	cells->for_each_tile_in(RectArea(start, start), [&](pos_t, const std::vector<size_t>& indices) {
+		for (size_t index : indices) {
+			const Word& w = (*store)[index];
+			if (w.get_start_position() == start && w.get_orientation() == orientation)
+				found = std::max(found.value_or(index), index);
+		}
+	});
+	if (!found.has_value())
 		return {};
 
-	Word tmp(pos.first, pos.second, ori, "");
-	if (ori == H) {
-		FIND_CLOSEST_WORD_AND_RETURN(&h_words, tmp);
-	} else {
-		FIND_CLOSEST_WORD_AND_RETURN(&v_words, tmp);
-	}
+	// Copying the shared parts is all that may throw, so it comes before any change.
+	WordStore& words = mutable_store();
+	Word& stored = words.mutable_word(*found);
+	mutable_cells().remove(stored, *found, [&words](size_t index) -> const Word& {
+		return words[index];
+	});
+
+	Word removed(std::move(stored));
+	stored.content.clear();
+	words.trim();
+
+	// Words sharing a cell with it may have been inserted only thanks to its letter there.
+	for (size_t i = 0; i < removed.length() && !may_collide; i++)
+		may_collide = cells->letter_at(removed.pos_of_letter(i)).has_value();
+
+	// The area can only shrink if the word was on its edge.
+	pos_t removed_start = removed.get_start_position(), removed_end = removed.get_end_position();
+	if (removed_start.first == area.get_left_top().first || removed_start.second == area.get_left_top().second
+			|| removed_end.first == area.get_right_bottom().first || removed_end.second == area.get_right_bottom().second)
+		area = cells->bounds();
+	return removed;
 }
 
-bool Crossword::insert_word(const Word& w, bool check_collisions) {
-	if (check_collisions && does_collide(w))
-		return false;
+// Stores a word whose letters are already added. Doesn't allocate if the store and the word are prepared.
+template<typename Cord>
+void BasicCrossword<Cord>::store_word(Word&& w) {
+	std::vector<Word>& chunk = mutable_store().reserve_next();
+	chunk.push_back(std::move(w));
+	const Word& added = chunk.back();
+	mutable_cells().index_word(added, store->size++);
 
-	Word *w_ptr = new Word(w);
-	words.push_back(w_ptr);
-	if (w_ptr->get_orientation() == H)
-		h_words.insert(w_ptr);
-	else
-		v_words.insert(w_ptr);
+	area.embrace(added.get_start_position());
+	area.embrace(added.get_end_position());
+}
 
-	area.embrace(w_ptr->get_start_position());
-	area.embrace(w_ptr->get_end_position());
-	return true;
+template<typename Cord>
+BasicCrossword<Cord> BasicCrossword<Cord>::operator+(const Crossword& b) const {
+	return Crossword(*this) += b;
 }
 
-void Crossword::delete_words() {
-    for (Word* w_ptr : words)
-        delete w_ptr;
-    words.clear();
-    v_words.clear();
-    h_words.clear();
+template<typename Cord>
+BasicCrossword<Cord>& BasicCrossword<Cord>::operator+=(const Crossword& b) {
+	return merge(b);
 }
 
-Crossword Crossword::operator+(const Crossword& b) const {
-	return Crossword(*this) += b;
+template<typename Cord>
+BasicCrossword<Cord>& BasicCrossword<Cord>::merge(const Crossword& b, unsigned threads) {
+	// The words of b stay the same even if b is this crossword, as they're inserted into a copy.
+	insert_all(*b.store, b.store->size, threads);
+	return *this;
+}
+
+template<typename Cord>
+std::vector<bool> BasicCrossword<Cord>::try_insert_many(std::span<const Word> words, unsigned threads) {
+	std::vector<char> inserted = insert_all(words, words.size(), threads);
+	return std::vector<bool>(inserted.begin(), inserted.end());
+}
+
+template<typename Cord>
+std::vector<BasicWord<Cord>> BasicCrossword<Cord>::words_in(const RectArea& area) const {
+	std::vector<Word> result;
+	cells->for_each_tile_in(area, [&](pos_t tile_pos, const std::vector<size_t>& indices) {
+		for (size_t index : indices) {
+			const Word& w = (*store)[index];
+			RectArea common = w.rect_area() * area;
+			// A word in several tiles of the area is found in the tile of its first letter in it.
+			if (!common.empty() && TileIndex::tile_of(common.get_left_top()) == tile_pos)
+				result.push_back(w);
+		}
+	});
+	return result;
+}
+
+template<typename Cord>
+std::vector<BasicWord<Cord>> BasicCrossword<Cord>::words_at_row(cord_t row) const {
+	return words_in(RectArea({0, row}, {MAX_COORDINATE, row}));
 }
 
-Crossword& Crossword::operator+=(const Crossword& b) {
-	for (const Word* w : b.words) {
-		insert_word(*w);
+template<typename Cord>
+std::vector<BasicWord<Cord>> BasicCrossword<Cord>::words_at_column(cord_t column) const {
+	return words_in(RectArea({column, 0}, {column, MAX_COORDINATE}));
+}
+
+template<typename Cord>
+template<typename Words>
+std::vector<char> BasicCrossword<Cord>::insert_all(const Words& words, size_t count, unsigned threads) {
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	// The words go into a copy sharing the storage, which replaces the crossword once they're all in,
+	// so a failure leaves it as it was. Words without letters were removed from a store and are skipped.
+	Crossword result(*this);
+	std::vector<char> accepted(count);
+	auto finish = [&]() {
+		store.swap(result.store);
+		cells.swap(result.cells);
+		area = result.area;
+		// Moved, as a copy could throw after the swaps.
+		return std::move(accepted);
+	};
+	auto sequential = [&]() {
+		for (size_t i = 0; i < count; i++) {
+			accepted[i] = words[i].length() > 0 && result.insert_word(words[i]);
+		}
+		return finish();
+	};
+	if (threads == 1 || count < PARALLEL_MERGE_MIN_WORDS)
+		return sequential();
+
+	// does_collide only reads the cells in the rectangle of the word grown by one, so a word can only
+	// be affected by the earlier words sharing a tile with that rectangle. Each word goes to the round
+	// after the last round of such words.
+	std::vector<size_t> round(count);
+	std::unordered_map<pos_t, size_t, typename TileIndex::tile_hash> next_round;
+	size_t rounds = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (words[i].length() == 0)
+			continue;
+		pos_t start = words[i].get_start_position(), end = words[i].get_end_position();
+		pos_t first = TileIndex::tile_of({start.first - (start.first > 0), start.second - (start.second > 0)});
+		pos_t last = TileIndex::tile_of({end.first + (end.first < MAX_COORDINATE), end.second + (end.second < MAX_COORDINATE)});
+
+		for (cord_t x = first.first; x <= last.first; x++) {
+			for (cord_t y = first.second; y <= last.second; y++) {
+				auto found = next_round.find({x, y});
+				if (found != next_round.end())
+					round[i] = std::max(round[i], found->second);
+			}
+		}
+		for (cord_t x = first.first; x <= last.first; x++) {
+			for (cord_t y = first.second; y <= last.second; y++)
+				next_round[{x, y}] = round[i] + 1;
+		}
+		rounds = std::max(rounds, round[i] + 1);
 	}
-	return *this;
+	if (rounds == 0 || count / rounds < PARALLEL_MERGE_ROUND_WORDS * threads)
+		return sequential();
+
+	// Words ordered by round, so that every round is a range.
+	std::vector<size_t> round_start(rounds + 1), order(count);
+	for (size_t i = 0; i < count; i++)
+		round_start[round[i] + 1]++;
+	for (size_t r = 0; r < rounds; r++)
+		round_start[r + 1] += round_start[r];
+	std::vector<size_t> position(round_start.begin(), round_start.end() - 1);
+	for (size_t i = 0; i < count; i++)
+		order[position[round[i]]++] = i;
+
+	// Tiles are created and unshared up front, so that the rounds don't change the tile map.
+	TileIndex& index = result.mutable_cells();
+	std::vector<pos_t> created;
+	for (size_t i = 0; i < count; i++) {
+		if (words[i].length() > 0)
+			index.prepare(words[i], &created);
+	}
+
+	auto next_word = std::make_unique<std::atomic<size_t>[]>(rounds);
+	std::barrier round_end(threads);
+	auto run = [&]() {
+		for (size_t r = 0; r < rounds; r++) {
+			for (size_t k; (k = round_start[r] + next_word[r].fetch_add(1)) < round_start[r + 1]; ) {
+				const Word& w = words[order[k]];
+				if (w.length() > 0 && !result.does_collide(w)) {
+					index.add(w);
+					accepted[order[k]] = true;
+				}
+			}
+			round_end.arrive_and_wait();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (size_t t = 1; t < threads; t++) {
+		workers.emplace_back(run);
+	}
+	run();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+
+	index.remove_empty(created);
+	for (size_t i = 0; i < count; i++) {
+		if (accepted[i])
+			result.store_word(Word(words[i]));
+	}
+	return finish();
 }
 
-std::ostream &operator<<(std::ostream &os, const Crossword &crossword) {
-	pos_t const& lt = crossword.area.get_left_top();
-	pos_t const& rb = crossword.area.get_right_bottom();
-	auto print_empty_line = [&lt, &rb, &os]() {
-		for (cord_t i = lt.first; i <= rb.first; i++)
-			os << CROSSWORD_BACKGROUND << ' ';
-		os << CROSSWORD_BACKGROUND << ' ' << CROSSWORD_BACKGROUND << '\n';
+namespace {
+	/*
+	 * Letters of three neighbouring lines of cells (rows for H words, columns for V words) along the lines
+	 * from 'from' on. Empty cells, and the cells of lines outside the space, hold -1.
+	 */
+	template<typename Cord>
+	struct LineWindow {
+		Cord from = 0;
+		std::vector<int> lines[3];
+
+		inline int at(size_t line, Cord pos) const {
+			return lines[line][pos - from];
+		}
+		inline bool any_at(Cord pos) const {
+			return at(0, pos) >= 0 || at(1, pos) >= 0 || at(2, pos) >= 0;
+		}
 	};
 
-	print_empty_line();
-	for (cord_t i = lt.second; i <= rb.second; i++) {
-		pos_t cur = pos_t(lt.first, i);
+	// The checks of Crossword::does_collide for a word lying on the middle line of the window.
+	template<typename Cord>
+	bool collides(const LineWindow<Cord>& window, const BasicWord<Cord>& w) {
+		bool horizontal = w.get_orientation() == H;
+		Cord first = horizontal ? w.get_start_position().first : w.get_start_position().second;
+		Cord last = horizontal ? w.get_end_position().first : w.get_end_position().second;
+
+		for (size_t i = 0; i < w.length(); i++) {
+			int letter = window.at(1, first + i);
+			if (letter >= 0 ? !BasicWord<Cord>::are_letters_the_same(char(letter), w.at(i))
+					: window.at(0, first + i) >= 0 || window.at(2, first + i) >= 0)
+				return true;
+		}
+		return (first > 0 && window.any_at(first - 1)) || (last < BasicWord<Cord>::MAX_COORDINATE && window.any_at(last + 1));
+	}
 
-		os << CROSSWORD_BACKGROUND << ' ';
-		while (cur.first <= rb.first) {
-			std::optional<char> letter = crossword.letter_at(cur);
-			if (letter.has_value()) {
-				os << (isalpha(letter.value()) ? letter.value() : DEFAULT_CHAR);
-			} else {
-				os << CROSSWORD_BACKGROUND;
+	// Orientation, line and the position along it of the start of the word.
+	template<typename Cord>
+	std::tuple<orientation_t, Cord, Cord> line_of(const BasicWord<Cord>& w) {
+		std::pair<Cord, Cord> start = w.get_start_position();
+		if (w.get_orientation() == H)
+			return {H, start.second, start.first};
+		return {V, start.first, start.second};
+	}
+
+	template<typename Cord>
+	Cord line_end(const BasicWord<Cord>& w) {
+		return w.get_orientation() == H ? w.get_end_position().first : w.get_end_position().second;
+	}
+}
+
+template<typename Cord>
+std::vector<bool> BasicCrossword<Cord>::can_insert(std::span<const Word> candidates, unsigned threads) const {
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	// Candidates ordered by line, then along it, in groups of candidates at most a tile apart.
+	std::vector<size_t> order(candidates.size()), group_start;
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return line_of(candidates[a]) < line_of(candidates[b]);
+	});
+	std::pair<orientation_t, cord_t> group_line;
+	cord_t reach = 0;
+	for (size_t k = 0; k < order.size(); k++) {
+		auto [ori, line, first] = line_of(candidates[order[k]]);
+		if (k == 0 || group_line != std::make_pair(ori, line) || (first > reach && first - reach > TileIndex::TILE_SIZE)) {
+			group_start.push_back(k);
+			group_line = {ori, line};
+			reach = 0;
+		}
+		reach = std::max(reach, line_end(candidates[order[k]]));
+	}
+	size_t groups = group_start.size();
+	group_start.push_back(order.size());
+
+	std::vector<char> results(candidates.size());
+	std::atomic<size_t> next_group{0};
+	auto run = [&]() {
+		LineWindow<Cord> window;
+		for (size_t g; (g = next_group.fetch_add(1)) < groups; ) {
+			auto [ori, line, first] = line_of(candidates[order[group_start[g]]]);
+			cord_t to = 0;
+			for (size_t k = group_start[g]; k < group_start[g + 1]; k++)
+				to = std::max(to, line_end(candidates[order[k]]));
+			window.from = first - (first > 0);
+			cord_t last = to + (to < MAX_COORDINATE);
+			size_t length = last - window.from + 1;
+
+			for (size_t l = 0; l < 3; l++) {
+				std::vector<int>& letters = window.lines[l];
+				letters.assign(length, -1);
+				if ((l == 0 && line == 0) || (l == 2 && line == MAX_COORDINATE))
+					continue;
+
+				auto store_letter = [&letters](size_t offset, char letter) {
+					letters[offset] = (unsigned char) letter;
+				};
+				if (ori == H)
+					cells->for_each_letter_in_row({window.from, line + l - 1}, last, store_letter);
+				else
+					cells->for_each_letter_in_column({line + l - 1, window.from}, last, store_letter);
 			}
-			os << ' ';
 
-			cur.first++;
+			for (size_t k = group_start[g]; k < group_start[g + 1]; k++)
+				results[order[k]] = !collides(window, candidates[order[k]]);
 		}
-		os << CROSSWORD_BACKGROUND << '\n';
+	};
+
+	std::vector<std::thread> workers;
+	for (size_t t = 1; t < std::min<size_t>(threads, candidates.size() / PARALLEL_CHECK_MIN_CANDIDATES); t++) {
+		workers.emplace_back(run);
+	}
+	run();
+	for (std::thread& worker : workers) {
+		worker.join();
 	}
-	print_empty_line();
 
-	return os;
+	return std::vector<bool>(results.begin(), results.end());
 }
 
-Crossword& Crossword::operator=(const Crossword& other) {
-	delete_words();
-	area = other.area;
+template<typename Cord>
+void BasicCrossword<Cord>::render(const std::function<void(std::string_view)>& write_line) const {
+	render_lines(area, false, write_line);
+}
+
+template<typename Cord>
+void BasicCrossword<Cord>::render(RectArea viewport, std::ostream& os, bool summary) const {
+	render_lines(viewport * area, summary, [&os](std::string_view line) {
+		os.write(line.data(), line.size());
+	});
+}
+
+namespace {
+	/*
+	 * A count of up to twice SIZE_MAX. Runs of the background and repeated lines of an area spanning
+	 * the whole space of size_t coordinates, with the frame around it, don't fit in a size_t.
+	 */
+	struct WideCount {
+		size_t low = 0;
+		bool carry = false;
+
+		void add(size_t count) {
+			carry |= low + count < low;
+			low += count;
+		}
+		inline bool exceeds(size_t count) const {
+			return carry || low > count;
+		}
+		std::string to_string() const {
+			if (!carry)
+				return std::to_string(low);
+			// SIZE_MAX + 1 + low, added digit by digit.
+			std::string max = std::to_string(SIZE_MAX), added = std::to_string(low), sum;
+			unsigned carried = 1;
+			for (size_t i = 0; i < max.size() || i < added.size() || carried > 0; i++) {
+				unsigned digit = carried + (i < max.size() ? max[max.size() - 1 - i] - '0' : 0)
+					+ (i < added.size() ? added[added.size() - 1 - i] - '0' : 0);
+				sum += char('0' + digit % 10);
+				carried = digit / 10;
+			}
+			return std::string(sum.rbegin(), sum.rend());
+		}
+	};
+
+	// Builds the lines of the summary mode, collapsing identical consecutive ones.
+	class SummaryWriter {
+		public:
+			explicit SummaryWriter(const std::function<void(std::string_view)>& write_line) : write_line(write_line) {}
+
+			// Appends 'count' cells of the background to the line being built, joined with the cells before.
+			void background(size_t count) {
+				run.add(count);
+			}
+
+			void letter(char letter) {
+				end_run();
+				cell(std::string(1, isalpha(letter) ? letter : DEFAULT_CHAR));
+			}
+
+			// Finishes the line being built and repeats it 'times' times.
+			void end_line(size_t times = 1) {
+				end_run();
+				if (times == 0) {
+					line.clear();
+				} else if (repeats.exceeds(0) && line == pending) {
+					repeats.add(times);
+					line.clear();
+				} else {
+					flush();
+					pending.swap(line);
+					line.clear();
+					repeats = {times};
+				}
+			}
+
+			void flush() {
+				if (!repeats.exceeds(0))
+					return;
+				if (repeats.exceeds(1))
+					pending += " x" + repeats.to_string();
+				pending += '\n';
+				write_line(pending);
+				repeats = {};
+			}
+
+		private:
+			void end_run() {
+				if (run.exceeds(3)) {
+					cell(std::string(1, CROSSWORD_BACKGROUND) + '*' + run.to_string());
+				} else {
+					for (size_t i = 0; i < run.low; i++)
+						cell(std::string(1, CROSSWORD_BACKGROUND));
+				}
+				run = {};
+			}
+
+			void cell(const std::string& token) {
+				if (!line.empty())
+					line += ' ';
+				line += token;
+			}
+
+			const std::function<void(std::string_view)>& write_line;
+			std::string line, pending;
+			WideCount run, repeats;
+	};
+}
+
+template<typename Cord>
+void BasicCrossword<Cord>::render_lines(RectArea visible, bool summary, const std::function<void(std::string_view)>& write_line) const {
+	// Rows and cells go from the left top to the right bottom one inclusive, as their number
+	// doesn't fit in a cord_t if the area spans the whole space.
+	pos_t lt = visible.get_left_top(), rb = visible.get_right_bottom();
+	cord_t last = rb.first - lt.first;
+
+	if (summary) {
+		// Rows are visited band by band of tiles, skipping the rows without tiles at once.
+		SummaryWriter writer(write_line);
+		std::vector<std::pair<size_t, char>> letters;
+		auto empty_rows = [&](size_t count) {
+			writer.background(1);
+			if (!visible.empty()) {
+				writer.background(last);
+				writer.background(1);
+			}
+			writer.background(1);
+			writer.end_line(count);
+		};
+
+		empty_rows(1);
+		for (cord_t y = lt.second; !visible.empty(); y++) {
+			std::optional<cord_t> band = cells->next_tile_row(y / TileIndex::TILE_SIZE);
+			if (!band.has_value() || *band > rb.second / TileIndex::TILE_SIZE) {
+				empty_rows(rb.second - y);
+				empty_rows(1);
+				break;
+			}
+			cord_t top = std::max(cord_t(*band * TileIndex::TILE_SIZE), y);
+			cord_t bottom = std::min(cord_t(top | (TileIndex::TILE_SIZE - 1)), rb.second);
+			empty_rows(top - y);
+
+			for (y = top; ; y++) {
+				letters.clear();
+				cells->for_each_letter_in_row({lt.first, y}, rb.first, [&](size_t offset, char letter) {
+					letters.emplace_back(offset, letter);
+				});
+				// The frame, the cells before every letter and after the last one, and the frame again.
+				writer.background(1);
+				for (size_t i = 0; i < letters.size(); i++) {
+					auto [offset, letter] = letters[i];
+					writer.background(i == 0 ? offset : offset - letters[i - 1].first - 1);
+					writer.letter(letter);
+				}
+				if (letters.empty()) {
+					writer.background(last);
+					writer.background(1);
+				} else {
+					writer.background(last - letters.back().first);
+				}
+				writer.background(1);
+				writer.end_line();
+				if (y == bottom)
+					break;
+			}
+			if (y == rb.second)
+				break;
+		}
+		empty_rows(1);
+		writer.flush();
+		return;
+	}
+
+	// Every cell is followed by a space, except for the last one of the line, framed with the background.
+	if (!visible.empty() && size_t(last) >= SIZE_MAX / 2 - 2)
+		throw std::length_error("crossword too wide to render");
+	std::string line(2 * ((visible.empty() ? 0 : size_t(last) + 1) + 2), ' ');
+	auto clear_line = [&line]() {
+		for (size_t i = 0; i < line.size(); i += 2)
+			line[i] = CROSSWORD_BACKGROUND;
+		line.back() = '\n';
+	};
+
+	clear_line();
+	write_line(line);
+	for (cord_t y = lt.second; !visible.empty(); y++) {
+		bool has_letters = false;
+		cells->for_each_letter_in_row({lt.first, y}, rb.first, [&](size_t offset, char letter) {
+			line[2 * (offset + 1)] = isalpha(letter) ? letter : DEFAULT_CHAR;
+			has_letters = true;
+		});
+		write_line(line);
+		if (has_letters)
+			clear_line();
+		if (y == rb.second)
+			break;
+	}
+	write_line(line);
+}
+
+template<typename Cord>
+std::ostream &operator<<(std::ostream &os, const BasicCrossword<Cord> &crossword) {
+	crossword.render([&os](std::string_view line) {
+		os.write(line.data(), line.size());
+	});
+	return os;
+}
 
-	for (Word* w : other.words)
-		insert_word(*w, false);
+template<typename Cord>
+BasicCrossword<Cord>& BasicCrossword<Cord>::operator=(const Crossword& other) {
+	if (this == &other)
+		return *this;
 
+	store = other.store;
+	cells = other.cells;
+	area = other.area;
+	may_collide = other.may_collide;
 	return *this;
 }
 
-Crossword& Crossword::operator=(Crossword&& other) {
-    delete_words();
-    words.swap(other.words);
-    h_words.swap(other.h_words);
-    v_words.swap(other.v_words);
+template<typename Cord>
+BasicCrossword<Cord>& BasicCrossword<Cord>::operator=(Crossword&& other) {
+    if (this == &other)
+        return *this;
+
+    store = std::move(other.store);
+    cells = std::move(other.cells);
     area = other.area;
-    other.area = DEFAULT_EMPTY_RECT_AREA;
+    may_collide = other.may_collide;
+    other.store = std::make_shared<WordStore>();
+    other.cells = std::make_shared<TileIndex>();
+    other.area = empty_area<Cord>();
+    other.may_collide = false;
     return *this;
 }
+
+// Saving and loading:
+
+namespace {
+	constexpr char SAVE_MAGIC[4] = {'C', 'R', 'S', 'W'};
+	constexpr uint64_t SAVE_VERSION = 1;
+	// The flag of the header set when the words may collide with the ones before them.
+	constexpr uint64_t SAVED_MAY_COLLIDE = 1;
+	// Bytes of a word in the table: the start, the length and the orientation.
+	constexpr size_t SAVED_WORD_SIZE = 3 * 8 + 1;
+	constexpr size_t SAVED_TILE_SIZE = 2 * 8;
+	// The magic, the version, the flags and the numbers of words, tiles and letters.
+	constexpr size_t SAVE_HEADER_SIZE = sizeof(SAVE_MAGIC) + 5 * 8;
+
+	void put(std::string& out, uint64_t value, size_t bytes = 8) {
+		for (size_t i = 0; i < bytes; i++)
+			out += char(value >> (8 * i));
+	}
+
+	// Reads the data from the front, failing once it runs out.
+	class SavedReader {
+		public:
+			explicit SavedReader(std::span<const char> data) : data(data) {}
+
+			std::optional<uint64_t> get(size_t bytes = 8) {
+				if (data.size() < bytes)
+					return {};
+				uint64_t value = 0;
+				for (size_t i = 0; i < bytes; i++)
+					value |= uint64_t(uint8_t(data[i])) << (8 * i);
+				data = data.subspan(bytes);
+				return value;
+			}
+
+			std::optional<std::span<const char>> take(size_t bytes) {
+				if (data.size() < bytes)
+					return {};
+				std::span<const char> taken = data.first(bytes);
+				data = data.subspan(bytes);
+				return taken;
+			}
+
+			inline size_t left() const {
+				return data.size();
+			}
+
+		private:
+			std::span<const char> data;
+	};
+}
+
+template<typename Cord>
+void BasicCrossword<Cord>::save(std::ostream& os) const {
+	size_t words = 0, letters = 0;
+	for (size_t index = 0; index < store->size; index++) {
+		// Words without letters were removed.
+		words += (*store)[index].length() > 0;
+		letters += (*store)[index].length();
+	}
+	std::vector<pos_t> tile_positions;
+	cells->for_each_tile_in(RectArea({0, 0}, {MAX_COORDINATE, MAX_COORDINATE}), [&](pos_t tile_pos, const std::vector<size_t>&) {
+		tile_positions.push_back(tile_pos);
+	});
+
+	std::string out(SAVE_MAGIC, sizeof(SAVE_MAGIC));
+	out.reserve(SAVE_HEADER_SIZE + words * SAVED_WORD_SIZE + tile_positions.size() * SAVED_TILE_SIZE);
+	put(out, SAVE_VERSION);
+	put(out, may_collide ? SAVED_MAY_COLLIDE : 0);
+	put(out, words);
+	put(out, tile_positions.size());
+	put(out, letters);
+	for (size_t index = 0; index < store->size; index++) {
+		const Word& w = (*store)[index];
+		if (w.length() == 0)
+			continue;
+		put(out, w.get_start_position().first);
+		put(out, w.get_start_position().second);
+		put(out, w.length());
+		put(out, w.get_orientation(), 1);
+	}
+	for (pos_t tile_pos : tile_positions) {
+		put(out, tile_pos.first);
+		put(out, tile_pos.second);
+	}
+	os.write(out.data(), out.size());
+
+	for (size_t index = 0; index < store->size; index++) {
+		const std::string& content = (*store)[index].content;
+		os.write(content.data(), content.size());
+	}
+}
+
+template<typename Cord>
+std::optional<BasicCrossword<Cord>> BasicCrossword<Cord>::load(std::span<const char> data, bool check_collisions) {
+	SavedReader reader(data);
+	std::optional<std::span<const char>> magic = reader.take(sizeof(SAVE_MAGIC));
+	if (!magic.has_value() || !std::equal(magic->begin(), magic->end(), SAVE_MAGIC) || reader.get() != SAVE_VERSION)
+		return {};
+	std::optional<uint64_t> flags = reader.get();
+	if (!flags.has_value() || (*flags & ~SAVED_MAY_COLLIDE) != 0)
+		return {};
+	// Words that may collide were saved from a crossword that has them, so only their layout is checked.
+	if (*flags & SAVED_MAY_COLLIDE)
+		check_collisions = false;
+	std::optional<uint64_t> words = reader.get(), tile_count = reader.get(), letters = reader.get();
+	if (!letters.has_value() || *words > reader.left() / SAVED_WORD_SIZE
+			|| *tile_count > (reader.left() - *words * SAVED_WORD_SIZE) / SAVED_TILE_SIZE
+			|| *letters != reader.left() - *words * SAVED_WORD_SIZE - *tile_count * SAVED_TILE_SIZE)
+		return {};
+
+	SavedReader table(*reader.take(*words * SAVED_WORD_SIZE));
+	Crossword result;
+	TileIndex& index = *result.cells;
+	std::vector<pos_t> tile_positions;
+	tile_positions.reserve(*tile_count);
+	for (size_t i = 0; i < *tile_count; i++) {
+		uint64_t tile_x = *reader.get(), tile_y = *reader.get();
+		if (tile_x > MAX_COORDINATE / TileIndex::TILE_SIZE || tile_y > MAX_COORDINATE / TileIndex::TILE_SIZE)
+			return {};
+		pos_t tile_pos = {cord_t(tile_x), cord_t(tile_y)};
+		if (!index.append_tile(tile_pos))
+			return {};
+		tile_positions.push_back(tile_pos);
+	}
+
+	for (size_t i = 0; i < *words; i++) {
+		uint64_t x = *table.get(), y = *table.get();
+		uint64_t length = *table.get(), orientation = *table.get(1);
+		if (x > MAX_COORDINATE || y > MAX_COORDINATE || length == 0 || length > reader.left() || orientation > V || length - 1 > MAX_COORDINATE - (orientation == H ? x : y))
+			return {};
+
+		std::span<const char> content = *reader.take(length);
+		if (!result.insert_word(Word(cord_t(x), cord_t(y), orientation_t(orientation), std::string(content.begin(), content.end())), check_collisions))
+			return {};
+	}
+	// Tiles without letters aren't part of a crossword.
+	index.remove_empty(tile_positions);
+	result.may_collide = *flags & SAVED_MAY_COLLIDE;
+	return result;
+}
+
+template<typename Cord>
+std::optional<BasicCrossword<Cord>> BasicCrossword<Cord>::load(std::istream& is, bool check_collisions) {
+	std::vector<char> data{std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>()};
+	return load(data, check_collisions);
+}
+
+template<typename Cord>
+std::optional<BasicCrossword<Cord>> BasicCrossword<Cord>::load_file(const std::string& path, bool check_collisions) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return {};
+
+	struct stat file_stat;
+	void* mapped = MAP_FAILED;
+	if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+		mapped = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED)
+		return {};
+
+	std::optional<Crossword> result;
+	try {
+		result = load(std::span<const char>(static_cast<const char*>(mapped), file_stat.st_size), check_collisions);
+	} catch (...) {
+		munmap(mapped, file_stat.st_size);
+		throw;
+	}
+	munmap(mapped, file_stat.st_size);
+	return result;
+}
+
+template class BasicWord<size_t>;
+template class BasicWord<uint32_t>;
+template class BasicWord<uint16_t>;
+template class BasicRectArea<size_t>;
+template class BasicRectArea<uint32_t>;
+template class BasicRectArea<uint16_t>;
+template class BasicTileIndex<size_t>;
+template class BasicTileIndex<uint32_t>;
+template class BasicTileIndex<uint16_t>;
+template class BasicCrossword<size_t>;
+template class BasicCrossword<uint32_t>;
+template class BasicCrossword<uint16_t>;
+template std::ostream &operator<<(std::ostream &os, const BasicCrossword<size_t> &crossword);
+template std::ostream &operator<<(std::ostream &os, const BasicCrossword<uint32_t> &crossword);
+template std::ostream &operator<<(std::ostream &os, const BasicCrossword<uint16_t> &crossword);
@@ -2,44 +2,64 @@
 #define CROSSWORDS_H
 
 #include <iostream>
+#include <algorithm>
 #include <compare>
-#include <set>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <map>
+#include <unordered_map>
 #include <vector>
 #include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
 
 enum orientation_t : bool {
 	H, V
 };
 
-class RectArea;
+/*
+ * The classes are templates of the type of coordinates, an unsigned integer type whose values span the space
+ * on both axes. Narrower coordinates make positions smaller, and positions of coordinates up to 32 bits wide
+ * are compared as a single integer. The names without "Basic" at the end of the file use size_t.
+ */
+template<typename Cord> class BasicWord;
+template<typename Cord> class BasicRectArea;
+template<typename Cord> class BasicTileIndex;
+template<typename Cord> class BasicCrossword;
 
-using cord_t = size_t;
-using pos_t = std::pair<cord_t, cord_t>;
-using dim_t = std::pair<cord_t, cord_t>;
-
-constexpr cord_t MAX_COORDINATE = (cord_t) - 1;
 constexpr char DEFAULT_CHAR = '?';
 constexpr std::string DEFAULT_WORD = "?";
 extern char CROSSWORD_BACKGROUND;
 
-extern const RectArea DEFAULT_EMPTY_RECT_AREA;
+template<typename Cord>
+class BasicWord {
+	static_assert(std::is_unsigned_v<Cord>);
+
+	public:
+		using cord_t = Cord;
+		using pos_t = std::pair<Cord, Cord>;
+		static constexpr cord_t MAX_COORDINATE = cord_t(-1);
 
-class Word {
 	private:
+		using Word = BasicWord<Cord>;
+		using RectArea = BasicRectArea<Cord>;
+
 		pos_t wordStart;
 		orientation_t orientation;
 		std::string content;
 
 		std::optional<char> at(pos_t pos) const;
 		pos_t pos_of_letter(size_t offset) const;
-        void construct(size_t x, size_t y);
+        void construct(cord_t x, cord_t y);
 	public:
-        Word(size_t x, size_t y, orientation_t wordOrientation, std::string&& wordContent);
-        Word(size_t x, size_t y, orientation_t wordOrientation, std::string& wordContent);
-		Word(const Word& word);
-		Word(Word&& word);
+        BasicWord(cord_t x, cord_t y, orientation_t wordOrientation, std::string&& wordContent);
+        BasicWord(cord_t x, cord_t y, orientation_t wordOrientation, std::string& wordContent);
+		BasicWord(const Word& word);
+		BasicWord(Word&& word) noexcept;
 		Word& operator=(const Word& word);
-		Word& operator=(Word&& word);
+		Word& operator=(Word&& word) noexcept;
 		inline pos_t get_start_position() const {
 			return wordStart;
 		}
@@ -61,20 +81,30 @@ class Word {
 				|| (isalpha(l1) && isalpha(l2) && l1 == l2);
 		}
 
-		friend class Crossword;
+		friend class BasicCrossword<Cord>;
+		friend class BasicTileIndex<Cord>;
 };
 
-class RectArea {
+template<typename Cord>
+class BasicRectArea {
+	public:
+		using cord_t = Cord;
+		using pos_t = std::pair<Cord, Cord>;
+		// Sizes and counts are size_t, so that a side spanning the whole space of narrower coordinates fits.
+		using dim_t = std::pair<size_t, size_t>;
+
 	private:
+		using RectArea = BasicRectArea<Cord>;
+
 		pos_t leftUpper;
 		pos_t rightBottom;
 		
 		bool pointInRect(pos_t point) const;
 		bool rectInRect(RectArea rectArea) const;
 	public:
-		RectArea(pos_t left_top, pos_t right_bottom);
-		RectArea(const RectArea& rectArea);
-		RectArea(RectArea&& rectArea);
+		BasicRectArea(pos_t left_top, pos_t right_bottom);
+		BasicRectArea(const RectArea& rectArea);
+		BasicRectArea(RectArea&& rectArea);
 		RectArea& operator=(const RectArea& rectArea);
 		RectArea& operator=(RectArea&& rectArea);
 		inline pos_t get_left_top() const {
@@ -105,6 +135,7 @@ class RectArea {
 		}
 		const RectArea operator*(const RectArea& rectArea) const;
 		RectArea& operator*=(const RectArea& rectArea);
+		// The numbers of columns and rows. A side spanning the whole space of size_t coordinates wraps to 0.
 		dim_t size() const;
 		inline bool empty() const {
 			return
@@ -114,20 +145,291 @@ class RectArea {
 		void embrace(pos_t point);
 };
 
+// Whether (major1, minor1) comes before (major2, minor2). Coordinates up to 32 bits wide are packed into one integer.
+template<typename Cord>
+inline bool position_less(Cord major1, Cord minor1, Cord major2, Cord minor2) {
+	if constexpr (2 * sizeof(Cord) <= sizeof(uint64_t)) {
+		constexpr unsigned BITS = 8 * sizeof(Cord);
+		return (uint64_t(major1) << BITS | minor1) < (uint64_t(major2) << BITS | minor2);
+	} else {
+		return major1 < major2 || (major1 == major2 && minor1 < minor2);
+	}
+}
+
+// Orders positions by column, then by row. Words can be looked up directly by their start position.
 struct vertical_cmp {
-	bool operator()(Word* w1, Word* w2) const;
+	using is_transparent = void;
+
+	template<typename Cord>
+	bool operator()(std::pair<Cord, Cord> p1, std::pair<Cord, Cord> p2) const {
+		return position_less(p1.first, p1.second, p2.first, p2.second);
+	}
+	template<typename Cord>
+	bool operator()(const BasicWord<Cord>& w, std::pair<Cord, Cord> p) const {
+		return (*this)(w.get_start_position(), p);
+	}
+	template<typename Cord>
+	bool operator()(std::pair<Cord, Cord> p, const BasicWord<Cord>& w) const {
+		return (*this)(p, w.get_start_position());
+	}
 };
 
+// Orders positions by row, then by column.
 struct horizontal_cmp {
-	bool operator()(Word* w1, Word* w2) const;
+	using is_transparent = void;
+
+	template<typename Cord>
+	bool operator()(std::pair<Cord, Cord> p1, std::pair<Cord, Cord> p2) const {
+		return position_less(p1.second, p1.first, p2.second, p2.first);
+	}
+	template<typename Cord>
+	bool operator()(const BasicWord<Cord>& w, std::pair<Cord, Cord> p) const {
+		return (*this)(w.get_start_position(), p);
+	}
+	template<typename Cord>
+	bool operator()(std::pair<Cord, Cord> p, const BasicWord<Cord>& w) const {
+		return (*this)(p, w.get_start_position());
+	}
 };
 
-class Crossword {
+/*
+ * Letters of the words split into square tiles of cells, so that finding a letter takes a single hash lookup.
+ * Only tiles with letters exist, and they are additionally ordered by row, so a part of the space
+ * is scanned in time proportional to the number of tiles in it, however large the part is.
+ * Every tile also indexes the words starting in it. Copies of the index share the tiles,
+ * and a shared tile is copied only before it changes.
+ */
+template<typename Cord>
+class BasicTileIndex {
+	public:
+		using cord_t = Cord;
+		using pos_t = std::pair<Cord, Cord>;
+		static constexpr cord_t MAX_COORDINATE = cord_t(-1);
+		static constexpr cord_t TILE_SIZE = 64;
+
+	private:
+		using Word = BasicWord<Cord>;
+		using RectArea = BasicRectArea<Cord>;
+
+	public:
+
+		struct tile_hash {
+			size_t operator()(pos_t tile) const;
+		};
+
+		static inline pos_t tile_of(pos_t pos) {
+			return {pos.first / TILE_SIZE, pos.second / TILE_SIZE};
+		}
+
+		// The letter of the H word at the position if there's one, otherwise the letter of the V word.
+		std::optional<char> letter_at(pos_t pos) const;
+
+		/*
+		 * Calls f(offset, letter) for every letter in the cells of the row from 'start' to the column 'last',
+		 * from left to right. Only the existing tiles of the row are visited.
+		 */
+		template<typename F>
+		void for_each_letter_in_row(pos_t start, cord_t last, F&& f) const {
+			cord_t tile_row = start.second / TILE_SIZE;
+			size_t row = (start.second % TILE_SIZE) * TILE_SIZE;
+			for (auto it = ordered.lower_bound({start.first / TILE_SIZE, tile_row});
+					it != ordered.end() && it->first.second == tile_row && it->first.first <= last / TILE_SIZE; ++it) {
+				cord_t tile_x = it->first.first * TILE_SIZE;
+				cord_t from = std::max(tile_x, start.first), to = std::min(cord_t(tile_x + (TILE_SIZE - 1)), last);
+				for (cord_t i = 0; i <= to - from; i++) {
+					size_t cell = row + (from + i) % TILE_SIZE;
+					if (it->second->orientations[cell] != 0)
+						f(from + i - start.first, it->second->letters[cell]);
+				}
+			}
+		}
+
+		// The number of words indexed by index_word in the orientation with a start of their own.
+		inline size_t start_count(orientation_t ori) const {
+			return start_counts[ori];
+		}
+
+		// Like for_each_letter_in_row, for the cells of the column from 'start' to the row 'last', from top to bottom.
+		template<typename F>
+		void for_each_letter_in_column(pos_t start, cord_t last, F&& f) const {
+			cord_t tile_column = start.first / TILE_SIZE;
+			size_t column = start.first % TILE_SIZE;
+			for (cord_t tile_row = start.second / TILE_SIZE; ; tile_row++) {
+				auto it = tiles.find({tile_column, tile_row});
+				if (it != tiles.end()) {
+					cord_t tile_y = tile_row * TILE_SIZE;
+					cord_t from = std::max(tile_y, start.second), to = std::min(cord_t(tile_y + (TILE_SIZE - 1)), last);
+					for (cord_t i = 0; i <= to - from; i++) {
+						size_t cell = ((from + i) % TILE_SIZE) * TILE_SIZE + column;
+						if (it->second->orientations[cell] != 0)
+							f(from + i - start.second, it->second->letters[cell]);
+					}
+				}
+				if (tile_row == last / TILE_SIZE)
+					break;
+			}
+		}
+
+		/*
+		 * Calls f(tile_pos, words) for every existing tile overlapping the area, row by row, with the indices
+		 * of the words with letters in the tile. Rows and parts of rows without tiles are skipped at once.
+		 */
+		template<typename F>
+		void for_each_tile_in(const RectArea& area, F&& f) const {
+			if (area.empty())
+				return;
+
+			pos_t first = tile_of(area.get_left_top()), last = tile_of(area.get_right_bottom());
+			auto it = ordered.lower_bound(first);
+			while (it != ordered.end() && it->first.second <= last.second) {
+				if (it->first.first < first.first) {
+					it = ordered.lower_bound({first.first, it->first.second});
+				} else if (it->first.first > last.first) {
+					it = ordered.lower_bound({first.first, it->first.second + 1});
+				} else {
+					f(it->first, static_cast<const std::vector<size_t>&>(it->second->words));
+					++it;
+				}
+			}
+		}
+
+		// The first row of tiles from 'tile_row' on that has any tiles, if there's one.
+		std::optional<cord_t> next_tile_row(cord_t tile_row) const {
+			auto it = ordered.lower_bound({0, tile_row});
+			if (it == ordered.end())
+				return {};
+			return it->first.second;
+		}
+
+		/*
+		 * Makes room for the word: creates the missing tiles of its letters (appending their positions
+		 * to 'created' if it's given), copies the ones shared with other indices and reserves its entries
+		 * in index_word. After that, adding or indexing the word doesn't allocate, and words sharing
+		 * no tile can be added by several threads at once.
+		 */
+		void prepare(const Word& w, std::vector<pos_t>* created = nullptr);
+		// Adds the letters of a prepared word.
+		void add(const Word& w);
+		/*
+		 * Indexes the word stored at 'index' in the tiles of its letters, and by its start unless a word
+		 * in its orientation already starts there. True if it's indexed by its start.
+		 */
+		bool index_word(const Word& w, size_t index);
+		// Removes the tiles at the given positions that have no letters.
+		void remove_empty(const std::vector<pos_t>& tile_positions);
+		/*
+		 * Creates an empty tile after all the existing ones in the order by row, then by column,
+		 * which takes constant time. False if the position isn't after them.
+		 */
+		bool append_tile(pos_t tile_pos);
+
+		/*
+		 * Removes the letters of the word stored at 'index' and its entries from index_word, along with
+		 * the tiles left without letters. The cells it shares with other words keep their letters,
+		 * which are taken from word_at(i) for the words listed in its tiles.
+		 */
+		void remove(const Word& w, size_t index, const std::function<const Word&(size_t)>& word_at);
+
+		/*
+		 * The smallest area with all the letters. Only the tiles in the outermost rows and columns
+		 * of tiles are scanned.
+		 */
+		RectArea bounds() const;
+
 	private:
-		std::set<Word*, horizontal_cmp> h_words;
-		std::set<Word*, vertical_cmp> v_words;
-		std::vector<Word*> words;
+		/*
+		 * Cells of a tile row by row. Orientations are bit masks of the words covering the cell, 0 if it's empty.
+		 * Words starting in the tile are kept by cell, separately for every orientation,
+		 * and 'words' has every word with a letter in the tile in the order of indexing.
+		 */
+		struct Tile {
+			char letters[TILE_SIZE * TILE_SIZE];
+			uint8_t orientations[TILE_SIZE * TILE_SIZE] = {};
+			std::vector<std::pair<uint16_t, size_t>> starts[2];
+			std::vector<size_t> words;
+		};
+
+		static inline size_t cell_of(pos_t pos) {
+			return (pos.second % TILE_SIZE) * TILE_SIZE + pos.first % TILE_SIZE;
+		}
+
+		static inline uint8_t orientation_bit(orientation_t ori) {
+			return ori == H ? 1 : 2;
+		}
+
+		// The existing tile at the position, copied first if it's shared.
+		Tile& mutable_tile(pos_t tile_pos);
+		// Creates an empty tile at the position, which takes constant time if it's the last one in order.
+		void create_tile(pos_t tile_pos);
+		// Removes the tile at the position if it has no letters.
+		void remove_if_empty(pos_t tile_pos);
+
+		std::unordered_map<pos_t, std::shared_ptr<Tile>, tile_hash> tiles;
+		// The same tiles ordered by row, then by column.
+		std::map<pos_t, const Tile*, horizontal_cmp> ordered;
+		// The number of tiles in every column of tiles that has any.
+		std::map<cord_t, size_t> tile_columns;
+		size_t start_counts[2] = {};
+};
+
+template<typename Cord>
+class BasicCrossword {
+	public:
+		using cord_t = Cord;
+		using pos_t = std::pair<Cord, Cord>;
+		// Sizes and counts are size_t, so that a side spanning the whole space of narrower coordinates fits.
+		using dim_t = std::pair<size_t, size_t>;
+		static constexpr cord_t MAX_COORDINATE = cord_t(-1);
+
+	private:
+		using Word = BasicWord<Cord>;
+		using RectArea = BasicRectArea<Cord>;
+		using TileIndex = BasicTileIndex<Cord>;
+		using Crossword = BasicCrossword<Cord>;
+
+		/*
+		 * Words in the order of insertion, stored contiguously in chunks of CHUNK_WORDS words
+		 * (letters of words up to 15 characters long are kept inline by std::string).
+		 * Copies of the store share the chunks, and a shared chunk is copied only before it changes.
+		 * Removed words are left in place without letters, so that the indices of the others stay the same.
+		 */
+		struct WordStore {
+			static constexpr size_t CHUNK_WORDS = 256;
+
+			std::vector<std::shared_ptr<std::vector<Word>>> chunks;
+			size_t size = 0;
+
+			inline const Word& operator[](size_t index) const {
+				return (*chunks[index / CHUNK_WORDS])[index % CHUNK_WORDS];
+			}
+			// The chunk, copied first if it's shared.
+			static std::vector<Word>& mutable_chunk(std::shared_ptr<std::vector<Word>>& chunk);
+			// The chunk for the next word, not shared and with room for it.
+			std::vector<Word>& reserve_next();
+			// The word at the index, in a chunk that isn't shared.
+			Word& mutable_word(size_t index);
+			// Drops the removed words at the end, as long as their chunks aren't shared. Doesn't allocate.
+			void trim();
+		};
+
+		// Merges of fewer words, or with fewer words per round than that for every thread, are sequential.
+		static constexpr size_t PARALLEL_MERGE_MIN_WORDS = 4096;
+		static constexpr size_t PARALLEL_MERGE_ROUND_WORDS = 64;
+		// can_insert uses a thread for every that many candidates, up to the number of threads given.
+		static constexpr size_t PARALLEL_CHECK_MIN_CANDIDATES = 1024;
+
+		// Shared by copies of the crossword until one of them changes.
+		std::shared_ptr<WordStore> store;
+		std::shared_ptr<TileIndex> cells;
 		RectArea area;
+		/*
+		 * Whether words may collide with the ones before them: set by insert_word without the checks
+		 * and by remove_word of a word sharing a cell with others. Saved, so that load doesn't reject them.
+		 */
+		bool may_collide = false;
+
+		WordStore& mutable_store();
+		TileIndex& mutable_cells();
 
 		bool does_collide(const Word &w) const;
         bool has_letter_at(pos_t pos, int off_x, int off_y) const {
@@ -136,27 +438,144 @@ class Crossword {
             return letter_at(pos).has_value();
         }
 
-    std::optional<char> letter_at(pos_t pos) const;
-		std::optional<const Word *> closest_word(const pos_t &pos, orientation_t ori) const;
-		void delete_words();
+		inline std::optional<char> letter_at(pos_t pos) const {
+			return cells->letter_at(pos);
+		}
+		void store_word(Word&& w);
+		// Inserts the words one by one like insert_word does, with merge's rounds; true for the inserted ones.
+		template<typename Words>
+		std::vector<char> insert_all(const Words& words, size_t count, unsigned threads);
+		void render_lines(RectArea visible, bool summary, const std::function<void(std::string_view)>& write_line) const;
+		// An empty crossword, for load.
+		BasicCrossword();
 
 	public:
-		Crossword(Word const& first, std::initializer_list<Word> other);
-		Crossword(const Crossword& other);
-		Crossword(Crossword&& other);
-		~Crossword();
+		BasicCrossword(Word const& first, std::initializer_list<Word> other);
+		// Takes constant time: the copy shares the words and the tiles with 'other' until either changes.
+		BasicCrossword(const Crossword& other);
+		BasicCrossword(Crossword&& other);
+		~BasicCrossword();
 		inline dim_t size() const {
 			return area.size();
 		}
 		inline dim_t word_count() const {
-			return {h_words.size(), v_words.size()};
+			return {cells->start_count(H), cells->start_count(V)};
 		}
+		// Leaves the crossword unchanged if it fails or throws.
 		bool insert_word(Word const& w, bool check_collisions = true);
+
+		/*
+		 * Removes the word inserted last with the start and orientation, and returns it (nothing if
+		 * there's none), so that insert_word(w, false) undoes it. Letters shared with other words stay,
+		 * and so do the other words, even ones that only fit together thanks to it.
+		 * The time depends on the tiles of the word and the words in them, and, if the word was on
+		 * the edge of the crossword, on the outermost tiles. Leaves the crossword unchanged if it throws.
+		 */
+		std::optional<Word> remove_word(pos_t start, orientation_t orientation);
+
+		/*
+		 * Renders the crossword like operator<< does, passing every line (with its '\n')
+		 * to 'write_line' as soon as it's ready. Lines are built in a single buffer,
+		 * so the memory used doesn't depend on the height of the crossword.
+		 */
+		void render(const std::function<void(std::string_view)>& write_line) const;
+
+		/*
+		 * Renders the part of the crossword inside 'viewport' (clipped to the area of the crossword),
+		 * framed like in operator<<. The time depends on the number of tiles with letters
+		 * in the viewport and on the size of the output.
+		 *
+		 * In the summary mode, every run of more than 3 background characters in a line is written
+		 * as the background followed by '*' and the length of the run, e.g. ". A .*1000 B .", and
+		 * k > 1 identical consecutive lines are written as a single one followed by " x" and k.
+		 * This keeps the output proportional to the letters in the viewport even for huge areas.
+		 */
+		void render(RectArea viewport, std::ostream& os, bool summary = false) const;
 		Crossword& operator=(const Crossword&);
 		Crossword& operator=(Crossword&&);
 		Crossword operator+(const Crossword& b) const;
 		Crossword& operator+=(const Crossword& b);
-		friend std::ostream &operator<<(std::ostream &os, const Crossword &crossword);
+
+		/*
+		 * Inserts the words of b like operator+= does, with the same result, using up to 'threads' threads
+		 * (all hardware threads with 0). Words are split by the tiles around them into rounds
+		 * of words far enough apart to be checked and added at once, each word in a later round
+		 * than the words of b before it that share a tile with it.
+		 */
+		Crossword& merge(const Crossword& b, unsigned threads = 0);
+
+		/*
+		 * Whether insert_word would insert each of the candidates into the crossword as it is,
+		 * using up to 'threads' threads (all hardware threads with 0). Candidates in the same row (H)
+		 * or column (V) close to each other are checked together against a single copy
+		 * of the three lines around them.
+		 */
+		std::vector<bool> can_insert(std::span<const Word> candidates, unsigned threads = 0) const;
+
+		// Inserts the words in order like insert_word does, using merge's rounds. True for the inserted ones.
+		std::vector<bool> try_insert_many(std::span<const Word> words, unsigned threads = 0);
+
+		/*
+		 * The words with a letter in the area, each once, ordered by the tile of their first letter in it.
+		 * Only the tiles of the area with letters are visited, so the time depends on them and on the words
+		 * in them, not on the size of the area or of the crossword.
+		 */
+		std::vector<Word> words_in(const RectArea& area) const;
+		std::vector<Word> words_at_row(cord_t row) const;
+		std::vector<Word> words_at_column(cord_t column) const;
+
+		/*
+		 * Writes the words in the order of insertion in a binary format: a header with flags (bit 0 set
+		 * if the words may collide with the ones before them, after remove_word or unchecked inserts)
+		 * and the numbers of words, tiles and letters, a table of the words (start, length and orientation),
+		 * the positions of the tiles ordered by row, then by column, and the letters of all the words
+		 * one after another. Integers are little-endian, 64-bit except for the orientations.
+		 */
+		void save(std::ostream& os) const;
+
+		/*
+		 * The crossword saved in the data, with the words inserted in order like insert_word(w, check_collisions)
+		 * does. The tiles are created from their saved order in time proportional to their number.
+		 * Nothing if the data isn't a saved crossword or, with check_collisions, if a word collides with
+		 * the ones before it. Data not known to come from save should be checked. The words of data flagged
+		 * as possibly colliding are taken unchecked, so anything save writes loads back.
+		 */
+		static std::optional<Crossword> load(std::span<const char> data, bool check_collisions = true);
+		static std::optional<Crossword> load(std::istream& is, bool check_collisions = true);
+		// Like load, reading the file through a read-only memory mapping instead of copying it.
+		static std::optional<Crossword> load_file(const std::string& path, bool check_collisions = true);
+		template<typename C>
+		friend std::ostream &operator<<(std::ostream &os, const BasicCrossword<C> &crossword);
 };
 
+template<typename Cord>
+std::ostream &operator<<(std::ostream &os, const BasicCrossword<Cord> &crossword);
+
+using cord_t = size_t;
+using pos_t = std::pair<cord_t, cord_t>;
+using dim_t = std::pair<size_t, size_t>;
+
+constexpr cord_t MAX_COORDINATE = (cord_t) - 1;
+
+using Word = BasicWord<cord_t>;
+using RectArea = BasicRectArea<cord_t>;
+using TileIndex = BasicTileIndex<cord_t>;
+using Crossword = BasicCrossword<cord_t>;
+
+extern const RectArea DEFAULT_EMPTY_RECT_AREA;
+
+// Instantiated in crosswords.cc for size_t, uint32_t and uint16_t.
+extern template class BasicWord<size_t>;
+extern template class BasicWord<uint32_t>;
+extern template class BasicWord<uint16_t>;
+extern template class BasicRectArea<size_t>;
+extern template class BasicRectArea<uint32_t>;
+extern template class BasicRectArea<uint16_t>;
+extern template class BasicTileIndex<size_t>;
+extern template class BasicTileIndex<uint32_t>;
+extern template class BasicTileIndex<uint16_t>;
+extern template class BasicCrossword<size_t>;
+extern template class BasicCrossword<uint32_t>;
+extern template class BasicCrossword<uint16_t>;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,448 @@
+/*
+ * Benchmarks of the crosswords library. Every workload prints the time of each of its steps.
+ *
+ * g++ -Wall -Wextra -O2 -std=c++20 crosswords.cc crossword_fill.cc crosswords_bench.cc -pthread -o crosswords_bench
+ *
+ * './crosswords_bench' runs every workload, './crosswords_bench insert' only the given ones.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <malloc.h>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "crossword_fill.h"
+#include "crosswords.h"
+
+namespace {
+	template<typename F>
+	void measure(const char* workload, const char* step, F&& f) {
+		auto start = std::chrono::steady_clock::now();
+		std::string result = f();
+		std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+		printf("%-24s %-24s %12.2f ms   %s\n", workload, step, time.count(), result.c_str());
+	}
+
+	// Random words of 2 to 10 letters, starting anywhere on a board of the given size moved right by 'shift'.
+	std::vector<Word> random_words(size_t count, cord_t board, unsigned seed, cord_t shift = 0) {
+		std::mt19937 random(seed);
+		std::uniform_int_distribution<cord_t> position(0, board - 1);
+		std::uniform_int_distribution<size_t> length(2, 10);
+		std::uniform_int_distribution<int> letter('A', 'F');
+
+		std::vector<Word> words;
+		for (size_t i = 0; i < count; i++) {
+			std::string content(length(random), ' ');
+			for (char& c : content)
+				c = letter(random);
+			cord_t x = position(random) + shift;
+			words.emplace_back(x, position(random), random() % 2 ? H : V, std::move(content));
+		}
+		return words;
+	}
+
+	std::string counts(const Crossword& crossword) {
+		dim_t count = crossword.word_count();
+		return std::to_string(count.first) + " H + " + std::to_string(count.second) + " V words";
+	}
+
+	// 10^5 random words inserted with collision checks into a 2000x2000 board.
+	void insert() {
+		std::vector<Word> words = random_words(100000, 2000, 1);
+		Crossword crossword(words.front(), {});
+
+		measure("insert 100000", "insert_word", [&] {
+			for (const Word& w : words)
+				crossword.insert_word(w);
+			return counts(crossword);
+		});
+		measure("insert 100000", "copy", [&] {
+			Crossword copy(crossword);
+			return counts(copy);
+		});
+	}
+
+	// The words of 'insert' written out as a 2000x2000 board.
+	void render() {
+		std::vector<Word> words = random_words(100000, 2000, 1);
+		Crossword crossword(words.front(), {});
+		for (const Word& w : words)
+			crossword.insert_word(w);
+
+		measure("render 2000x2000", "operator<<", [&] {
+			std::ostringstream out;
+			out << crossword;
+			return std::to_string(out.str().size()) + " bytes";
+		});
+		measure("render 2000x2000", "render", [&] {
+			size_t bytes = 0;
+			crossword.render([&bytes](std::string_view line) {
+				bytes += line.size();
+			});
+			return std::to_string(bytes) + " bytes";
+		});
+	}
+
+	// Two boards like in 'insert' merged together, then merged with a third one far to the right.
+	void merge() {
+		Crossword boards[3] = {{Word(0, 0, H, "A"), {}}, {Word(0, 0, H, "A"), {}}, {Word(5000, 0, H, "A"), {}}};
+		for (unsigned b = 0; b < 3; b++) {
+			for (const Word& w : random_words(100000, 2000, b + 1, b == 2 ? 5000 : 0))
+				boards[b].insert_word(w);
+		}
+
+		measure("merge 2x100000", "operator+", [&] {
+			return counts(boards[0] + boards[1]);
+		});
+		measure("merge 2x100000", "operator+=", [&] {
+			boards[0] += boards[1];
+			return counts(boards[0]);
+		});
+		Crossword sequential(boards[0]);
+		measure("merge far", "merge, 1 thread", [&] {
+			sequential.merge(boards[2], 1);
+			return counts(sequential);
+		});
+		measure("merge far", "operator+=", [&] {
+			boards[0] += boards[2];
+			return counts(boards[0]);
+		});
+	}
+
+	// A search over the 'insert' board: 1000 steps, each copying the board and inserting a word into the copy.
+	void search() {
+		std::vector<Word> words = random_words(100000, 2000, 1);
+		Crossword crossword(words.front(), {});
+		for (const Word& w : words)
+			crossword.insert_word(w);
+		std::vector<Word> steps = random_words(1000, 2000, 3);
+
+		measure("search 1000 steps", "copy + insert_word", [&] {
+			size_t inserted = 0;
+			for (const Word& w : steps) {
+				Crossword step(crossword);
+				inserted += step.insert_word(w);
+			}
+			return std::to_string(inserted) + " inserted";
+		});
+		measure("search 1000 steps", "operator+", [&] {
+			size_t words = 0;
+			for (const Word& w : steps) {
+				Crossword step = crossword + Crossword(w, {});
+				words += step.word_count().first + step.word_count().second;
+			}
+			return std::to_string(words) + " words";
+		});
+	}
+
+	// 10^4 candidates, half of them in 50 rows and 50 columns, checked against the 'insert' board.
+	void candidates() {
+		std::vector<Word> words = random_words(100000, 2000, 1);
+		Crossword crossword(words.front(), {});
+		for (const Word& w : words)
+			crossword.insert_word(w);
+
+		std::vector<Word> candidates = random_words(5000, 2000, 4);
+		for (const Word& w : random_words(5000, 2000, 5)) {
+			pos_t start = w.get_start_position();
+			if (w.get_orientation() == H)
+				candidates.emplace_back(start.first, 1000 + start.second % 50, H, std::string(w.length(), 'A'));
+			else
+				candidates.emplace_back(1000 + start.first % 50, start.second, V, std::string(w.length(), 'A'));
+		}
+		auto accepted = [](const std::vector<bool>& results) {
+			return std::to_string(std::count(results.begin(), results.end(), true)) + " accepted";
+		};
+
+		measure("candidates 10000", "copy + insert_word", [&] {
+			std::vector<bool> results;
+			for (const Word& w : candidates) {
+				Crossword copy(crossword);
+				results.push_back(copy.insert_word(w));
+			}
+			return accepted(results);
+		});
+		measure("candidates 10000", "can_insert", [&] {
+			return accepted(crossword.can_insert(candidates));
+		});
+		measure("candidates 10000", "try_insert_many", [&] {
+			Crossword copy(crossword);
+			return accepted(copy.try_insert_many(candidates));
+		});
+	}
+
+	// 10^4 hit-tests of 10x10 windows, and 1000 rows and 1000 columns of the 'insert' board, each queried for its words.
+	void query() {
+		std::vector<Word> words = random_words(100000, 2000, 1);
+		Crossword crossword(words.front(), {});
+		for (const Word& w : words)
+			crossword.insert_word(w);
+		std::vector<Word> points = random_words(10000, 2000, 8);
+
+		measure("query", "scan of all words", [&] {
+			size_t found = 0;
+			for (size_t k = 0; k < 1000; k++) {
+				pos_t p = points[k].get_start_position();
+				RectArea window(p, {p.first + 9, p.second + 9});
+				for (const Word& w : words)
+					found += !(w.rect_area() * window).empty();
+			}
+			return std::to_string(found) + " hits in 1000 windows, inserted or not";
+		});
+		measure("query", "words_in 10x10", [&] {
+			size_t found = 0;
+			for (const Word& point : points) {
+				pos_t p = point.get_start_position();
+				found += crossword.words_in(RectArea(p, {p.first + 9, p.second + 9})).size();
+			}
+			return std::to_string(found) + " words";
+		});
+		measure("query", "words_at_row/column", [&] {
+			size_t found = 0;
+			for (cord_t line = 0; line < 2000; line += 2)
+				found += crossword.words_at_row(line).size() + crossword.words_at_column(line + 1).size();
+			return std::to_string(found) + " words";
+		});
+	}
+
+	// 1000 words of the 'insert' board removed and inserted back one at a time, like undo and redo in an editor.
+	void edit() {
+		std::vector<Word> words = random_words(100000, 2000, 1);
+		Crossword crossword(words.front(), {});
+		std::vector<Word> inserted;
+		for (const Word& w : words) {
+			if (crossword.insert_word(w))
+				inserted.push_back(w);
+		}
+		std::vector<Word> edited;
+		for (size_t i = 0; i < inserted.size(); i += inserted.size() / 1000)
+			edited.push_back(inserted[i]);
+
+		measure("edit 1000 words", "rebuild without one", [&] {
+			size_t words = 0;
+			for (size_t k = 1; k <= 10; k++) {
+				Crossword rebuilt(inserted.front(), {});
+				for (const Word& w : inserted) {
+					if (w != edited[k])
+						rebuilt.insert_word(w, false);
+				}
+				words += rebuilt.word_count().first + rebuilt.word_count().second;
+			}
+			return std::to_string(words) + " words in 10 rebuilds";
+		});
+		measure("edit 1000 words", "remove_word + insert", [&] {
+			size_t removed = 0;
+			for (const Word& w : edited) {
+				std::optional<Word> undone = crossword.remove_word(w.get_start_position(), w.get_orientation());
+				removed += undone.has_value();
+				crossword.insert_word(*undone, false);
+			}
+			return std::to_string(removed) + " removed, " + counts(crossword);
+		});
+		measure("edit 1000 words", "copy + remove_word", [&] {
+			size_t removed = 0;
+			for (const Word& w : edited) {
+				Crossword copy(crossword);
+				removed += copy.remove_word(w.get_start_position(), w.get_orientation()).has_value();
+			}
+			return std::to_string(removed) + " removed";
+		});
+	}
+
+	// The 'insert' board saved and loaded back, from memory and from a file.
+	void persist() {
+		std::vector<Word> words = random_words(100000, 2000, 1);
+		Crossword crossword(words.front(), {});
+		for (const Word& w : words)
+			crossword.insert_word(w);
+
+		measure("persist", "operator<<", [&] {
+			std::ostringstream out;
+			out << crossword;
+			return std::to_string(out.str().size()) + " bytes";
+		});
+		std::string saved;
+		measure("persist", "save", [&] {
+			std::ostringstream out;
+			crossword.save(out);
+			saved = out.str();
+			return std::to_string(saved.size()) + " bytes";
+		});
+		measure("persist", "load, checked", [&] {
+			return counts(*Crossword::load(std::span<const char>(saved.data(), saved.size())));
+		});
+		measure("persist", "load, trusted", [&] {
+			return counts(*Crossword::load(std::span<const char>(saved.data(), saved.size()), false));
+		});
+
+		const char* path = "crosswords_bench.tmp";
+		std::ofstream(path, std::ios::binary).write(saved.data(), saved.size());
+		measure("persist", "load_file, trusted", [&] {
+			return counts(*Crossword::load_file(path, false));
+		});
+		std::remove(path);
+	}
+
+	// Bytes allocated on the heap, from the allocator's statistics.
+	size_t heap_used() {
+		struct mallinfo2 info = mallinfo2();
+		return info.uordblks + info.hblkhd;
+	}
+
+	// The 'insert' board and its 'query' hit-tests and 'candidates' checks with coordinates of the type.
+	template<typename Cord>
+	void width_steps(const char* workload) {
+		std::vector<BasicWord<Cord>> words;
+		for (const Word& w : random_words(100000, 2000, 1)) {
+			pos_t start = w.get_start_position();
+			std::string content(w.length(), ' ');
+			for (size_t i = 0; i < w.length(); i++)
+				content[i] = w.at(i);
+			words.emplace_back(Cord(start.first), Cord(start.second), w.get_orientation(), std::move(content));
+		}
+		std::vector<typename BasicWord<Cord>::pos_t> points;
+		std::vector<BasicWord<Cord>> candidates;
+		for (const Word& w : random_words(10000, 2000, 8)) {
+			pos_t start = w.get_start_position();
+			points.emplace_back(Cord(start.first), Cord(start.second));
+			candidates.emplace_back(Cord(start.first), Cord(start.second), w.get_orientation(), std::string(w.length(), 'A'));
+		}
+
+		size_t heap_before = heap_used();
+		std::optional<BasicCrossword<Cord>> crossword;
+		measure(workload, "insert_word", [&] {
+			crossword.emplace(words.front(), std::initializer_list<BasicWord<Cord>>{});
+			for (const BasicWord<Cord>& w : words)
+				crossword->insert_word(w);
+			return std::to_string((heap_used() - heap_before) >> 10) + " KiB on the heap, "
+				+ std::to_string(sizeof(BasicWord<Cord>)) + " bytes per word object";
+		});
+		measure(workload, "words_in 10x10", [&] {
+			size_t found = 0;
+			for (auto p : points)
+				found += crossword->words_in(BasicRectArea<Cord>(p, {Cord(p.first + 9), Cord(p.second + 9)})).size();
+			return std::to_string(found) + " words";
+		});
+		measure(workload, "can_insert", [&] {
+			std::vector<bool> results = crossword->can_insert(candidates, 1);
+			return std::to_string(std::count(results.begin(), results.end(), true)) + " accepted";
+		});
+	}
+
+	// The same board with coordinates of 64, 32 and 16 bits.
+	void width() {
+		width_steps<size_t>("width size_t");
+		width_steps<uint32_t>("width uint32_t");
+		width_steps<uint16_t>("width uint16_t");
+	}
+
+	// Random words with English letter frequencies.
+	std::vector<std::string> random_dictionary(size_t count, size_t length, unsigned seed) {
+		const std::string letters = "EEEEEEEEEEEETTTTTTTTTAAAAAAAAOOOOOOOIIIIIIINNNNNNNSSSSSSHHHHHHRRRRRRDDDDLLLLCCCUUUMMMWWFFGGYYPPBVKJXQZ";
+		std::mt19937 random(seed);
+		std::vector<std::string> words;
+		for (size_t i = 0; i < count; i++) {
+			std::string word(length, ' ');
+			for (char& c : word)
+				c = letters[random() % letters.size()];
+			words.push_back(std::move(word));
+		}
+		return words;
+	}
+
+	// n H and n V slots of the given length crossing at every other cell.
+	std::vector<Word> lattice(cord_t x, cord_t y, size_t n, size_t length) {
+		std::vector<Word> slots;
+		for (size_t i = 0; i < n; i++) {
+			slots.emplace_back(x, y + 2 * i, H, std::string(length, '?'));
+			slots.emplace_back(x + 2 * i, y, V, std::string(length, '?'));
+		}
+		return slots;
+	}
+
+	// 1000 3x3 lattices of 5-letter slots, each with a different given letter, and a 5x5 lattice of 9-letter slots.
+	void fill_lattices() {
+		std::vector<std::string> words = random_dictionary(30000, 5, 6);
+		for (std::string& word : random_dictionary(2000, 9, 7))
+			words.push_back(std::move(word));
+		Dictionary dictionary({});
+		measure("fill", "Dictionary", [&] {
+			dictionary = Dictionary(words);
+			return std::to_string(dictionary.size()) + " words";
+		});
+
+		auto placed = [](size_t words, std::chrono::steady_clock::time_point start) {
+			std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+			return std::to_string(words) + " words placed, " + std::to_string(size_t(words / time.count())) + " words/s";
+		};
+		measure("fill", "1000 lattices 3x3", [&] {
+			auto start = std::chrono::steady_clock::now();
+			size_t words = 0;
+			for (size_t k = 0; k < 1000; k++) {
+				std::vector<Word> slots = lattice(0, 0, 3, 5);
+				slots[0] = Word(0, 0, H, std::string(1, "ETAOINSHRDLU"[k % 12]) + "????");
+				std::optional<Crossword> filled = fill(slots, dictionary);
+				words += filled.has_value() ? slots.size() : 0;
+			}
+			return placed(words, start);
+		});
+		measure("fill", "lattice 5x5", [&] {
+			auto start = std::chrono::steady_clock::now();
+			std::optional<Crossword> filled = fill(lattice(0, 0, 5, 9), dictionary);
+			return placed(filled.has_value() ? 10 : 0, start);
+		});
+	}
+
+	// A 100x100 window of the 'insert' board, and words spread over a 10^9 x 10^9 area in the summary mode.
+	void viewport() {
+		std::vector<Word> words = random_words(100000, 2000, 1);
+		Crossword crossword(words.front(), {});
+		for (const Word& w : words)
+			crossword.insert_word(w);
+
+		measure("viewport", "window 100x100", [&] {
+			std::ostringstream out;
+			crossword.render(RectArea({950, 950}, {1049, 1049}), out);
+			return std::to_string(out.str().size()) + " bytes";
+		});
+
+		std::vector<Word> spread = random_words(1000, 1000000000, 2);
+		Crossword sparse(spread.front(), {});
+		for (const Word& w : spread)
+			sparse.insert_word(w);
+		measure("viewport", "summary 10^9x10^9", [&] {
+			std::ostringstream out;
+			sparse.render(RectArea({0, 0}, {MAX_COORDINATE, MAX_COORDINATE}), out, true);
+			return std::to_string(out.str().size()) + " bytes";
+		});
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const std::vector<std::pair<const char*, std::function<void()>>> workloads = {
+		{"insert", insert},
+		{"render", render},
+		{"merge", merge},
+		{"search", search},
+		{"candidates", candidates},
+		{"fill", fill_lattices},
+		{"viewport", viewport},
+		{"query", query},
+		{"edit", edit},
+		{"persist", persist},
+		{"width", width},
+	};
+
+	for (auto& [name, workload] : workloads) {
+		bool selected = argc == 1;
+		for (int i = 1; i < argc; i++)
+			selected |= strcmp(argv[i], name) == 0;
+		if (selected)
+			workload();
+	}
+}
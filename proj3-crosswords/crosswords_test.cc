@@ -0,0 +1,570 @@
+/*
+ * Tests of the crosswords library. Every test compares a result with the same one computed another way
+ * and prints whether they agree.
+ *
+ * g++ -Wall -Wextra -O2 -std=c++20 crosswords.cc crossword_fill.cc crosswords_test.cc -pthread -o crosswords_test
+ *
+ * './crosswords_test' runs every test, './crosswords_test merge' only the given ones.
+ * The exit status is 1 if any of them fails.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "crossword_fill.h"
+#include "crosswords.h"
+
+namespace {
+	size_t failures = 0;
+
+	// Runs a check, which returns what went wrong, or nothing if it passed.
+	template<typename F>
+	void check(const char* test, const char* step, F&& f) {
+		std::string problem = f();
+		printf("%-24s %-40s %s\n", test, step, problem.empty() ? "ok" : ("FAILED: " + problem).c_str());
+		failures += !problem.empty();
+	}
+
+	/*
+	 * Random words of 1 to 8 letters out of 3, starting anywhere on a board of the given size moved by 'shift'.
+	 * Words are kept within 16-bit coordinates, cut at 65535, so that they're the same for every type.
+	 */
+	template<typename Cord>
+	std::vector<BasicWord<Cord>> random_words(size_t count, size_t board, unsigned seed, size_t shift = 0) {
+		std::mt19937 random(seed);
+		std::uniform_int_distribution<size_t> position(0, board - 1);
+		std::uniform_int_distribution<size_t> length(1, 8);
+		std::uniform_int_distribution<int> letter('A', 'C');
+
+		std::vector<BasicWord<Cord>> words;
+		for (size_t i = 0; i < count; i++) {
+			std::string content(length(random), ' ');
+			for (char& c : content)
+				c = letter(random);
+			size_t x = std::min<size_t>(position(random) + shift, 65535), y = std::min<size_t>(position(random) + shift, 65535);
+			orientation_t orientation = random() % 2 ? H : V;
+			content.resize(std::min<size_t>(content.size(), 65536 - (orientation == H ? x : y)));
+			words.emplace_back(Cord(x), Cord(y), orientation, std::move(content));
+		}
+		return words;
+	}
+
+	template<typename Cord>
+	std::string text(const BasicCrossword<Cord>& crossword) {
+		std::ostringstream out;
+		out << crossword;
+		return out.str();
+	}
+
+	// What differs between the crosswords, if anything.
+	template<typename Cord>
+	std::string compare(const BasicCrossword<Cord>& actual, const BasicCrossword<Cord>& expected) {
+		if (actual.word_count() != expected.word_count())
+			return "word counts differ";
+		if (actual.size() != expected.size())
+			return "sizes differ";
+		if (text(actual) != text(expected))
+			return "letters differ";
+		return "";
+	}
+
+	// A board with 'count' random words on 'board' x 'board' cells moved by 'shift'.
+	Crossword random_board(size_t count, size_t board, unsigned seed, size_t shift = 0) {
+		std::vector<Word> words = random_words<cord_t>(count, board, seed, shift);
+		Crossword crossword(words.front(), {});
+		for (const Word& w : words)
+			crossword.insert_word(w);
+		return crossword;
+	}
+
+	// The lines of a render in the summary mode with the runs of the background and the repeated lines written out.
+	std::string expand(const std::string& summary) {
+		std::istringstream lines(summary);
+		std::string line, expanded;
+		while (std::getline(lines, line)) {
+			size_t times = 1, repeat = line.rfind(" x");
+			if (repeat != std::string::npos) {
+				times = std::stoul(line.substr(repeat + 2));
+				line.resize(repeat);
+			}
+			std::istringstream cells(line);
+			std::string cell, full;
+			while (cells >> cell) {
+				size_t count = cell.size() > 2 && cell[1] == '*' ? std::stoul(cell.substr(2)) : 1;
+				for (size_t i = 0; i < count; i++)
+					full += (full.empty() ? "" : " ") + cell.substr(0, 1);
+			}
+			for (size_t i = 0; i < times; i++)
+				expanded += full + '\n';
+		}
+		return expanded;
+	}
+
+	// Renders in the summary mode and of viewports agree with operator<<, also for areas spanning the whole space.
+	void render() {
+		Crossword board = random_board(3000, 300, 5, 1000);
+		check("render", "summary", [&]() -> std::string {
+			std::ostringstream out;
+			board.render(RectArea({0, 0}, {MAX_COORDINATE, MAX_COORDINATE}), out, true);
+			return expand(out.str()) == text(board) ? "" : "letters differ";
+		});
+		check("render", "viewports", [&]() -> std::string {
+			for (size_t from : {0, 900, 1000, 1063, 1064, 1150}) {
+				for (size_t to : {1000, 1063, 1064, 1299, 2000}) {
+					std::ostringstream full, summary;
+					RectArea viewport({from, from + 7}, {to, to + 11});
+					board.render(viewport, full);
+					board.render(viewport, summary, true);
+					if (expand(summary.str()) != full.str())
+						return "viewport from " + std::to_string(from) + " to " + std::to_string(to);
+				}
+			}
+			return "";
+		});
+
+		// The area is 2^64 - 1 cells wide and 2^64 cells high, with the frame around it.
+		check("render", "words at the corners of the space", [&]() -> std::string {
+			Crossword corners(Word(0, 0, H, "A"), {Word(MAX_COORDINATE - 1, MAX_COORDINATE, H, "B")});
+			std::ostringstream out;
+			corners.render(RectArea({0, 0}, {MAX_COORDINATE, MAX_COORDINATE}), out, true);
+			return out.str() == ".*18446744073709551617\n"
+				". A .*18446744073709551615\n"
+				".*18446744073709551617 x18446744073709551614\n"
+				".*18446744073709551615 B .\n"
+				".*18446744073709551617\n" ? "" : "summary:\n" + out.str();
+		});
+	}
+
+	// What the operations on the crossword give, to be compared between coordinate types.
+	template<typename Cord>
+	std::string width_trace(unsigned seed, size_t base) {
+		using Word = BasicWord<Cord>;
+		std::vector<Word> words = random_words<Cord>(400, 40, seed, base), candidates = random_words<Cord>(200, 40, seed + 1, base);
+		BasicCrossword<Cord> crossword(words.front(), {});
+		std::string trace;
+		for (size_t i = 0; i < words.size(); i++) {
+			trace += crossword.insert_word(words[i]) ? 'i' : '-';
+			if (i % 50 == 49)
+				trace += crossword.remove_word(words[i / 2].get_start_position(), words[i / 2].get_orientation()) ? 'r' : '-';
+		}
+		for (bool insertable : crossword.can_insert(candidates, 1))
+			trace += insertable ? 'c' : '-';
+		Cord from = Cord(std::min<size_t>(base + 10, 65535)), to = Cord(std::min<size_t>(base + 25, 65535));
+		for (const Word& w : crossword.words_in(BasicRectArea<Cord>({from, from}, {to, to})))
+			trace += std::to_string(w.get_start_position().first) + "," + std::to_string(w.get_start_position().second) + ' ';
+		std::ostringstream saved;
+		crossword.save(saved);
+		return trace + '\n' + text(crossword) + saved.str();
+	}
+
+	// Narrower coordinates give the same crosswords, also at the edges of their space.
+	void width() {
+		check("width", "random boards near 0 and 65535", [&]() -> std::string {
+			for (unsigned seed = 0; seed < 20; seed++) {
+				// Words starting past 65535 are cut by random_words, so these reach the edge.
+				for (size_t base : {0, 1000, 65535 - 45, 65535 - 20}) {
+					std::string narrow = width_trace<uint16_t>(seed, base);
+					if (narrow != width_trace<uint32_t>(seed, base) || narrow != width_trace<size_t>(seed, base))
+						return "seed " + std::to_string(seed) + " at " + std::to_string(base);
+				}
+			}
+			return "";
+		});
+
+		check("width", "uint16_t board 65536 cells wide", [&]() -> std::string {
+			BasicCrossword<uint16_t> narrow(BasicWord<uint16_t>(0, 0, H, "AB"), {BasicWord<uint16_t>(65534, 0, H, "CD")});
+			Crossword wide(Word(0, 0, H, "AB"), {Word(65534, 0, H, "CD")});
+			if (narrow.size() != dim_t{65536, 1})
+				return "size " + std::to_string(narrow.size().first) + "x" + std::to_string(narrow.size().second);
+			return text(narrow) == text(wide) ? "" : "letters differ";
+		});
+		check("width", "uint16_t board spanning the space", [&]() -> std::string {
+			BasicCrossword<uint16_t> narrow(BasicWord<uint16_t>(0, 0, V, "AB"), {BasicWord<uint16_t>(65535, 65534, V, "CD")});
+			Crossword wide(Word(0, 0, V, "AB"), {Word(65535, 65534, V, "CD")});
+			std::ostringstream narrow_summary, wide_summary;
+			narrow.render(BasicRectArea<uint16_t>({0, 0}, {65535, 65535}), narrow_summary, true);
+			wide.render(RectArea({0, 0}, {MAX_COORDINATE, MAX_COORDINATE}), wide_summary, true);
+			if (narrow.size() != dim_t{65536, 65536})
+				return "size " + std::to_string(narrow.size().first) + "x" + std::to_string(narrow.size().second);
+			return narrow_summary.str() == wide_summary.str() ? "" : "summaries differ";
+		});
+		check("width", "load of coordinates past the type", [&]() -> std::string {
+			std::ostringstream saved;
+			Crossword(Word(65535, 70000, H, "AB"), {}).save(saved);
+			std::string data = saved.str();
+			if (BasicCrossword<uint16_t>::load(std::span<const char>(data.data(), data.size())).has_value())
+				return "loaded as uint16_t";
+			if (!BasicCrossword<uint32_t>::load(std::span<const char>(data.data(), data.size())).has_value())
+				return "not loaded as uint32_t";
+			return "";
+		});
+	}
+
+	// The crossword saved and loaded back, or nothing if it doesn't load.
+	std::optional<Crossword> reloaded(const Crossword& crossword, bool check_collisions = true) {
+		std::ostringstream saved;
+		crossword.save(saved);
+		std::string data = saved.str();
+		return Crossword::load(std::span<const char>(data.data(), data.size()), check_collisions);
+	}
+
+	// can_insert tells which candidates insert_word would insert into a copy of the crossword.
+	void candidates() {
+		Crossword board = random_board(20000, 1000, 9);
+		std::vector<Word> candidates = random_words<cord_t>(5000, 1000, 10);
+		// Half of them in a few rows and columns, checked together.
+		for (const Word& w : random_words<cord_t>(5000, 1000, 11)) {
+			pos_t start = w.get_start_position();
+			if (w.get_orientation() == H)
+				candidates.emplace_back(start.first, 500 + start.second % 20, H, std::string(w.length(), 'A'));
+			else
+				candidates.emplace_back(500 + start.first % 20, start.second, V, std::string(w.length(), 'B'));
+		}
+
+		std::vector<bool> expected;
+		for (const Word& w : candidates)
+			expected.push_back(Crossword(board).insert_word(w));
+		for (unsigned threads : {1, 3}) {
+			check("candidates", threads == 1 ? "can_insert, 1 thread" : "can_insert, 3 threads", [&]() -> std::string {
+				std::vector<bool> insertable = board.can_insert(candidates, threads);
+				for (size_t i = 0; i < candidates.size(); i++) {
+					if (insertable[i] != expected[i])
+						return "candidate " + std::to_string(i);
+				}
+				return "";
+			});
+		}
+	}
+
+	// words_in and the row and column queries find the words a scan of all the inserted words finds.
+	void query() {
+		std::vector<Word> words = random_words<cord_t>(20000, 1000, 13);
+		Crossword crossword(words.front(), {});
+		std::vector<Word> inserted{words.front()};
+		for (size_t i = 1; i < words.size(); i++) {
+			const Word& w = words[i];
+			if (crossword.insert_word(w))
+				inserted.push_back(w);
+		}
+		auto scan = [&](const RectArea& area) {
+			std::vector<Word> found;
+			for (const Word& w : inserted) {
+				if (!(w.rect_area() * area).empty())
+					found.push_back(w);
+			}
+			std::sort(found.begin(), found.end());
+			return found;
+		};
+		auto sorted = [](std::vector<Word> found) {
+			std::sort(found.begin(), found.end());
+			return found;
+		};
+
+		check("query", "words_in", [&]() -> std::string {
+			std::mt19937 random(14);
+			for (size_t k = 0; k < 300; k++) {
+				cord_t x = random() % 1100, y = random() % 1100, width = random() % (k < 250 ? 20 : 400);
+				RectArea area({x, y}, {x + width, y + random() % 20});
+				if (sorted(crossword.words_in(area)) != scan(area))
+					return "area " + std::to_string(k);
+			}
+			return sorted(crossword.words_in(RectArea({0, 0}, {MAX_COORDINATE, MAX_COORDINATE}))) == sorted(inserted)
+				? "" : "whole space";
+		});
+		check("query", "words_at_row/column", [&]() -> std::string {
+			for (cord_t line = 0; line < 1010; line += 7) {
+				if (sorted(crossword.words_at_row(line)) != scan(RectArea({0, line}, {MAX_COORDINATE, line}))
+						|| sorted(crossword.words_at_column(line)) != scan(RectArea({line, 0}, {line, MAX_COORDINATE})))
+					return "line " + std::to_string(line);
+			}
+			return "";
+		});
+	}
+
+	// Fillings use distinct words of the dictionary that agree with the given letters and on the crossings.
+	void fill_slots() {
+		std::mt19937 random(12);
+		std::vector<std::string> words;
+		for (size_t i = 0; i < 3000; i++) {
+			std::string word(5, ' ');
+			for (char& c : word)
+				c = "ABCDE"[random() % 5];
+			words.push_back(word);
+		}
+		Dictionary dictionary(words);
+
+		check("fill", "count_matching", [&]() -> std::string {
+			for (std::string pattern : {"?????", "A????", "?B?C?", "EEEEE", "????", "AB?DE?"}) {
+				size_t count = 0;
+				for (size_t i = 0; i < dictionary.size(); i++) {
+					const std::string& word = dictionary.word(i);
+					bool matches = word.size() == pattern.size();
+					for (size_t p = 0; matches && p < pattern.size(); p++)
+						matches = pattern[p] == '?' || pattern[p] == word[p];
+					count += matches;
+				}
+				if (dictionary.count_matching(pattern) != count)
+					return "pattern " + pattern;
+			}
+			return "";
+		});
+
+		// 3 H and 3 V slots crossing at every other cell, with a given letter.
+		std::vector<Word> slots;
+		for (cord_t i = 0; i < 3; i++) {
+			slots.emplace_back(10, 10 + 2 * i, H, std::string(i == 1 ? "?C???" : "?????"));
+			slots.emplace_back(10 + 2 * i, 10, V, std::string("?????"));
+		}
+		for (unsigned threads : {1, 3}) {
+			check("fill", threads == 1 ? "lattice, 1 thread" : "lattice, 3 threads", [&]() -> std::string {
+				std::optional<Crossword> filled = fill(slots, dictionary, threads);
+				if (!filled.has_value())
+					return "not filled";
+				if (filled->word_count() != dim_t{3, 3})
+					return "word counts differ";
+				std::vector<std::string> used;
+				for (const Word& slot : slots) {
+					pos_t start = slot.get_start_position();
+					std::string content;
+					for (const Word& w : filled->words_in(RectArea(start, start))) {
+						if (w.get_start_position() == start && w.get_orientation() == slot.get_orientation()) {
+							for (size_t i = 0; i < w.length(); i++)
+								content += w.at(i);
+						}
+					}
+					for (size_t i = 0; i < slot.length(); i++) {
+						if (content.size() != slot.length() || (slot.at(i) != '?' && slot.at(i) != content[i]))
+							return "slot not filled as given";
+					}
+					if (std::find(words.begin(), words.end(), content) == words.end())
+						return content + " isn't in the dictionary";
+					if (std::find(used.begin(), used.end(), content) != used.end())
+						return content + " used twice";
+					used.push_back(content);
+				}
+				return "";
+			});
+		}
+		check("fill", "slots that can't cross", [&]() -> std::string {
+			std::vector<Word> apart = {Word(0, 0, H, "?????"), Word(0, 1, H, "?????")};
+			return fill(apart, dictionary, 1).has_value() ? "filled" : "";
+		});
+
+		// Too few words for the lattice, so all threads run out of tasks and must stop together.
+		std::vector<std::string> few_words;
+		for (size_t i = 0; i < 120; i++) {
+			std::string word(5, ' ');
+			for (char& c : word)
+				c = 'A' + random() % 26;
+			few_words.push_back(word);
+		}
+		Dictionary small_dictionary(few_words);
+		std::vector<Word> lattice;
+		for (cord_t i = 0; i < 3; i++) {
+			lattice.emplace_back(10, 10 + 2 * i, H, std::string("?????"));
+			lattice.emplace_back(10 + 2 * i, 10, V, std::string("?????"));
+		}
+		check("fill", "no filling, 1 and 4 threads", [&]() -> std::string {
+			for (size_t run = 0; run < 20; run++) {
+				if (fill(lattice, small_dictionary, 1).has_value() || fill(lattice, small_dictionary, 4).has_value())
+					return "filled";
+			}
+			return "";
+		});
+	}
+
+	// Saved crosswords load back the same from memory, a stream and a file, and broken data doesn't load.
+	void persist() {
+		Crossword crossword = random_board(20000, 1000, 8);
+		std::ostringstream out;
+		crossword.save(out);
+		std::string saved = out.str();
+		std::span<const char> data(saved.data(), saved.size());
+
+		check("persist", "load, checked and trusted", [&]() -> std::string {
+			for (bool check_collisions : {true, false}) {
+				std::optional<Crossword> loaded = Crossword::load(data, check_collisions);
+				if (!loaded.has_value())
+					return "not loaded";
+				std::string problem = compare(*loaded, crossword);
+				if (!problem.empty())
+					return problem;
+				if (loaded->words_in(RectArea({0, 0}, {500, 500})) != crossword.words_in(RectArea({0, 0}, {500, 500})))
+					return "words differ";
+				std::ostringstream again;
+				loaded->save(again);
+				if (again.str() != saved)
+					return "saved differently";
+			}
+			return "";
+		});
+		check("persist", "load from a stream", [&]() -> std::string {
+			std::istringstream in(saved);
+			std::optional<Crossword> loaded = Crossword::load(in);
+			return loaded.has_value() ? compare(*loaded, crossword) : "not loaded";
+		});
+		check("persist", "load_file", [&]() -> std::string {
+			const char* path = "crosswords_test.tmp";
+			std::ofstream(path, std::ios::binary).write(saved.data(), saved.size());
+			std::optional<Crossword> checked = Crossword::load_file(path), trusted = Crossword::load_file(path, false);
+			std::remove(path);
+			if (!checked.has_value() || !trusted.has_value())
+				return "not loaded";
+			std::string problem = compare(*checked, crossword);
+			return problem.empty() ? compare(*trusted, crossword) : problem;
+		});
+		check("persist", "load_file of a missing or empty file", [&]() -> std::string {
+			const char* path = "crosswords_test.tmp";
+			std::ofstream(path, std::ios::binary).close();
+			bool loaded = Crossword::load_file(path).has_value() || Crossword::load_file("crosswords_test.missing").has_value();
+			std::remove(path);
+			return loaded ? "loaded" : "";
+		});
+		check("persist", "truncated data", [&]() -> std::string {
+			for (size_t cut = 0; cut < saved.size(); cut += 1 + saved.size() / 500) {
+				if (Crossword::load(data.first(cut), false).has_value())
+					return "loaded " + std::to_string(cut) + " bytes";
+			}
+			return "";
+		});
+		check("persist", "colliding words without the flag", [&]() -> std::string {
+			// Two words side by side saved as if they were inserted with the checks.
+			Crossword colliding(Word(0, 0, H, "AB"), {});
+			colliding.insert_word(Word(0, 1, H, "CD"), false);
+			std::ostringstream out;
+			colliding.save(out);
+			std::string flagged = out.str(), unflagged = flagged;
+			// The flags follow the magic and the version.
+			unflagged[12] = 0;
+			if (!Crossword::load(std::span<const char>(flagged.data(), flagged.size())).has_value())
+				return "flagged data not loaded";
+			if (Crossword::load(std::span<const char>(unflagged.data(), unflagged.size())).has_value())
+				return "unflagged data loaded with the checks";
+			return Crossword::load(std::span<const char>(unflagged.data(), unflagged.size()), false).has_value()
+				? "" : "unflagged data not loaded without the checks";
+		});
+	}
+
+	// Removing words gives the crossword of the other words, which saves and loads back.
+	void remove_words() {
+		std::vector<Word> words = random_words<cord_t>(3000, 150, 6);
+		Crossword crossword(words.front(), {});
+		// The words in the crossword, in the order of insertion.
+		std::vector<Word> inserted;
+		for (const Word& w : words) {
+			if (crossword.insert_word(w))
+				inserted.push_back(w);
+		}
+
+		check("remove", "remove_word vs rebuilding", [&]() -> std::string {
+			std::mt19937 random(7);
+			for (size_t k = 0; k < 300 && inserted.size() > 1; k++) {
+				const Word& chosen = inserted[random() % inserted.size()];
+				pos_t start = chosen.get_start_position();
+				orientation_t orientation = chosen.get_orientation();
+				size_t last = inserted.size();
+				while (inserted[--last].get_start_position() != start || inserted[last].get_orientation() != orientation);
+
+				std::optional<Word> removed = crossword.remove_word(start, orientation);
+				if (!removed.has_value() || *removed != inserted[last])
+					return "removal " + std::to_string(k) + " gave a different word";
+				inserted.erase(inserted.begin() + last);
+				if (crossword.remove_word({start.first, start.second + 1000}, orientation).has_value())
+					return "removed a word that isn't there";
+
+				Crossword rebuilt(inserted.front(), {});
+				for (size_t i = 1; i < inserted.size(); i++)
+					rebuilt.insert_word(inserted[i], false);
+				std::string problem = compare(crossword, rebuilt);
+				if (!problem.empty())
+					return problem + " after removal " + std::to_string(k);
+			}
+			return "";
+		});
+		check("remove", "remove_word + insert_word undo", [&]() -> std::string {
+			Crossword edited(crossword);
+			for (size_t i = 0; i < inserted.size(); i += 7) {
+				std::optional<Word> removed = edited.remove_word(inserted[i].get_start_position(), inserted[i].get_orientation());
+				edited.insert_word(*removed, false);
+			}
+			return compare(edited, crossword);
+		});
+
+		check("remove", "save and load after removals", [&]() -> std::string {
+			std::optional<Crossword> loaded = reloaded(crossword);
+			return loaded.has_value() ? compare(*loaded, crossword) : "not loaded";
+		});
+		// Both one-letter words were inserted onto letters of ABC, and are next to each other without it.
+		check("remove", "load after removing a crossed word", [&]() -> std::string {
+			Crossword crossing(Word(10, 10, H, "ABC"), {Word(11, 10, V, "B"), Word(12, 10, V, "C")});
+			crossing.remove_word({10, 10}, H);
+			if (crossing.word_count() != dim_t{0, 2})
+				return "one-letter words not inserted";
+			std::optional<Crossword> loaded = reloaded(crossing);
+			if (!loaded.has_value())
+				return "not loaded";
+			std::optional<Crossword> again = reloaded(*loaded);
+			return again.has_value() ? compare(*again, crossing) : "not loaded again";
+		});
+	}
+
+	// Merges and batch insertions with several threads give the same crossword as with one.
+	void merge() {
+		Crossword board = random_board(20000, 2000, 1);
+		Crossword over = random_board(20000, 2000, 2), far = random_board(20000, 2000, 3, 2500);
+
+		for (auto [step, other] : {std::pair{"merge, boards overlapping", &over}, std::pair{"merge, boards apart", &far}}) {
+			check("merge", step, [&]() -> std::string {
+				Crossword one(board), many(board);
+				one.merge(*other, 1);
+				many.merge(*other, 2);
+				return compare(many, one);
+			});
+		}
+
+		std::vector<Word> words = random_words<cord_t>(20000, 2000, 4);
+		check("merge", "try_insert_many", [&]() -> std::string {
+			Crossword one(board), many(board);
+			if (one.try_insert_many(words, 1) != many.try_insert_many(words, 2))
+				return "different words inserted";
+			return compare(many, one);
+		});
+		check("merge", "try_insert_many vs insert_word", [&]() -> std::string {
+			Crossword batch(board), single(board);
+			std::vector<bool> inserted = batch.try_insert_many(words, 2);
+			for (size_t i = 0; i < words.size(); i++) {
+				if (single.insert_word(words[i]) != inserted[i])
+					return "word " + std::to_string(i) + " inserted differently";
+			}
+			return compare(batch, single);
+		});
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const std::vector<std::pair<const char*, std::function<void()>>> tests = {
+		{"merge", merge},
+		{"render", render},
+		{"width", width},
+		{"remove", remove_words},
+		{"persist", persist},
+		{"candidates", candidates},
+		{"fill", fill_slots},
+		{"query", query},
+	};
+
+	for (auto& [name, test] : tests) {
+		bool selected = argc == 1;
+		for (int i = 1; i < argc; i++)
+			selected |= strcmp(argv[i], name) == 0;
+		if (selected)
+			test();
+	}
+	return failures > 0;
+}